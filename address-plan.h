@@ -0,0 +1,278 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef ADDRESS_PLAN_H
+#define ADDRESS_PLAN_H
+
+#include "ns3/assert.h"
+#include "ns3/fatal-error.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/ipv4-interface-address.h"
+#include "ns3/ipv4-interface-container.h"
+#include "ns3/ipv4.h"
+#include "ns3/ipv6-address.h"
+#include "ns3/ipv6-interface-address.h"
+#include "ns3/ipv6-interface-container.h"
+#include "ns3/ipv6.h"
+#include "ns3/loopback-net-device.h"
+#include "ns3/net-device-container.h"
+#include "ns3/net-device-queue-interface.h"
+#include "ns3/traffic-control-helper.h"
+#include "ns3/traffic-control-layer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+
+namespace ns3
+{
+
+/**
+ * Hierarchical address plan: a pool prefix (10.0.0.0/8, say) carved into
+ * one subnet per link, each as small as its devices allow, instead of the
+ * fixed /24 per link of Ipv4AddressHelper, which runs out after 256 links
+ * of a /16 and wastes most of a /8 on links of a few nodes.  A link of n
+ * devices gets a prefix of 32 - max(2, ceil(log2(n + 2))) bits, aligned on
+ * its size; links of the same size are packed back to back.
+ *
+ * Addresses are added to the Ipv4 interfaces directly, in constant time
+ * per device.  Ipv4AddressHelper records every address in the global
+ * Ipv4AddressGenerator to detect duplicates, a list that is walked on
+ * every insertion, so assigning n addresses takes O(n^2); the plan never
+ * hands out an address twice, so it has nothing to check.  Pools of the
+ * plans of one scenario must not overlap.
+ *
+ * With EnableIpv6(), every link also gets a /64 of a /48, numbered as the
+ * IPv4 subnets, and every device the same host number in it.  The IPv6
+ * stack must be installed on the nodes; the scenarios still route IPv4.
+ */
+class AddressPlan
+{
+  public:
+    /**
+     * \param pool The first address of the pool.
+     * \param prefixLength The prefix length of the pool.
+     */
+    AddressPlan(Ipv4Address pool, uint8_t prefixLength);
+
+    /**
+     * Give the links an IPv6 /64 each too.
+     * \param prefix The /48 the /64 are taken from.
+     */
+    void EnableIpv6(Ipv6Address prefix);
+
+    /**
+     * Allocate the subnet of a link and address its devices, in order,
+     * from the first host address.
+     * \param devices The devices of the link.
+     * \return their IPv4 interfaces.
+     */
+    Ipv4InterfaceContainer Assign(const NetDeviceContainer& devices);
+
+    /**
+     * \param prefixLength The prefix length of a pool.
+     * \param devices The devices of each link.
+     * \return how many links of that many devices the pool holds.
+     */
+    static uint64_t GetMaxLinks(uint8_t prefixLength, uint32_t devices);
+
+    /**
+     * \return the number of subnets allocated.
+     */
+    uint32_t GetNSubnets() const;
+    /**
+     * \return the number of devices addressed.
+     */
+    uint64_t GetNHosts() const;
+    /**
+     * \return the IPv6 interfaces, if enabled.
+     */
+    const Ipv6InterfaceContainer& GetIpv6Interfaces() const;
+
+    /**
+     * Print an address-plan line.
+     * \param os The output stream.
+     */
+    void PrintReport(std::ostream& os) const;
+
+  private:
+    /**
+     * \param devices The devices of a link.
+     * \return the host bits of its subnet.
+     */
+    static uint32_t GetHostBits(uint32_t devices);
+    /**
+     * Install the default root queue disc on a device that has none, as
+     * Ipv4AddressHelper does.
+     * \param device The device.
+     */
+    static void InstallQueueDisc(Ptr<NetDevice> device);
+
+    uint32_t m_pool;                     //!< First address of the pool.
+    uint8_t m_prefixLength;              //!< Prefix length of the pool.
+    uint64_t m_next{0};                  //!< Offset of the next free address.
+    uint32_t m_subnets{0};               //!< Subnets allocated.
+    uint64_t m_hosts{0};                 //!< Devices addressed.
+    bool m_ipv6{false};                  //!< Whether to assign IPv6 too.
+    uint8_t m_ipv6Prefix[16];            //!< The IPv6 /48.
+    Ipv6InterfaceContainer m_ipv6Ifaces; //!< IPv6 interfaces.
+};
+
+inline AddressPlan::AddressPlan(Ipv4Address pool, uint8_t prefixLength)
+    : m_pool(pool.Get()),
+      m_prefixLength(prefixLength),
+      m_ipv6Prefix{}
+{
+    NS_ASSERT_MSG(prefixLength > 0 && prefixLength <= 30, "Bad pool prefix length");
+    NS_ASSERT_MSG((m_pool & ((1ULL << (32 - prefixLength)) - 1)) == 0,
+                  "The pool address has host bits set");
+}
+
+inline void
+AddressPlan::EnableIpv6(Ipv6Address prefix)
+{
+    m_ipv6 = true;
+    prefix.GetBytes(m_ipv6Prefix);
+    NS_ASSERT_MSG(m_subnets == 0, "Enable IPv6 before the first subnet");
+}
+
+inline void
+AddressPlan::InstallQueueDisc(Ptr<NetDevice> device)
+{
+    Ptr<TrafficControlLayer> tc = device->GetNode()->GetObject<TrafficControlLayer>();
+    if (tc && !DynamicCast<LoopbackNetDevice>(device) && !tc->GetRootQueueDiscOnDevice(device))
+    {
+        // without a queue interface, the device never backlogs the disc
+        Ptr<NetDeviceQueueInterface> ndqi = device->GetObject<NetDeviceQueueInterface>();
+        if (ndqi)
+        {
+            TrafficControlHelper::Default(ndqi->GetNTxQueues()).Install(device);
+        }
+    }
+}
+
+inline uint32_t
+AddressPlan::GetHostBits(uint32_t devices)
+{
+    // the network and broadcast addresses are not given to devices
+    uint32_t hostBits = 2;
+    while ((1ULL << hostBits) < uint64_t(devices) + 2)
+    {
+        hostBits++;
+    }
+    return hostBits;
+}
+
+inline uint64_t
+AddressPlan::GetMaxLinks(uint8_t prefixLength, uint32_t devices)
+{
+    uint32_t hostBits = GetHostBits(devices);
+    return hostBits > 32U - prefixLength ? 0 : 1ULL << (32 - prefixLength - hostBits);
+}
+
+inline Ipv4InterfaceContainer
+AddressPlan::Assign(const NetDeviceContainer& devices)
+{
+    uint64_t size = 1ULL << GetHostBits(devices.GetN());
+    uint64_t offset = (m_next + size - 1) & ~(size - 1);
+    if (offset + size > (1ULL << (32 - m_prefixLength)))
+    {
+        NS_FATAL_ERROR("Address pool " << Ipv4Address(m_pool) << "/" << int(m_prefixLength)
+                                       << " exhausted after " << m_subnets << " subnets");
+    }
+    m_next = offset + size;
+    uint32_t network = m_pool + uint32_t(offset);
+    Ipv4Mask mask(~uint32_t(size - 1));
+    NS_ASSERT_MSG(!m_ipv6 || m_subnets < 65536, "A /48 has only 65536 /64");
+
+    Ipv4InterfaceContainer ifaces;
+    for (uint32_t i = 0; i < devices.GetN(); i++)
+    {
+        Ptr<NetDevice> device = devices.Get(i);
+        Ptr<Ipv4> ipv4 = device->GetNode()->GetObject<Ipv4>();
+        NS_ASSERT_MSG(ipv4, "AddressPlan needs an IPv4 stack on the node");
+        int32_t iface = ipv4->GetInterfaceForDevice(device);
+        if (iface == -1)
+        {
+            iface = ipv4->AddInterface(device);
+        }
+        ipv4->AddAddress(iface, Ipv4InterfaceAddress(Ipv4Address(network + i + 1), mask));
+        ipv4->SetMetric(iface, 1);
+        ipv4->SetUp(iface);
+        ifaces.Add(ipv4, iface);
+
+        if (m_ipv6)
+        {
+            Ptr<Ipv6> ipv6 = device->GetNode()->GetObject<Ipv6>();
+            NS_ASSERT_MSG(ipv6, "AddressPlan needs an IPv6 stack on the node");
+            int32_t iface6 = ipv6->GetInterfaceForDevice(device);
+            if (iface6 == -1)
+            {
+                iface6 = ipv6->AddInterface(device);
+            }
+            // prefix:subnet::host
+            uint8_t bytes[16];
+            std::copy(m_ipv6Prefix, m_ipv6Prefix + 6, bytes);
+            std::fill(bytes + 6, bytes + 16, 0);
+            bytes[6] = m_subnets >> 8;
+            bytes[7] = m_subnets & 0xff;
+            for (int b = 0; b < 4; b++)
+            {
+                bytes[15 - b] = uint8_t((i + 1) >> (8 * b));
+            }
+            ipv6->AddAddress(iface6, Ipv6InterfaceAddress(Ipv6Address(bytes), Ipv6Prefix(64)));
+            ipv6->SetMetric(iface6, 1);
+            ipv6->SetUp(iface6);
+            m_ipv6Ifaces.Add(ipv6, iface6);
+        }
+        InstallQueueDisc(device);
+    }
+    m_subnets++;
+    m_hosts += devices.GetN();
+    return ifaces;
+}
+
+inline uint32_t
+AddressPlan::GetNSubnets() const
+{
+    return m_subnets;
+}
+
+inline uint64_t
+AddressPlan::GetNHosts() const
+{
+    return m_hosts;
+}
+
+inline const Ipv6InterfaceContainer&
+AddressPlan::GetIpv6Interfaces() const
+{
+    return m_ipv6Ifaces;
+}
+
+inline void
+AddressPlan::PrintReport(std::ostream& os) const
+{
+    uint64_t poolSize = 1ULL << (32 - m_prefixLength);
+    os << "address-plan pool=" << Ipv4Address(m_pool) << "/" << int(m_prefixLength)
+       << " subnets=" << m_subnets << " hosts=" << m_hosts
+       << " poolUsed=" << double(m_next) / poolSize << " ipv6=" << (m_ipv6 ? "yes" : "no")
+       << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* ADDRESS_PLAN_H */
@@ -0,0 +1,324 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef ANIM_FLOW_AGGREGATOR_H
+#define ANIM_FLOW_AGGREGATOR_H
+
+#include "ns3/animation-interface.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy.h"
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Per-link wireless packet counts aggregated over fixed windows.
+ *
+ * This replaces the per-packet <wpr> records of AnimationInterface in the
+ * decimated animation mode.  The sender of a frame is remembered by packet
+ * uid on PhyTxBegin and matched on PhyRxEnd at every receiver, the same way
+ * AnimationInterface pairs wireless Tx and Rx.  At the end of each window
+ * the non-empty links are written as CSV rows
+ * WindowStart,FromNode,ToNode,Packets,Bytes
+ * and, when an AnimationInterface is given, the per-node Tx/Rx packet
+ * counts of the window are published as NetAnim node counters.
+ */
+class AnimFlowAggregator
+{
+  public:
+    /**
+     * \param fileName The CSV output file.
+     * \param window The aggregation window.
+     * \param anim The animation to publish node counters to, or nullptr.
+     */
+    AnimFlowAggregator(const std::string& fileName, Time window, AnimationInterface* anim);
+    /**
+     * Writes the last window.
+     */
+    ~AnimFlowAggregator();
+
+    // the trace sinks are bound to pointers into this object
+    AnimFlowAggregator(const AnimFlowAggregator&) = delete;
+    AnimFlowAggregator& operator=(const AnimFlowAggregator&) = delete;
+
+    /**
+     * Count the frames of every Wi-Fi device of the nodes.
+     * \param nodes The nodes.
+     */
+    void Install(NodeContainer nodes);
+    /**
+     * Write the current window and stop aggregating.
+     */
+    void Close();
+
+  private:
+    /// Packets and bytes seen on a link or by a node.
+    struct Counters
+    {
+        uint32_t packets{0}; //!< Packets.
+        uint64_t bytes{0};   //!< Bytes.
+    };
+
+    /// A hooked PHY.
+    struct Source
+    {
+        AnimFlowAggregator* aggregator; //!< Owner.
+        uint32_t node;                  //!< Node id.
+    };
+
+    /**
+     * PhyTxBegin trace sink.
+     * \param s The source.
+     * \param p The packet.
+     * \param txPowerW The Tx power.
+     */
+    static void TxBegin(Source* s, Ptr<const Packet> p, double txPowerW);
+    /**
+     * PhyRxEnd trace sink.
+     * \param s The source.
+     * \param p The packet.
+     */
+    static void RxEnd(Source* s, Ptr<const Packet> p);
+    /**
+     * Write the window that just ended and schedule the next one.
+     */
+    void EndWindow();
+    /**
+     * Write the counts of the current window.
+     */
+    void WriteWindow();
+
+    std::ofstream m_out;                                 //!< CSV output.
+    Time m_window;                                       //!< Window length.
+    AnimationInterface* m_anim;                          //!< Animation, may be null.
+    uint32_t m_txCounter{0};                             //!< NetAnim Tx counter id.
+    uint32_t m_rxCounter{0};                             //!< NetAnim Rx counter id.
+    Time m_windowStart;                                  //!< Start of the current window.
+    EventId m_event;                                     //!< Next end of window.
+    std::deque<Source> m_sources;                        //!< Hooked PHYs.
+    std::unordered_map<uint64_t, uint32_t> m_sender;     //!< Sender by uid, this window.
+    std::unordered_map<uint64_t, uint32_t> m_lastSender; //!< Sender by uid, previous window.
+    std::unordered_map<uint64_t, Counters> m_links;      //!< Counts by (from << 32 | to).
+    std::vector<uint32_t> m_nodeTx;                      //!< Tx frames by node id.
+    std::vector<uint32_t> m_nodeRx;                      //!< Rx frames by node id.
+};
+
+inline AnimFlowAggregator::AnimFlowAggregator(const std::string& fileName,
+                                              Time window,
+                                              AnimationInterface* anim)
+    : m_out(fileName),
+      m_window(window),
+      m_anim(anim)
+{
+    m_out << "WindowStart,FromNode,ToNode,Packets,Bytes\n";
+    if (m_anim)
+    {
+        m_txCounter = m_anim->AddNodeCounter("TxFrames", AnimationInterface::UINT32_COUNTER);
+        m_rxCounter = m_anim->AddNodeCounter("RxFrames", AnimationInterface::UINT32_COUNTER);
+    }
+    m_windowStart = Simulator::Now();
+    m_event = Simulator::Schedule(m_window, &AnimFlowAggregator::EndWindow, this);
+}
+
+inline AnimFlowAggregator::~AnimFlowAggregator()
+{
+    Close();
+}
+
+inline void
+AnimFlowAggregator::Install(NodeContainer nodes)
+{
+    for (auto i = nodes.Begin(); i != nodes.End(); ++i)
+    {
+        Ptr<Node> node = *i;
+        if (node->GetId() >= m_nodeTx.size())
+        {
+            m_nodeTx.resize(node->GetId() + 1, 0);
+            m_nodeRx.resize(node->GetId() + 1, 0);
+        }
+        for (uint32_t d = 0; d < node->GetNDevices(); d++)
+        {
+            Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>(node->GetDevice(d));
+            if (!dev || !dev->GetPhy())
+            {
+                continue;
+            }
+            m_sources.push_back(Source{this, node->GetId()});
+            Source* s = &m_sources.back();
+            dev->GetPhy()->TraceConnectWithoutContext(
+                "PhyTxBegin",
+                MakeBoundCallback(&AnimFlowAggregator::TxBegin, s));
+            dev->GetPhy()->TraceConnectWithoutContext(
+                "PhyRxEnd",
+                MakeBoundCallback(&AnimFlowAggregator::RxEnd, s));
+        }
+    }
+}
+
+inline void
+AnimFlowAggregator::TxBegin(Source* s, Ptr<const Packet> p, double /* txPowerW */)
+{
+    AnimFlowAggregator* a = s->aggregator;
+    a->m_sender[p->GetUid()] = s->node;
+    a->m_nodeTx[s->node]++;
+}
+
+inline void
+AnimFlowAggregator::RxEnd(Source* s, Ptr<const Packet> p)
+{
+    AnimFlowAggregator* a = s->aggregator;
+    a->m_nodeRx[s->node]++;
+
+    // frames sent just before the window boundary are received after it
+    auto it = a->m_sender.find(p->GetUid());
+    if (it == a->m_sender.end())
+    {
+        it = a->m_lastSender.find(p->GetUid());
+        if (it == a->m_lastSender.end())
+        {
+            return;
+        }
+    }
+    Counters& c = a->m_links[(static_cast<uint64_t>(it->second) << 32) | s->node];
+    c.packets++;
+    c.bytes += p->GetSize();
+}
+
+inline void
+AnimFlowAggregator::WriteWindow()
+{
+    double start = m_windowStart.GetSeconds();
+    for (const auto& link : m_links)
+    {
+        m_out << start << "," << (link.first >> 32) << "," << (link.first & 0xffffffff) << ","
+              << link.second.packets << "," << link.second.bytes << "\n";
+    }
+    m_links.clear();
+
+    if (m_anim)
+    {
+        for (uint32_t n = 0; n < m_nodeTx.size(); n++)
+        {
+            m_anim->UpdateNodeCounter(m_txCounter, n, m_nodeTx[n]);
+            m_anim->UpdateNodeCounter(m_rxCounter, n, m_nodeRx[n]);
+        }
+    }
+    std::fill(m_nodeTx.begin(), m_nodeTx.end(), 0);
+    std::fill(m_nodeRx.begin(), m_nodeRx.end(), 0);
+}
+
+inline void
+AnimFlowAggregator::EndWindow()
+{
+    WriteWindow();
+    m_lastSender.swap(m_sender);
+    m_sender.clear();
+    m_windowStart = Simulator::Now();
+    m_event = Simulator::Schedule(m_window, &AnimFlowAggregator::EndWindow, this);
+}
+
+inline void
+AnimFlowAggregator::Close()
+{
+    if (m_out.is_open())
+    {
+        m_event.Cancel();
+        WriteWindow();
+        m_out.close();
+    }
+}
+
+/**
+ * Animation output of the hanet and mixed wireless scenarios.
+ *
+ * - "full": AnimationInterface with every packet, as before.
+ * - "decimated": node positions polled every window and per-link flow
+ *   counts in <file>.flows.csv, no per-packet records.
+ * - "off": no animation.
+ */
+class AnimOutput
+{
+  public:
+    /**
+     * \param mode "full", "decimated" or "off".
+     * \return true if the mode is known.
+     */
+    static bool IsValidMode(const std::string& mode);
+
+    /**
+     * Set up the animation for all the nodes created so far.
+     * \param fileName The NetAnim XML file.
+     * \param mode The animation mode.
+     * \param window The position and flow sampling interval of the decimated mode.
+     */
+    AnimOutput(const std::string& fileName, const std::string& mode, Time window);
+    /**
+     * Write the last flow window.  Call after Simulator::Run().
+     */
+    void Close();
+
+  private:
+    std::unique_ptr<AnimationInterface> m_anim;  //!< The animation, null when off.
+    std::unique_ptr<AnimFlowAggregator> m_flows; //!< Flow counts, decimated mode only.
+};
+
+inline bool
+AnimOutput::IsValidMode(const std::string& mode)
+{
+    return mode == "full" || mode == "decimated" || mode == "off";
+}
+
+inline AnimOutput::AnimOutput(const std::string& fileName, const std::string& mode, Time window)
+{
+    if (mode == "off")
+    {
+        return;
+    }
+    m_anim = std::make_unique<AnimationInterface>(fileName);
+    if (mode == "decimated")
+    {
+        m_anim->SkipPacketTracing();
+        m_anim->SetMobilityPollInterval(window);
+        m_flows =
+            std::make_unique<AnimFlowAggregator>(fileName + ".flows.csv", window, m_anim.get());
+        m_flows->Install(NodeContainer::GetGlobal());
+    }
+}
+
+inline void
+AnimOutput::Close()
+{
+    if (m_flows)
+    {
+        m_flows->Close();
+    }
+}
+
+} // namespace ns3
+
+#endif /* ANIM_FLOW_AGGREGATOR_H */
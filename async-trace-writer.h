@@ -0,0 +1,452 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef ASYNC_TRACE_WRITER_H
+#define ASYNC_TRACE_WRITER_H
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Trace output drained to a file by a background thread.
+ *
+ * The simulation thread is the only producer: Write() copies already
+ * serialized bytes into a lock-free single-producer/single-consumer ring and
+ * returns.  A writer thread drains the ring with large sequential write()
+ * calls.  When the disk cannot keep up the ring fills and Write() waits for
+ * room; those stalls, the time spent in them and the highest ring fill are
+ * kept in the Stats so that backpressure shows up in the run output instead
+ * of only as a slower run.
+ *
+ * The bytes reach the file in the order they were written, so the file
+ * contents are the same as with a synchronous stream.
+ */
+class AsyncTraceWriter
+{
+  public:
+    /// Output and backpressure counters.
+    struct Stats
+    {
+        uint64_t bytes{0};       //!< Bytes handed to Write().
+        uint64_t writes{0};      //!< write() calls issued by the writer thread.
+        uint64_t stalls{0};      //!< Write() calls that had to wait for room.
+        double stallSeconds{0};  //!< Time the producer spent waiting.
+        std::size_t maxFill{0};  //!< Highest number of bytes queued.
+        std::size_t capacity{0}; //!< Ring size.
+        bool error{false};       //!< Whether a write() failed; later data is dropped.
+    };
+
+    /**
+     * Create (truncate) a file and start the writer thread.
+     * \param fileName The output file.
+     * \param capacity The ring size in bytes, rounded up to a power of two.
+     */
+    explicit AsyncTraceWriter(const std::string& fileName, std::size_t capacity = 8 << 20);
+    /**
+     * Write to an already open descriptor, e.g. STDOUT_FILENO.
+     * \param fd The descriptor, not closed by the writer.
+     * \param capacity The ring size in bytes, rounded up to a power of two.
+     */
+    explicit AsyncTraceWriter(int fd, std::size_t capacity = 8 << 20);
+    /**
+     * Drains the ring and stops the writer thread.
+     */
+    ~AsyncTraceWriter();
+
+    AsyncTraceWriter(const AsyncTraceWriter&) = delete;
+    AsyncTraceWriter& operator=(const AsyncTraceWriter&) = delete;
+
+    /**
+     * Queue bytes for writing.  Only one thread may call this.
+     * \param data The bytes.
+     * \param size Their number.
+     */
+    void Write(const void* data, std::size_t size);
+    /**
+     * Wait until everything queued so far has been written, then stop the
+     * writer thread and close the file.  Further writes are dropped.
+     */
+    void Close();
+    /**
+     * \return the counters.  The write count is final only after Close().
+     */
+    Stats GetStats() const;
+    /**
+     * Print the counters on one line.
+     * \param os The output.
+     * \param name The name of this output in the line.
+     */
+    void PrintStats(std::ostream& os, const std::string& name) const;
+
+  private:
+    /**
+     * Allocate the ring and start the writer thread.
+     * \param capacity The requested ring size.
+     */
+    void Start(std::size_t capacity);
+    /**
+     * Writer thread body.
+     */
+    void Drain();
+
+    int m_fd;                            //!< Output descriptor.
+    bool m_ownFd;                        //!< Whether Close() closes m_fd.
+    std::vector<char> m_ring;            //!< Ring storage.
+    std::size_t m_mask{0};               //!< Ring size - 1.
+    std::atomic<std::size_t> m_head{0};  //!< Bytes produced, only written by the producer.
+    std::atomic<std::size_t> m_tail{0};  //!< Bytes consumed, only written by the writer thread.
+    std::atomic<bool> m_stop{false};     //!< Ask the writer thread to finish.
+    std::atomic<bool> m_sleeping{false}; //!< The writer thread waits for data.
+    std::atomic<uint64_t> m_writes{0};   //!< write() calls.
+    std::atomic<bool> m_error{false};    //!< A write() failed.
+    std::mutex m_mutex;                  //!< Protects the wake up of the writer thread.
+    std::condition_variable m_wake;      //!< Wakes the writer thread.
+    std::thread m_thread;                //!< Writer thread.
+    bool m_closed{false};                //!< Whether Close() ran.
+    uint64_t m_bytes{0};                 //!< Bytes queued.
+    uint64_t m_stalls{0};                //!< Stalled Write() calls.
+    double m_stallSeconds{0};            //!< Time spent stalled.
+    std::size_t m_maxFill{0};            //!< Highest fill.
+};
+
+/**
+ * std::streambuf that hands its put area to an AsyncTraceWriter.
+ *
+ * Formatting goes to a small local buffer; when it is full or the stream is
+ * flushed (std::endl, as the ascii trace helpers do for every line), the
+ * buffered bytes are copied into the ring, which costs no system call.
+ */
+class AsyncStreamBuf : public std::streambuf
+{
+  public:
+    /**
+     * \param writer The writer to hand the bytes to.
+     * \param bufferSize The size of the local buffer.
+     */
+    explicit AsyncStreamBuf(AsyncTraceWriter& writer, std::size_t bufferSize = 64 << 10);
+    ~AsyncStreamBuf() override;
+
+  protected:
+    int_type overflow(int_type c) override;
+    int sync() override;
+
+  private:
+    AsyncTraceWriter& m_writer; //!< Destination.
+    std::vector<char> m_buffer; //!< Put area.
+};
+
+/**
+ * An output stream written by a background thread.  It can be handed to
+ * ns-3 as Create<OutputStreamWrapper>(&stream), which does not take
+ * ownership of it, or used directly as a std::ostream.
+ */
+class AsyncOstream : public std::ostream
+{
+  public:
+    /**
+     * \param fileName The output file.
+     * \param capacity The ring size in bytes.
+     */
+    explicit AsyncOstream(const std::string& fileName, std::size_t capacity = 8 << 20);
+    /**
+     * \param fd The output descriptor, not closed.
+     * \param capacity The ring size in bytes.
+     */
+    explicit AsyncOstream(int fd, std::size_t capacity = 8 << 20);
+    ~AsyncOstream() override;
+
+    /**
+     * Flush and close the output, see AsyncTraceWriter::Close().
+     */
+    void Close();
+    /**
+     * \return the writer behind the stream.
+     */
+    const AsyncTraceWriter& GetWriter() const;
+
+  private:
+    AsyncTraceWriter m_writer; //!< Background writer.
+    AsyncStreamBuf m_buf;      //!< Stream buffer.
+};
+
+inline AsyncTraceWriter::AsyncTraceWriter(const std::string& fileName, std::size_t capacity)
+    : m_fd(::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)),
+      m_ownFd(true)
+{
+    if (m_fd < 0)
+    {
+        m_error = true;
+    }
+    Start(capacity);
+}
+
+inline AsyncTraceWriter::AsyncTraceWriter(int fd, std::size_t capacity)
+    : m_fd(fd),
+      m_ownFd(false)
+{
+    Start(capacity);
+}
+
+inline AsyncTraceWriter::~AsyncTraceWriter()
+{
+    Close();
+}
+
+inline void
+AsyncTraceWriter::Start(std::size_t capacity)
+{
+    std::size_t size = 4096;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    m_ring.resize(size);
+    m_mask = size - 1;
+    m_thread = std::thread(&AsyncTraceWriter::Drain, this);
+}
+
+inline void
+AsyncTraceWriter::Write(const void* data, std::size_t size)
+{
+    if (m_closed)
+    {
+        return;
+    }
+    auto src = static_cast<const char*>(data);
+    m_bytes += size;
+    std::size_t head = m_head.load(std::memory_order_relaxed);
+    bool stalled = false;
+    std::chrono::steady_clock::time_point stallStart;
+    while (size > 0)
+    {
+        std::size_t room = m_ring.size() - (head - m_tail.load(std::memory_order_acquire));
+        if (room == 0)
+        {
+            if (!stalled)
+            {
+                stalled = true;
+                stallStart = std::chrono::steady_clock::now();
+                m_stalls++;
+            }
+            m_wake.notify_one();
+            std::this_thread::yield();
+            continue;
+        }
+        std::size_t n = std::min(size, room);
+        std::size_t offset = head & m_mask;
+        std::size_t first = std::min(n, m_ring.size() - offset);
+        std::memcpy(m_ring.data() + offset, src, first);
+        std::memcpy(m_ring.data(), src + first, n - first);
+        head += n;
+        src += n;
+        size -= n;
+        m_head.store(head, std::memory_order_seq_cst);
+        m_maxFill = std::max(m_maxFill, m_ring.size() - room + n);
+        if (m_sleeping.load(std::memory_order_seq_cst))
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_wake.notify_one();
+        }
+    }
+    if (stalled)
+    {
+        m_stallSeconds +=
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - stallStart).count();
+    }
+}
+
+inline void
+AsyncTraceWriter::Drain()
+{
+    std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    while (true)
+    {
+        std::size_t head = m_head.load(std::memory_order_acquire);
+        if (head == tail)
+        {
+            if (m_stop.load(std::memory_order_acquire))
+            {
+                // the producer stopped before setting m_stop, so this is all
+                if (m_head.load(std::memory_order_acquire) == tail)
+                {
+                    break;
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_sleeping.store(true, std::memory_order_seq_cst);
+            m_wake.wait_for(lock, std::chrono::milliseconds(5), [this, tail]() {
+                return m_head.load(std::memory_order_seq_cst) != tail ||
+                       m_stop.load(std::memory_order_acquire);
+            });
+            m_sleeping.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        // one write() per contiguous region of the ring
+        std::size_t offset = tail & m_mask;
+        std::size_t n = std::min(head - tail, m_ring.size() - offset);
+        const char* p = m_ring.data() + offset;
+        std::size_t left = n;
+        while (left > 0 && !m_error.load(std::memory_order_relaxed))
+        {
+            ssize_t written = ::write(m_fd, p, left);
+            m_writes.fetch_add(1, std::memory_order_relaxed);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                m_error.store(true, std::memory_order_relaxed);
+                break;
+            }
+            p += written;
+            left -= written;
+        }
+        tail += n;
+        m_tail.store(tail, std::memory_order_release);
+    }
+}
+
+inline void
+AsyncTraceWriter::Close()
+{
+    if (m_closed)
+    {
+        return;
+    }
+    m_closed = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop.store(true, std::memory_order_release);
+    }
+    m_wake.notify_one();
+    m_thread.join();
+    if (m_ownFd && m_fd >= 0)
+    {
+        ::close(m_fd);
+    }
+}
+
+inline AsyncTraceWriter::Stats
+AsyncTraceWriter::GetStats() const
+{
+    Stats s;
+    s.bytes = m_bytes;
+    s.writes = m_writes.load(std::memory_order_relaxed);
+    s.stalls = m_stalls;
+    s.stallSeconds = m_stallSeconds;
+    s.maxFill = m_maxFill;
+    s.capacity = m_ring.size();
+    s.error = m_error.load(std::memory_order_relaxed);
+    return s;
+}
+
+inline void
+AsyncTraceWriter::PrintStats(std::ostream& os, const std::string& name) const
+{
+    Stats s = GetStats();
+    os << "trace output " << name << ": " << s.bytes << " bytes in " << s.writes << " writes, "
+       << s.stalls << " stalls (" << s.stallSeconds << " s), max fill "
+       << 100.0 * s.maxFill / s.capacity << "% of " << (s.capacity >> 10) << " KiB"
+       << (s.error ? ", WRITE ERROR" : "") << std::endl;
+}
+
+inline AsyncStreamBuf::AsyncStreamBuf(AsyncTraceWriter& writer, std::size_t bufferSize)
+    : m_writer(writer),
+      m_buffer(bufferSize)
+{
+    setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+}
+
+inline AsyncStreamBuf::~AsyncStreamBuf()
+{
+    sync();
+}
+
+inline AsyncStreamBuf::int_type
+AsyncStreamBuf::overflow(int_type c)
+{
+    sync();
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+inline int
+AsyncStreamBuf::sync()
+{
+    if (pptr() > pbase())
+    {
+        m_writer.Write(pbase(), pptr() - pbase());
+        setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+    }
+    return 0;
+}
+
+inline AsyncOstream::AsyncOstream(const std::string& fileName, std::size_t capacity)
+    : std::ostream(nullptr),
+      m_writer(fileName, capacity),
+      m_buf(m_writer)
+{
+    rdbuf(&m_buf);
+}
+
+inline AsyncOstream::AsyncOstream(int fd, std::size_t capacity)
+    : std::ostream(nullptr),
+      m_writer(fd, capacity),
+      m_buf(m_writer)
+{
+    rdbuf(&m_buf);
+}
+
+inline AsyncOstream::~AsyncOstream()
+{
+    Close();
+}
+
+inline void
+AsyncOstream::Close()
+{
+    flush();
+    m_writer.Close();
+}
+
+inline const AsyncTraceWriter&
+AsyncOstream::GetWriter() const
+{
+    return m_writer;
+}
+
+#endif /* ASYNC_TRACE_WRITER_H */
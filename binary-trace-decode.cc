@@ -0,0 +1,263 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Converts the binary packet traces written by BinaryTraceWriter (the .btr
+ * files of the hanet scenarios) back to ns-2-like text, one line per record:
+ *
+ *   <event> <time> <trace source path> uid=<uid> size=<bytes> [digest=0x<hash>]
+ *
+ * The trace source paths are the config paths the ascii helpers print, e.g.
+ * /NodeList/3/DeviceList/1/$ns3::WifiNetDevice/Phy/State/RxOk, so that the
+ * output can be grepped the same way as the old .tr files.
+ *
+ * Usage:
+ *   binary-trace-decode [--node=N] [--from=s] [--to=s] [--summary] <file.btr>
+ * --summary prints the record counts per layer and event instead of the
+ * records; CSMA drops are counted per trace source.
+ */
+
+#include "binary-trace-format.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+
+/// Flags telling apart the trace sources of the same event.
+const uint16_t SOURCE_FLAGS = BinaryTraceRecord::MAC_TX_DROP | BinaryTraceRecord::PHY_RX_DROP;
+
+/**
+ * Name the CsmaNetDevice trace source of a record.
+ * \param event The event letter.
+ * \param flags The record flags.
+ * \return The trace source, relative to the device.
+ */
+const char*
+CsmaSource(char event, uint16_t flags)
+{
+    switch (event)
+    {
+    case '+':
+        return "TxQueue/Enqueue";
+    case '-':
+        return "TxQueue/Dequeue";
+    case 'd':
+        if (flags & BinaryTraceRecord::MAC_TX_DROP)
+        {
+            return "MacTxDrop";
+        }
+        if (flags & BinaryTraceRecord::PHY_RX_DROP)
+        {
+            return "PhyRxDrop";
+        }
+        return "TxQueue/Drop";
+    }
+    return "MacRx";
+}
+
+/**
+ * Print the config path of the trace source of a record.
+ * \param out The output.
+ * \param r The record.
+ */
+void
+PrintPath(FILE* out, const BinaryTraceRecord& r)
+{
+    switch (r.layer)
+    {
+    case BTR_WIFI_PHY:
+        std::fprintf(out,
+                     "/NodeList/%u/DeviceList/%u/$ns3::WifiNetDevice/Phy/State/%s",
+                     r.node,
+                     r.device,
+                     r.event == 't' ? "Tx" : "RxOk");
+        break;
+    case BTR_CSMA:
+        std::fprintf(out,
+                     "/NodeList/%u/DeviceList/%u/$ns3::CsmaNetDevice/%s",
+                     r.node,
+                     r.device,
+                     CsmaSource(r.event, r.flags));
+        break;
+    case BTR_IPV4:
+        std::fprintf(out,
+                     "/NodeList/%u/$ns3::Ipv4L3Protocol/%s(%u)",
+                     r.node,
+                     r.event == 't' ? "Tx" : (r.event == 'r' ? "Rx" : "Drop"),
+                     r.device);
+        break;
+    default:
+        std::fprintf(out, "/NodeList/%u/DeviceList/%u/layer%u", r.node, r.device, r.layer);
+    }
+}
+
+/**
+ * \param layer A BinaryTraceLayer.
+ * \return its name.
+ */
+const char*
+LayerName(uint8_t layer)
+{
+    switch (layer)
+    {
+    case BTR_WIFI_PHY:
+        return "wifi-phy";
+    case BTR_CSMA:
+        return "csma";
+    case BTR_IPV4:
+        return "ipv4";
+    }
+    return "unknown";
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    int64_t node = -1;
+    double from = 0;
+    double to = -1;
+    bool summary = false;
+    std::string fileName;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        auto value = [&arg]() { return arg.substr(arg.find('=') + 1); };
+        if (arg.rfind("--node=", 0) == 0)
+        {
+            node = std::stol(value());
+        }
+        else if (arg.rfind("--from=", 0) == 0)
+        {
+            from = std::stod(value());
+        }
+        else if (arg.rfind("--to=", 0) == 0)
+        {
+            to = std::stod(value());
+        }
+        else if (arg == "--summary")
+        {
+            summary = true;
+        }
+        else if (arg == "--help" || arg.rfind("--", 0) == 0 || !fileName.empty())
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [--node=N] [--from=s] [--to=s] [--summary] <file.btr>" << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+        else
+        {
+            fileName = arg;
+        }
+    }
+    if (fileName.empty())
+    {
+        std::cerr << "no trace file given" << std::endl;
+        return 1;
+    }
+
+    FILE* in = std::fopen(fileName.c_str(), "rb");
+    if (!in)
+    {
+        std::perror(fileName.c_str());
+        return 1;
+    }
+    uint8_t header[16];
+    if (std::fread(header, 1, sizeof(header), in) != sizeof(header) ||
+        std::memcmp(header, BinaryTraceRecord::MAGIC, 8) != 0)
+    {
+        std::cerr << fileName << ": not a binary packet trace" << std::endl;
+        std::fclose(in);
+        return 1;
+    }
+    uint16_t version = static_cast<uint16_t>(BinaryTraceGet(header + 8, 2));
+    if (version > BinaryTraceRecord::VERSION)
+    {
+        std::cerr << fileName << ": unsupported version " << version << std::endl;
+        std::fclose(in);
+        return 1;
+    }
+
+    int64_t fromNs = static_cast<int64_t>(from * 1e9);
+    int64_t toNs = to < 0 ? INT64_MAX : static_cast<int64_t>(to * 1e9);
+    std::map<std::tuple<uint8_t, char, uint16_t>, uint64_t> counts;
+    std::vector<uint8_t> buf(UINT16_MAX);
+    std::vector<char> outBuf(1 << 20);
+    std::setvbuf(stdout, outBuf.data(), _IOFBF, outBuf.size());
+    uint64_t records = 0;
+    uint8_t prefix[2];
+    while (std::fread(prefix, 1, sizeof(prefix), in) == sizeof(prefix))
+    {
+        uint16_t length = static_cast<uint16_t>(BinaryTraceGet(prefix, 2));
+        if (std::fread(buf.data(), 1, length, in) != length || length < BinaryTraceRecord::SIZE)
+        {
+            std::cerr << fileName << ": truncated record " << records << std::endl;
+            break;
+        }
+        records++;
+        BinaryTraceRecord r;
+        r.Deserialize(buf.data());
+        if ((node >= 0 && r.node != node) || r.timeNs < fromNs || r.timeNs > toNs)
+        {
+            continue;
+        }
+        if (summary)
+        {
+            counts[{r.layer, r.event, r.flags & SOURCE_FLAGS}]++;
+            continue;
+        }
+        std::printf("%c %" PRId64 ".%09" PRId64 " ",
+                    r.event,
+                    r.timeNs / 1000000000,
+                    r.timeNs % 1000000000);
+        PrintPath(stdout, r);
+        std::printf(" uid=%" PRIu64 " size=%u", r.uid, r.size);
+        if (r.flags & BinaryTraceRecord::DIGEST)
+        {
+            std::printf(" digest=0x%08x", r.digest);
+        }
+        std::putchar('\n');
+    }
+    std::fclose(in);
+
+    if (summary)
+    {
+        std::printf("records %" PRIu64 "\n", records);
+        for (const auto& c : counts)
+        {
+            uint8_t layer = std::get<0>(c.first);
+            char event = std::get<1>(c.first);
+            std::printf("%s %c", LayerName(layer), event);
+            if (layer == BTR_CSMA && event == 'd')
+            {
+                std::printf(" %s", CsmaSource(event, std::get<2>(c.first)));
+            }
+            std::printf(" %" PRIu64 "\n", c.second);
+        }
+    }
+    std::fflush(stdout);
+    return 0;
+}
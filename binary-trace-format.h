@@ -0,0 +1,163 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BINARY_TRACE_FORMAT_H
+#define BINARY_TRACE_FORMAT_H
+
+#include <cstdint>
+
+/**
+ * On-disk layout of the binary packet trace (.btr) files.
+ *
+ * A file starts with a 16 byte header:
+ * - magic "NS3BTR\0\0"
+ * - uint16 version, uint16 record size, uint32 flags
+ *
+ * followed by records, each prefixed with its uint16 length so that readers
+ * can skip fields appended by later versions.  Records are fixed size:
+ *
+ * | offset | size | field                                          |
+ * |--------|------|------------------------------------------------|
+ * | 0      | 8    | int64 time in nanoseconds                      |
+ * | 8      | 4    | uint32 node id                                 |
+ * | 12     | 4    | uint32 device index (interface index for IPv4) |
+ * | 16     | 1    | event: '+', '-', 'd', 'r' or 't'               |
+ * | 17     | 1    | layer, see BinaryTraceLayer                    |
+ * | 18     | 2    | uint16 flags, see BinaryTraceRecord            |
+ * | 20     | 8    | uint64 packet uid                              |
+ * | 28     | 4    | uint32 packet size                             |
+ * | 32     | 4    | uint32 FNV-1a digest of the first packet bytes |
+ *
+ * All integers are little endian, whatever the byte order of the host
+ * that wrote the file; see BinaryTracePut() and BinaryTraceGet().
+ *
+ * A CSMA 'd' record is a queue drop unless its MAC_TX_DROP or PHY_RX_DROP
+ * flag says which device trace it came from.
+ */
+
+/// Layer a record was traced at.
+enum BinaryTraceLayer : uint8_t
+{
+    BTR_WIFI_PHY = 0, //!< WifiPhy state Tx/RxOk.
+    BTR_CSMA = 1,     //!< CsmaNetDevice queue and MAC.
+    BTR_IPV4 = 2,     //!< Ipv4L3Protocol Tx/Rx/Drop.
+};
+
+/**
+ * Store an integer in little endian byte order.
+ * \param buf At least bytes bytes.
+ * \param value The value.
+ * \param bytes Its size in the file.
+ */
+inline void
+BinaryTracePut(uint8_t* buf, uint64_t value, unsigned bytes)
+{
+    for (unsigned i = 0; i < bytes; i++)
+    {
+        buf[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+/**
+ * Load an integer stored by BinaryTracePut().
+ * \param buf At least bytes bytes.
+ * \param bytes Its size in the file.
+ * \return the value.
+ */
+inline uint64_t
+BinaryTraceGet(const uint8_t* buf, unsigned bytes)
+{
+    uint64_t value = 0;
+    for (unsigned i = 0; i < bytes; i++)
+    {
+        value |= static_cast<uint64_t>(buf[i]) << (8 * i);
+    }
+    return value;
+}
+
+/// One trace record.
+struct BinaryTraceRecord
+{
+    static const uint16_t SIZE = 36;                 //!< Serialized size.
+    static const uint16_t DIGEST = 0x1;              //!< Flag: the digest field is valid.
+    static const uint16_t MAC_TX_DROP = 0x2;         //!< Flag: a 'd' from MacTxDrop.
+    static const uint16_t PHY_RX_DROP = 0x4;         //!< Flag: a 'd' from PhyRxDrop.
+    static const uint16_t VERSION = 1;               //!< File format version.
+    static constexpr const char* MAGIC = "NS3BTR\0"; //!< File magic (8 bytes with the NUL).
+
+    int64_t timeNs{0};  //!< Simulation time.
+    uint32_t node{0};   //!< Node id.
+    uint32_t device{0}; //!< Device or interface index.
+    char event{0};      //!< Event letter.
+    uint8_t layer{0};   //!< BinaryTraceLayer.
+    uint16_t flags{0};  //!< Record flags.
+    uint64_t uid{0};    //!< Packet uid.
+    uint32_t size{0};   //!< Packet size.
+    uint32_t digest{0}; //!< Header digest.
+
+    /**
+     * Serialize the record.
+     * \param buf At least SIZE bytes.
+     */
+    void Serialize(uint8_t* buf) const
+    {
+        BinaryTracePut(buf, static_cast<uint64_t>(timeNs), 8);
+        BinaryTracePut(buf + 8, node, 4);
+        BinaryTracePut(buf + 12, device, 4);
+        buf[16] = static_cast<uint8_t>(event);
+        buf[17] = layer;
+        BinaryTracePut(buf + 18, flags, 2);
+        BinaryTracePut(buf + 20, uid, 8);
+        BinaryTracePut(buf + 28, size, 4);
+        BinaryTracePut(buf + 32, digest, 4);
+    }
+
+    /**
+     * Deserialize a record.
+     * \param buf At least SIZE bytes.
+     */
+    void Deserialize(const uint8_t* buf)
+    {
+        timeNs = static_cast<int64_t>(BinaryTraceGet(buf, 8));
+        node = static_cast<uint32_t>(BinaryTraceGet(buf + 8, 4));
+        device = static_cast<uint32_t>(BinaryTraceGet(buf + 12, 4));
+        event = static_cast<char>(buf[16]);
+        layer = buf[17];
+        flags = static_cast<uint16_t>(BinaryTraceGet(buf + 18, 2));
+        uid = BinaryTraceGet(buf + 20, 8);
+        size = static_cast<uint32_t>(BinaryTraceGet(buf + 28, 4));
+        digest = static_cast<uint32_t>(BinaryTraceGet(buf + 32, 4));
+    }
+};
+
+/**
+ * 32 bit FNV-1a hash.
+ * \param data The bytes.
+ * \param len Their number.
+ * \return the hash.
+ */
+inline uint32_t
+BinaryTraceDigest(const uint8_t* data, uint32_t len)
+{
+    uint32_t h = 2166136261U;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        h = (h ^ data[i]) * 16777619U;
+    }
+    return h;
+}
+
+#endif /* BINARY_TRACE_FORMAT_H */
@@ -0,0 +1,417 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BINARY_TRACE_WRITER_H
+#define BINARY_TRACE_WRITER_H
+
+#include "async-trace-writer.h"
+#include "binary-trace-format.h"
+
+#include "ns3/csma-net-device.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/node-container.h"
+#include "ns3/packet.h"
+#include "ns3/queue.h"
+#include "ns3/simulator.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/wifi-phy-state-helper.h"
+#include "ns3/wifi-phy.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Packet trace writer producing the fixed-size binary records described in
+ * binary-trace-format.h.
+ *
+ * It hooks the same trace sources as the ns-2 style ASCII traces of
+ * YansWifiPhyHelper, CsmaHelper and InternetStackHelper, but each event
+ * costs a 38 byte copy into a large in-memory buffer instead of printing
+ * the whole packet.  Full buffers are handed to an AsyncTraceWriter, so the
+ * file writes happen on a background thread.  The files are little endian
+ * on every host, and binary-trace-decode converts them back to text.
+ */
+class BinaryTraceWriter
+{
+  public:
+    /**
+     * \param fileName The output file.
+     * \param headerDigest Whether to store a digest of the first packet bytes.
+     * \param bufferSize Bytes buffered between writes.
+     */
+    BinaryTraceWriter(const std::string& fileName,
+                      bool headerDigest,
+                      std::size_t bufferSize = 64 << 10);
+    /**
+     * Flushes and closes the file.
+     */
+    ~BinaryTraceWriter();
+
+    // one hook per traced device, delete copies so the bound pointers stay valid
+    BinaryTraceWriter(const BinaryTraceWriter&) = delete;
+    BinaryTraceWriter& operator=(const BinaryTraceWriter&) = delete;
+
+    /**
+     * Trace Tx and RxOk of every Wi-Fi PHY of the nodes.
+     * \param nodes The nodes.
+     */
+    void EnableWifi(NodeContainer nodes);
+    /**
+     * Trace the queue, MacRx and drops of every CSMA device of the nodes.
+     * \param nodes The nodes.
+     */
+    void EnableCsma(NodeContainer nodes);
+    /**
+     * Trace Tx, Rx and Drop of the IPv4 stack of the nodes.
+     * \param nodes The nodes.
+     */
+    void EnableIpv4(NodeContainer nodes);
+    /**
+     * Write the buffered records and close the file.
+     */
+    void Close();
+    /**
+     * \return the number of records written so far.
+     */
+    uint64_t GetRecordCount() const;
+    /**
+     * \return the background writer of the file.
+     */
+    const AsyncTraceWriter& GetOutput() const;
+
+  private:
+    /// What a hooked trace source reports as.
+    struct Source
+    {
+        BinaryTraceWriter* writer; //!< Owner.
+        uint32_t node;             //!< Node id.
+        uint32_t device;           //!< Device index.
+        uint8_t layer;             //!< BinaryTraceLayer.
+    };
+
+    /**
+     * Register a traced source.
+     * \param node Node id.
+     * \param device Device index.
+     * \param layer The layer.
+     * \return a pointer that stays valid for the writer lifetime.
+     */
+    Source* AddSource(uint32_t node, uint32_t device, uint8_t layer);
+    /**
+     * Append one record.
+     * \param s The source.
+     * \param device The device or interface index.
+     * \param event The event letter.
+     * \param p The packet.
+     * \param flags Record flags telling apart sources of the same event.
+     */
+    void Write(const Source* s,
+               uint32_t device,
+               char event,
+               Ptr<const Packet> p,
+               uint16_t flags = 0);
+    /**
+     * Write the buffer to the file.
+     */
+    void Flush();
+
+    /**
+     * Trace sink for events that only carry a packet.
+     * \tparam E The event letter.
+     * \tparam F The record flags.
+     * \param s The source.
+     * \param p The packet.
+     */
+    template <char E, uint16_t F = 0>
+    static void PacketEvent(Source* s, Ptr<const Packet> p);
+    /**
+     * WifiPhyStateHelper Tx trace sink.
+     * \param s The source.
+     * \param p The packet.
+     * \param mode The Tx mode.
+     * \param preamble The preamble.
+     * \param power The Tx power level.
+     */
+    static void WifiTx(Source* s,
+                       Ptr<const Packet> p,
+                       WifiMode mode,
+                       WifiPreamble preamble,
+                       uint8_t power);
+    /**
+     * WifiPhyStateHelper RxOk trace sink.
+     * \param s The source.
+     * \param p The packet.
+     * \param snr The SNR.
+     * \param mode The Rx mode.
+     * \param preamble The preamble.
+     */
+    static void WifiRxOk(Source* s,
+                         Ptr<const Packet> p,
+                         double snr,
+                         WifiMode mode,
+                         WifiPreamble preamble);
+    /**
+     * Ipv4L3Protocol Tx and Rx trace sink.
+     * \tparam E The event letter.
+     * \param s The source.
+     * \param p The packet.
+     * \param ipv4 The IPv4 stack.
+     * \param interface The interface index.
+     */
+    template <char E>
+    static void Ipv4Event(Source* s, Ptr<const Packet> p, Ptr<Ipv4> ipv4, uint32_t interface);
+    /**
+     * Ipv4L3Protocol Drop trace sink.
+     * \param s The source.
+     * \param header The IPv4 header.
+     * \param p The packet.
+     * \param reason The drop reason.
+     * \param ipv4 The IPv4 stack.
+     * \param interface The interface index.
+     */
+    static void Ipv4Drop(Source* s,
+                         const Ipv4Header& header,
+                         Ptr<const Packet> p,
+                         Ipv4L3Protocol::DropReason reason,
+                         Ptr<Ipv4> ipv4,
+                         uint32_t interface);
+
+    AsyncTraceWriter m_out;        //!< Output file.
+    bool m_headerDigest;           //!< Store packet digests.
+    std::vector<uint8_t> m_buffer; //!< Pending records.
+    std::size_t m_used{0};         //!< Bytes used in the buffer.
+    uint64_t m_records{0};         //!< Records written.
+    std::deque<Source> m_sources;  //!< Hooked sources, stable addresses.
+};
+
+inline BinaryTraceWriter::BinaryTraceWriter(const std::string& fileName,
+                                            bool headerDigest,
+                                            std::size_t bufferSize)
+    : m_out(fileName),
+      m_headerDigest(headerDigest),
+      m_buffer(std::max<std::size_t>(bufferSize, 2 + BinaryTraceRecord::SIZE))
+{
+    uint8_t header[16] = {};
+    std::memcpy(header, BinaryTraceRecord::MAGIC, 8);
+    BinaryTracePut(header + 8, BinaryTraceRecord::VERSION, 2);
+    BinaryTracePut(header + 10, BinaryTraceRecord::SIZE, 2);
+    BinaryTracePut(header + 12, headerDigest ? BinaryTraceRecord::DIGEST : 0, 4);
+    m_out.Write(header, sizeof(header));
+}
+
+inline BinaryTraceWriter::~BinaryTraceWriter()
+{
+    Close();
+}
+
+inline void
+BinaryTraceWriter::Close()
+{
+    Flush();
+    m_out.Close();
+}
+
+inline uint64_t
+BinaryTraceWriter::GetRecordCount() const
+{
+    return m_records;
+}
+
+inline const AsyncTraceWriter&
+BinaryTraceWriter::GetOutput() const
+{
+    return m_out;
+}
+
+inline BinaryTraceWriter::Source*
+BinaryTraceWriter::AddSource(uint32_t node, uint32_t device, uint8_t layer)
+{
+    m_sources.push_back(Source{this, node, device, layer});
+    return &m_sources.back();
+}
+
+inline void
+BinaryTraceWriter::EnableWifi(NodeContainer nodes)
+{
+    for (auto i = nodes.Begin(); i != nodes.End(); ++i)
+    {
+        Ptr<Node> node = *i;
+        for (uint32_t d = 0; d < node->GetNDevices(); d++)
+        {
+            Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>(node->GetDevice(d));
+            if (!dev || !dev->GetPhy())
+            {
+                continue;
+            }
+            Source* s = AddSource(node->GetId(), d, BTR_WIFI_PHY);
+            Ptr<WifiPhyStateHelper> state = dev->GetPhy()->GetState();
+            state->TraceConnectWithoutContext("Tx",
+                                              MakeBoundCallback(&BinaryTraceWriter::WifiTx, s));
+            state->TraceConnectWithoutContext("RxOk",
+                                              MakeBoundCallback(&BinaryTraceWriter::WifiRxOk, s));
+        }
+    }
+}
+
+inline void
+BinaryTraceWriter::EnableCsma(NodeContainer nodes)
+{
+    for (auto i = nodes.Begin(); i != nodes.End(); ++i)
+    {
+        Ptr<Node> node = *i;
+        for (uint32_t d = 0; d < node->GetNDevices(); d++)
+        {
+            Ptr<CsmaNetDevice> dev = DynamicCast<CsmaNetDevice>(node->GetDevice(d));
+            if (!dev)
+            {
+                continue;
+            }
+            Source* s = AddSource(node->GetId(), d, BTR_CSMA);
+            Ptr<Queue<Packet>> queue = dev->GetQueue();
+            queue->TraceConnectWithoutContext("Enqueue",
+                                              MakeBoundCallback(&PacketEvent<'+'>, s));
+            queue->TraceConnectWithoutContext("Dequeue",
+                                              MakeBoundCallback(&PacketEvent<'-'>, s));
+            queue->TraceConnectWithoutContext("Drop", MakeBoundCallback(&PacketEvent<'d'>, s));
+            dev->TraceConnectWithoutContext("MacRx", MakeBoundCallback(&PacketEvent<'r'>, s));
+            dev->TraceConnectWithoutContext(
+                "MacTxDrop",
+                MakeBoundCallback(&PacketEvent<'d', BinaryTraceRecord::MAC_TX_DROP>, s));
+            dev->TraceConnectWithoutContext(
+                "PhyRxDrop",
+                MakeBoundCallback(&PacketEvent<'d', BinaryTraceRecord::PHY_RX_DROP>, s));
+        }
+    }
+}
+
+inline void
+BinaryTraceWriter::EnableIpv4(NodeContainer nodes)
+{
+    for (auto i = nodes.Begin(); i != nodes.End(); ++i)
+    {
+        Ptr<Ipv4L3Protocol> ipv4 = (*i)->GetObject<Ipv4L3Protocol>();
+        if (!ipv4)
+        {
+            continue;
+        }
+        Source* s = AddSource((*i)->GetId(), 0, BTR_IPV4);
+        ipv4->TraceConnectWithoutContext("Tx", MakeBoundCallback(&Ipv4Event<'t'>, s));
+        ipv4->TraceConnectWithoutContext("Rx", MakeBoundCallback(&Ipv4Event<'r'>, s));
+        ipv4->TraceConnectWithoutContext("Drop",
+                                         MakeBoundCallback(&BinaryTraceWriter::Ipv4Drop, s));
+    }
+}
+
+inline void
+BinaryTraceWriter::Write(const Source* s,
+                         uint32_t device,
+                         char event,
+                         Ptr<const Packet> p,
+                         uint16_t flags)
+{
+    if (m_used + 2 + BinaryTraceRecord::SIZE > m_buffer.size())
+    {
+        Flush();
+    }
+    BinaryTraceRecord r;
+    r.timeNs = Simulator::Now().GetNanoSeconds();
+    r.node = s->node;
+    r.device = device;
+    r.event = event;
+    r.layer = s->layer;
+    r.flags = flags;
+    r.uid = p->GetUid();
+    r.size = p->GetSize();
+    if (m_headerDigest)
+    {
+        uint8_t bytes[64];
+        uint32_t n = p->CopyData(bytes, sizeof(bytes));
+        r.digest = BinaryTraceDigest(bytes, n);
+        r.flags |= BinaryTraceRecord::DIGEST;
+    }
+    BinaryTracePut(m_buffer.data() + m_used, BinaryTraceRecord::SIZE, 2);
+    r.Serialize(m_buffer.data() + m_used + 2);
+    m_used += 2 + BinaryTraceRecord::SIZE;
+    m_records++;
+}
+
+inline void
+BinaryTraceWriter::Flush()
+{
+    if (m_used > 0)
+    {
+        m_out.Write(m_buffer.data(), m_used);
+        m_used = 0;
+    }
+}
+
+template <char E, uint16_t F>
+void
+BinaryTraceWriter::PacketEvent(Source* s, Ptr<const Packet> p)
+{
+    s->writer->Write(s, s->device, E, p, F);
+}
+
+inline void
+BinaryTraceWriter::WifiTx(Source* s,
+                          Ptr<const Packet> p,
+                          WifiMode /* mode */,
+                          WifiPreamble /* preamble */,
+                          uint8_t /* power */)
+{
+    s->writer->Write(s, s->device, 't', p);
+}
+
+inline void
+BinaryTraceWriter::WifiRxOk(Source* s,
+                            Ptr<const Packet> p,
+                            double /* snr */,
+                            WifiMode /* mode */,
+                            WifiPreamble /* preamble */)
+{
+    s->writer->Write(s, s->device, 'r', p);
+}
+
+template <char E>
+void
+BinaryTraceWriter::Ipv4Event(Source* s,
+                             Ptr<const Packet> p,
+                             Ptr<Ipv4> /* ipv4 */,
+                             uint32_t interface)
+{
+    s->writer->Write(s, interface, E, p);
+}
+
+inline void
+BinaryTraceWriter::Ipv4Drop(Source* s,
+                            const Ipv4Header& /* header */,
+                            Ptr<const Packet> p,
+                            Ipv4L3Protocol::DropReason /* reason */,
+                            Ptr<Ipv4> /* ipv4 */,
+                            uint32_t interface)
+{
+    s->writer->Write(s, interface, 'd', p);
+}
+
+} // namespace ns3
+
+#endif /* BINARY_TRACE_WRITER_H */
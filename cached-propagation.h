@@ -0,0 +1,447 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef CACHED_PROPAGATION_H
+#define CACHED_PROPAGATION_H
+
+#include "ns3/mobility-model.h"
+#include "ns3/object-factory.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/string.h"
+#include "ns3/yans-wifi-helper.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Memoization of a per (sender, receiver) propagation result.
+ *
+ * A result is reused while both mobility models stay where they were when
+ * it was computed: the entry remembers a per-model epoch that is bumped by
+ * the model's CourseChange trace, and results are only stored when both
+ * models report a zero velocity, since a moving model changes its position
+ * without firing CourseChange.  Moving nodes therefore always go to the
+ * wrapped model, and static or paused ones hit the cache.  The trace sinks
+ * point into the cache, so Clear() (or the destructor) disconnects them.
+ *
+ * \tparam T The cached value type.
+ */
+template <typename T>
+class PropagationCache
+{
+  public:
+    /**
+     * Disconnects from the mobility models.
+     */
+    ~PropagationCache();
+
+    /**
+     * Look up a result.
+     * \param a The sender.
+     * \param b The receiver.
+     * \param value Set to the cached result on a hit.
+     * \return true on a hit.
+     */
+    bool Lookup(Ptr<MobilityModel> a, Ptr<MobilityModel> b, T& value);
+    /**
+     * Store a result, if both models are at rest.
+     * \param a The sender.
+     * \param b The receiver.
+     * \param value The result.
+     */
+    void Store(Ptr<MobilityModel> a, Ptr<MobilityModel> b, const T& value);
+    /**
+     * Drop every result and disconnect from the mobility models.
+     */
+    void Clear();
+    /**
+     * \return the number of hits.
+     */
+    uint64_t GetHits() const;
+    /**
+     * \return the number of misses.
+     */
+    uint64_t GetMisses() const;
+
+  private:
+    /// Sender and receiver.
+    using Key = std::pair<const MobilityModel*, const MobilityModel*>;
+
+    /// A cached result.
+    struct Entry
+    {
+        T value;         //!< The result.
+        uint32_t slotA;  //!< Sender epoch slot.
+        uint32_t slotB;  //!< Receiver epoch slot.
+        uint64_t epochA; //!< Sender epoch of the result.
+        uint64_t epochB; //!< Receiver epoch of the result.
+    };
+
+    /// Hash of a pair of mobility models.
+    struct PairHash
+    {
+        /**
+         * \param key The pair.
+         * \return its hash.
+         */
+        std::size_t operator()(const Key& key) const
+        {
+            auto a = reinterpret_cast<std::uintptr_t>(key.first);
+            auto b = reinterpret_cast<std::uintptr_t>(key.second);
+            return std::hash<std::uintptr_t>()(a * 31 + (b ^ (b >> 16)));
+        }
+    };
+
+    /**
+     * \param model A mobility model.
+     * \return its epoch slot, registering it the first time.
+     */
+    uint32_t Slot(Ptr<MobilityModel> model);
+    /**
+     * CourseChange trace sink.
+     * \param epoch The epoch to bump.
+     * \param model The mobility model.
+     */
+    static void Moved(uint64_t* epoch, Ptr<const MobilityModel> model);
+
+    std::unordered_map<Key, Entry, PairHash> m_entries;         //!< Results by pair.
+    std::unordered_map<const MobilityModel*, uint32_t> m_slots; //!< Epoch slot by model.
+    std::vector<std::unique_ptr<uint64_t>> m_epochs;            //!< Epochs, stable addresses.
+    std::vector<Ptr<MobilityModel>> m_models;                   //!< Model of each slot.
+    uint64_t m_hits{0};                                         //!< Cache hits.
+    uint64_t m_misses{0};                                       //!< Cache misses.
+};
+
+/**
+ * Propagation loss model that memoizes the loss of another one per
+ * (sender, receiver) pair, see PropagationCache.
+ *
+ * The wrapped model must be deterministic and its received power must be
+ * the Tx power minus a loss that does not depend on the Tx power, as for
+ * the Friis, log distance, two-ray ground or three log distance models;
+ * the loss is what is cached.  Do not wrap random fading models.
+ */
+class CachedPropagationLossModel : public PropagationLossModel
+{
+  public:
+    /**
+     * Register this type.
+     * \return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * \return the cache.
+     */
+    const PropagationCache<double>& GetCache() const;
+
+  private:
+    double DoCalcRxPower(double txPowerDbm,
+                         Ptr<MobilityModel> a,
+                         Ptr<MobilityModel> b) const override;
+    int64_t DoAssignStreams(int64_t stream) override;
+    void DoDispose() override;
+
+    /**
+     * \return the wrapped model, created on first use.
+     */
+    Ptr<PropagationLossModel> GetInner() const;
+
+    std::string m_innerType;                   //!< Wrapped model TypeId name.
+    mutable Ptr<PropagationLossModel> m_inner; //!< Wrapped model.
+    mutable PropagationCache<double> m_cache;  //!< Losses in dB.
+};
+
+/**
+ * Propagation delay model that memoizes the delay of another one per
+ * (sender, receiver) pair, see PropagationCache.  The wrapped model must be
+ * deterministic.
+ */
+class CachedPropagationDelayModel : public PropagationDelayModel
+{
+  public:
+    /**
+     * Register this type.
+     * \return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    Time GetDelay(Ptr<MobilityModel> a, Ptr<MobilityModel> b) const override;
+
+    /**
+     * \return the cache.
+     */
+    const PropagationCache<Time>& GetCache() const;
+
+  private:
+    int64_t DoAssignStreams(int64_t stream) override;
+    void DoDispose() override;
+
+    /**
+     * \return the wrapped model, created on first use.
+     */
+    Ptr<PropagationDelayModel> GetInner() const;
+
+    std::string m_innerType;                    //!< Wrapped model TypeId name.
+    mutable Ptr<PropagationDelayModel> m_inner; //!< Wrapped model.
+    mutable PropagationCache<Time> m_cache;     //!< Delays.
+};
+
+/**
+ * \return a channel helper equivalent to YansWifiChannelHelper::Default()
+ * (log distance loss, constant speed delay) with both models cached.
+ */
+inline YansWifiChannelHelper
+CachedYansWifiChannelHelper()
+{
+    YansWifiChannelHelper helper;
+    helper.SetPropagationDelay("ns3::CachedPropagationDelayModel",
+                               "InnerType",
+                               StringValue("ns3::ConstantSpeedPropagationDelayModel"));
+    helper.AddPropagationLoss("ns3::CachedPropagationLossModel",
+                              "InnerType",
+                              StringValue("ns3::LogDistancePropagationLossModel"));
+    return helper;
+}
+
+NS_OBJECT_ENSURE_REGISTERED(CachedPropagationLossModel);
+NS_OBJECT_ENSURE_REGISTERED(CachedPropagationDelayModel);
+
+template <typename T>
+uint32_t
+PropagationCache<T>::Slot(Ptr<MobilityModel> model)
+{
+    auto it = m_slots.find(PeekPointer(model));
+    if (it != m_slots.end())
+    {
+        return it->second;
+    }
+    auto slot = static_cast<uint32_t>(m_epochs.size());
+    m_epochs.push_back(std::make_unique<uint64_t>(0));
+    m_slots[PeekPointer(model)] = slot;
+    m_models.push_back(model);
+    model->TraceConnectWithoutContext("CourseChange",
+                                      MakeBoundCallback(&PropagationCache<T>::Moved,
+                                                        m_epochs.back().get()));
+    return slot;
+}
+
+template <typename T>
+PropagationCache<T>::~PropagationCache()
+{
+    Clear();
+}
+
+template <typename T>
+void
+PropagationCache<T>::Clear()
+{
+    for (std::size_t slot = 0; slot < m_models.size(); slot++)
+    {
+        m_models[slot]->TraceDisconnectWithoutContext(
+            "CourseChange",
+            MakeBoundCallback(&PropagationCache<T>::Moved, m_epochs[slot].get()));
+    }
+    m_entries.clear();
+    m_slots.clear();
+    m_epochs.clear();
+    m_models.clear();
+}
+
+template <typename T>
+void
+PropagationCache<T>::Moved(uint64_t* epoch, Ptr<const MobilityModel> /* model */)
+{
+    (*epoch)++;
+}
+
+template <typename T>
+bool
+PropagationCache<T>::Lookup(Ptr<MobilityModel> a, Ptr<MobilityModel> b, T& value)
+{
+    auto it = m_entries.find({PeekPointer(a), PeekPointer(b)});
+    if (it != m_entries.end() && *m_epochs[it->second.slotA] == it->second.epochA &&
+        *m_epochs[it->second.slotB] == it->second.epochB)
+    {
+        m_hits++;
+        value = it->second.value;
+        return true;
+    }
+    m_misses++;
+    return false;
+}
+
+template <typename T>
+void
+PropagationCache<T>::Store(Ptr<MobilityModel> a, Ptr<MobilityModel> b, const T& value)
+{
+    Vector va = a->GetVelocity();
+    Vector vb = b->GetVelocity();
+    if (va.x != 0 || va.y != 0 || va.z != 0 || vb.x != 0 || vb.y != 0 || vb.z != 0)
+    {
+        // the position changes without a CourseChange
+        return;
+    }
+    uint32_t slotA = Slot(a);
+    uint32_t slotB = Slot(b);
+    m_entries[{PeekPointer(a), PeekPointer(b)}] =
+        Entry{value, slotA, slotB, *m_epochs[slotA], *m_epochs[slotB]};
+}
+
+template <typename T>
+uint64_t
+PropagationCache<T>::GetHits() const
+{
+    return m_hits;
+}
+
+template <typename T>
+uint64_t
+PropagationCache<T>::GetMisses() const
+{
+    return m_misses;
+}
+
+inline TypeId
+CachedPropagationLossModel::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::CachedPropagationLossModel")
+            .SetParent<PropagationLossModel>()
+            .SetGroupName("Propagation")
+            .AddConstructor<CachedPropagationLossModel>()
+            .AddAttribute("InnerType",
+                          "TypeId name of the deterministic loss model to cache.",
+                          StringValue("ns3::LogDistancePropagationLossModel"),
+                          MakeStringAccessor(&CachedPropagationLossModel::m_innerType),
+                          MakeStringChecker());
+    return tid;
+}
+
+inline Ptr<PropagationLossModel>
+CachedPropagationLossModel::GetInner() const
+{
+    if (!m_inner)
+    {
+        ObjectFactory factory(m_innerType);
+        m_inner = factory.Create<PropagationLossModel>();
+    }
+    return m_inner;
+}
+
+inline const PropagationCache<double>&
+CachedPropagationLossModel::GetCache() const
+{
+    return m_cache;
+}
+
+inline double
+CachedPropagationLossModel::DoCalcRxPower(double txPowerDbm,
+                                          Ptr<MobilityModel> a,
+                                          Ptr<MobilityModel> b) const
+{
+    double lossDb;
+    if (!m_cache.Lookup(a, b, lossDb))
+    {
+        lossDb = txPowerDbm - GetInner()->CalcRxPower(txPowerDbm, a, b);
+        m_cache.Store(a, b, lossDb);
+    }
+    return txPowerDbm - lossDb;
+}
+
+inline int64_t
+CachedPropagationLossModel::DoAssignStreams(int64_t stream)
+{
+    return GetInner()->AssignStreams(stream);
+}
+
+inline void
+CachedPropagationLossModel::DoDispose()
+{
+    m_inner = nullptr;
+    m_cache.Clear();
+    PropagationLossModel::DoDispose();
+}
+
+inline TypeId
+CachedPropagationDelayModel::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::CachedPropagationDelayModel")
+            .SetParent<PropagationDelayModel>()
+            .SetGroupName("Propagation")
+            .AddConstructor<CachedPropagationDelayModel>()
+            .AddAttribute("InnerType",
+                          "TypeId name of the deterministic delay model to cache.",
+                          StringValue("ns3::ConstantSpeedPropagationDelayModel"),
+                          MakeStringAccessor(&CachedPropagationDelayModel::m_innerType),
+                          MakeStringChecker());
+    return tid;
+}
+
+inline Ptr<PropagationDelayModel>
+CachedPropagationDelayModel::GetInner() const
+{
+    if (!m_inner)
+    {
+        ObjectFactory factory(m_innerType);
+        m_inner = factory.Create<PropagationDelayModel>();
+    }
+    return m_inner;
+}
+
+inline const PropagationCache<Time>&
+CachedPropagationDelayModel::GetCache() const
+{
+    return m_cache;
+}
+
+inline Time
+CachedPropagationDelayModel::GetDelay(Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+{
+    Time delay;
+    if (!m_cache.Lookup(a, b, delay))
+    {
+        delay = GetInner()->GetDelay(a, b);
+        m_cache.Store(a, b, delay);
+    }
+    return delay;
+}
+
+inline int64_t
+CachedPropagationDelayModel::DoAssignStreams(int64_t stream)
+{
+    return GetInner()->AssignStreams(stream);
+}
+
+inline void
+CachedPropagationDelayModel::DoDispose()
+{
+    m_inner = nullptr;
+    m_cache.Clear();
+    PropagationDelayModel::DoDispose();
+}
+
+} // namespace ns3
+
+#endif /* CACHED_PROPAGATION_H */
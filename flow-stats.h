@@ -0,0 +1,535 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef FLOW_STATS_H
+#define FLOW_STATS_H
+
+#include "payload-timestamp.h"
+
+#include "ns3/address.h"
+#include "ns3/application-container.h"
+#include "ns3/assert.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/ipv4.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Histogram of positive durations in fixed memory: bins of a quarter octave
+ * from 1 us to 2^27 us (about 134 s), plus one bin below and the last bin
+ * open above.  Adding a sample is a frexp() and an increment.
+ */
+class LogHistogram
+{
+  public:
+    /**
+     * \param seconds The sample.
+     */
+    void Add(double seconds);
+    /**
+     * \return the number of samples.
+     */
+    uint64_t GetCount() const;
+    /**
+     * \param q The quantile, in [0, 1].
+     * \return the upper edge of the bin that holds it, 0 if empty.
+     */
+    double GetQuantile(double q) const;
+    /**
+     * \param bin A bin index.
+     * \return its lower edge in seconds.
+     */
+    static double GetLowerEdge(uint32_t bin);
+    /**
+     * \param bin A bin index.
+     * \return its number of samples.
+     */
+    uint32_t GetBinCount(uint32_t bin) const;
+
+    static constexpr uint32_t SUB_BINS = 4;                  //!< Bins per octave.
+    static constexpr uint32_t OCTAVES = 27;                  //!< Octaves above 1 us.
+    static constexpr uint32_t BINS = 1 + OCTAVES * SUB_BINS; //!< Bins, with the underflow.
+
+  private:
+    std::array<uint32_t, BINS> m_bins{}; //!< Samples per bin.
+    uint64_t m_count{0};                 //!< Samples.
+};
+
+/**
+ * Per-flow statistics taken at the application layer: the source
+ * applications report each packet through their TxWithAddresses trace and
+ * the sinks through Receive(), so the routing protocol and what it does to
+ * the IP layer (DSR inserts its own header between IP and UDP) make no
+ * difference, unlike FlowMonitor, which classifies at the IPv4 hooks.
+ *
+ * Flows are told apart by their UDP 5-tuple, kept in an open-addressing
+ * hash table with linear probing that is looked up once per packet and
+ * doubles when half full.  Each flow has packet and byte counters and
+ * fixed-size delay and jitter histograms (see LogHistogram).  The delay is
+ * the age of the time stamp that starts the payload, a SeqTsHeader or the
+ * SeqTsSizeHeader that AddSources() makes OnOffApplications send; each
+ * flow remembers which one its source writes (see payload-timestamp.h).
+ * The jitter is the RFC 3550
+ * interarrival jitter, J += (|D| - J) / 16 with D the difference between
+ * the delays of consecutive received packets; its histogram and mean are
+ * of the estimate after each packet, and the last one is reported too.
+ *
+ * Nothing is formatted until WriteCsv() and WriteHistogramCsv(), which
+ * write one line per flow and one per non-empty histogram bin.
+ */
+class FlowStats
+{
+  public:
+    FlowStats();
+
+    /**
+     * Account for the packets sent by these applications, which must have
+     * a TxWithAddresses trace (OnOffApplication, MultiFlowSender...), start
+     * their payload with a time stamp for the delay, and run on a node
+     * whose IPv4 interface 1 is the source address.
+     * \param apps The source applications.
+     */
+    void AddSources(const ApplicationContainer& apps);
+    /**
+     * Account for a packet delivered to a sink.
+     * \param packet The packet.
+     * \param from The sender socket address.
+     * \param to The sink socket address.
+     */
+    void Receive(Ptr<const Packet> packet, const Address& from, const Address& to);
+
+    /**
+     * \return the number of flows seen.
+     */
+    uint32_t GetNFlows() const;
+    /**
+     * \return the packets accounted for, sent and received.
+     */
+    uint64_t GetNPackets() const;
+
+    /**
+     * Write one line per flow: 5-tuple, counters, throughput, delay and
+     * jitter mean and quantiles.
+     * \param fileName The output file name.
+     */
+    void WriteCsv(const std::string& fileName) const;
+    /**
+     * Write the non-empty bins of the delay and jitter histograms.
+     * \param fileName The output file name.
+     */
+    void WriteHistogramCsv(const std::string& fileName) const;
+
+  private:
+    /// UDP 5-tuple of a flow.
+    struct FiveTuple
+    {
+        uint32_t source{0};          //!< Source IPv4 address.
+        uint32_t destination{0};     //!< Destination IPv4 address.
+        uint16_t sourcePort{0};      //!< Source port.
+        uint16_t destinationPort{0}; //!< Destination port.
+        uint8_t protocol{17};        //!< IP protocol number.
+
+        /**
+         * \param other Another tuple.
+         * \return true if equal.
+         */
+        bool operator==(const FiveTuple& other) const;
+        /**
+         * \return the hash of the tuple.
+         */
+        uint64_t Hash() const;
+    };
+
+    /// Statistics of one flow.
+    struct Flow
+    {
+        FiveTuple tuple;        //!< Flow identity.
+        uint32_t id{0};         //!< Order of appearance.
+        uint64_t txPackets{0};  //!< Packets sent.
+        uint64_t txBytes{0};    //!< Bytes sent.
+        uint64_t rxPackets{0};  //!< Packets received.
+        uint64_t rxBytes{0};    //!< Bytes received.
+        double firstTx{-1.0};   //!< Time of the first packet sent, -1 if none.
+        double firstRx{-1.0};   //!< Time of the first packet received, -1 if none.
+        double lastRx{-1.0};    //!< Time of the last packet received, -1 if none.
+        double delaySum{0};     //!< Sum of the delays in seconds.
+        double jitterSum{0};    //!< Sum of the jitter estimates in seconds.
+        double rfcJitter{0};    //!< RFC 3550 jitter estimate in seconds.
+        double lastDelay{-1.0}; //!< Delay of the previous packet, -1 if none.
+        bool sizeHeader{false}; //!< The source sends a SeqTsSizeHeader.
+        LogHistogram delay;     //!< Delay distribution.
+        LogHistogram jitter;    //!< Jitter distribution.
+    };
+
+    /// TxWithAddresses trace sink bound to the address of a source node.
+    struct Source
+    {
+        FlowStats* stats; //!< Owner.
+        uint32_t address; //!< IPv4 address of the node.
+        bool sizeHeader;  //!< It sends a SeqTsSizeHeader.
+
+        /**
+         * \param packet The packet being sent.
+         * \param from The local socket address.
+         * \param to The remote socket address.
+         */
+        void Transmit(Ptr<const Packet> packet, const Address& from, const Address& to);
+    };
+
+    /**
+     * \param from A socket address.
+     * \param to A socket address.
+     * \param defaultSource The source IPv4 address if from has none.
+     * \return the tuple of a packet from from to to.
+     */
+    static FiveTuple MakeTuple(const Address& from, const Address& to, uint32_t defaultSource);
+    /**
+     * Find a flow, adding it if new.
+     * \param tuple The flow identity.
+     * \return its statistics.
+     */
+    Flow& Lookup(const FiveTuple& tuple);
+    /**
+     * Double the hash table.
+     */
+    void Grow();
+    /**
+     * \return the flows in order of appearance.
+     */
+    std::vector<const Flow*> GetFlows() const;
+
+    std::vector<Flow> m_slots;                      //!< Hash table, power of two sized.
+    std::vector<bool> m_used;                       //!< Slots in use.
+    uint32_t m_nFlows{0};                           //!< Flows in the table.
+    std::vector<std::shared_ptr<Source>> m_sources; //!< Connected trace sinks.
+
+    static constexpr uint32_t INITIAL_SLOTS = 64; //!< Initial hash table size.
+};
+
+inline void
+LogHistogram::Add(double seconds)
+{
+    m_count++;
+    double us = seconds * 1e6;
+    if (!(us >= 1.0))
+    {
+        m_bins[0]++;
+        return;
+    }
+    // us = mantissa * 2^exponent with mantissa in [0.5, 1)
+    int exponent;
+    double mantissa = std::frexp(us, &exponent);
+    uint32_t bin = 1 + (exponent - 1) * SUB_BINS + uint32_t((mantissa - 0.5) * 2 * SUB_BINS);
+    m_bins[std::min(bin, BINS - 1)]++;
+}
+
+inline uint64_t
+LogHistogram::GetCount() const
+{
+    return m_count;
+}
+
+inline double
+LogHistogram::GetLowerEdge(uint32_t bin)
+{
+    if (bin == 0)
+    {
+        return 0;
+    }
+    uint32_t octave = (bin - 1) / SUB_BINS;
+    uint32_t sub = (bin - 1) % SUB_BINS;
+    return 1e-6 * std::ldexp(1.0 + double(sub) / SUB_BINS, octave);
+}
+
+inline uint32_t
+LogHistogram::GetBinCount(uint32_t bin) const
+{
+    return m_bins[bin];
+}
+
+inline double
+LogHistogram::GetQuantile(double q) const
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, std::ceil(q * m_count));
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BINS - 1; i++)
+    {
+        seen += m_bins[i];
+        if (seen >= rank)
+        {
+            return GetLowerEdge(i + 1);
+        }
+    }
+    return GetLowerEdge(BINS - 1);
+}
+
+inline bool
+FlowStats::FiveTuple::operator==(const FiveTuple& other) const
+{
+    return source == other.source && destination == other.destination &&
+           sourcePort == other.sourcePort && destinationPort == other.destinationPort &&
+           protocol == other.protocol;
+}
+
+inline uint64_t
+FlowStats::FiveTuple::Hash() const
+{
+    uint64_t h = (uint64_t(source) << 32 | destination) * 0x9e3779b97f4a7c15ULL;
+    h ^= (uint64_t(sourcePort) << 24 | uint64_t(destinationPort) << 8 | protocol) *
+         0xc2b2ae3d27d4eb4fULL;
+    return h ^ (h >> 29);
+}
+
+inline FlowStats::FlowStats()
+    : m_slots(INITIAL_SLOTS),
+      m_used(INITIAL_SLOTS, false)
+{
+}
+
+inline void
+FlowStats::AddSources(const ApplicationContainer& apps)
+{
+    for (auto it = apps.Begin(); it != apps.End(); ++it)
+    {
+        bool sizeHeader = EnablePayloadTimestamp(*it);
+        Ptr<Ipv4> ipv4 = (*it)->GetNode()->GetObject<Ipv4>();
+        NS_ASSERT_MSG(ipv4 && ipv4->GetNInterfaces() > 1, "Source without an IPv4 interface");
+        // the sources send from an unbound socket, whose address is 0.0.0.0
+        m_sources.push_back(
+            std::make_shared<Source>(
+                Source{this, ipv4->GetAddress(1, 0).GetLocal().Get(), sizeHeader}));
+        (*it)->TraceConnectWithoutContext("TxWithAddresses",
+                                          MakeCallback(&Source::Transmit, m_sources.back().get()));
+    }
+}
+
+inline void
+FlowStats::Source::Transmit(Ptr<const Packet> packet, const Address& from, const Address& to)
+{
+    Flow& flow = stats->Lookup(MakeTuple(from, to, address));
+    if (flow.firstTx < 0)
+    {
+        flow.firstTx = Simulator::Now().GetSeconds();
+    }
+    flow.sizeHeader = sizeHeader;
+    flow.txPackets++;
+    flow.txBytes += packet->GetSize();
+}
+
+inline void
+FlowStats::Receive(Ptr<const Packet> packet, const Address& from, const Address& to)
+{
+    Flow& flow = Lookup(MakeTuple(from, to, 0));
+    double now = Simulator::Now().GetSeconds();
+    if (flow.firstRx < 0)
+    {
+        flow.firstRx = now;
+    }
+    flow.lastRx = now;
+    flow.rxPackets++;
+    flow.rxBytes += packet->GetSize();
+    Time ts;
+    if (PeekPayloadTimestamp(packet, flow.sizeHeader, ts))
+    {
+        double delay = now - ts.GetSeconds();
+        // a negative age means the flow read the wrong header
+        NS_ASSERT_MSG(delay >= 0, "Packet stamped in the future: " << ts);
+        flow.delaySum += delay;
+        flow.delay.Add(delay);
+        if (flow.lastDelay >= 0)
+        {
+            // the transit time is the delay, as the clocks are the same
+            flow.rfcJitter += (std::abs(delay - flow.lastDelay) - flow.rfcJitter) / 16;
+            flow.jitterSum += flow.rfcJitter;
+            flow.jitter.Add(flow.rfcJitter);
+        }
+        flow.lastDelay = delay;
+    }
+}
+
+inline FlowStats::FiveTuple
+FlowStats::MakeTuple(const Address& from, const Address& to, uint32_t defaultSource)
+{
+    FiveTuple tuple;
+    if (InetSocketAddress::IsMatchingType(from))
+    {
+        InetSocketAddress a = InetSocketAddress::ConvertFrom(from);
+        tuple.source = a.GetIpv4().Get();
+        tuple.sourcePort = a.GetPort();
+    }
+    if (tuple.source == 0)
+    {
+        tuple.source = defaultSource;
+    }
+    if (InetSocketAddress::IsMatchingType(to))
+    {
+        InetSocketAddress a = InetSocketAddress::ConvertFrom(to);
+        tuple.destination = a.GetIpv4().Get();
+        tuple.destinationPort = a.GetPort();
+    }
+    return tuple;
+}
+
+inline FlowStats::Flow&
+FlowStats::Lookup(const FiveTuple& tuple)
+{
+    std::size_t mask = m_slots.size() - 1;
+    for (std::size_t i = tuple.Hash() & mask;; i = (i + 1) & mask)
+    {
+        if (!m_used[i])
+        {
+            if (2 * (m_nFlows + 1) > m_slots.size())
+            {
+                Grow();
+                return Lookup(tuple);
+            }
+            m_used[i] = true;
+            m_slots[i].tuple = tuple;
+            m_slots[i].id = m_nFlows++;
+            return m_slots[i];
+        }
+        if (m_slots[i].tuple == tuple)
+        {
+            return m_slots[i];
+        }
+    }
+}
+
+inline void
+FlowStats::Grow()
+{
+    std::vector<Flow> slots(2 * m_slots.size());
+    std::vector<bool> used(slots.size(), false);
+    std::size_t mask = slots.size() - 1;
+    for (std::size_t j = 0; j < m_slots.size(); j++)
+    {
+        if (!m_used[j])
+        {
+            continue;
+        }
+        std::size_t i = m_slots[j].tuple.Hash() & mask;
+        while (used[i])
+        {
+            i = (i + 1) & mask;
+        }
+        used[i] = true;
+        slots[i] = m_slots[j];
+    }
+    m_slots.swap(slots);
+    m_used.swap(used);
+}
+
+inline uint32_t
+FlowStats::GetNFlows() const
+{
+    return m_nFlows;
+}
+
+inline uint64_t
+FlowStats::GetNPackets() const
+{
+    uint64_t packets = 0;
+    for (const Flow* flow : GetFlows())
+    {
+        packets += flow->txPackets + flow->rxPackets;
+    }
+    return packets;
+}
+
+inline std::vector<const FlowStats::Flow*>
+FlowStats::GetFlows() const
+{
+    std::vector<const Flow*> flows(m_nFlows);
+    for (std::size_t i = 0; i < m_slots.size(); i++)
+    {
+        if (m_used[i])
+        {
+            flows[m_slots[i].id] = &m_slots[i];
+        }
+    }
+    return flows;
+}
+
+inline void
+FlowStats::WriteCsv(const std::string& fileName) const
+{
+    std::ofstream out(fileName);
+    out << "FlowId,Source,Destination,SourcePort,DestinationPort,Protocol,TxPackets,TxBytes,"
+           "RxPackets,RxBytes,LostPackets,ThroughputKbps,MeanDelay,DelayP50,DelayP99,"
+           "MeanJitter,JitterP99,Jitter\n";
+    for (const Flow* flow : GetFlows())
+    {
+        const FiveTuple& t = flow->tuple;
+        double duration = flow->lastRx - flow->firstTx;
+        uint64_t delayed = flow->delay.GetCount();
+        uint64_t jittered = flow->jitter.GetCount();
+        out << flow->id << "," << Ipv4Address(t.source) << "," << Ipv4Address(t.destination)
+            << "," << t.sourcePort << "," << t.destinationPort << "," << unsigned(t.protocol)
+            << "," << flow->txPackets << "," << flow->txBytes << "," << flow->rxPackets << ","
+            << flow->rxBytes << ","
+            << (flow->txPackets > flow->rxPackets ? flow->txPackets - flow->rxPackets : 0) << ","
+            << (flow->firstTx >= 0 && duration > 0 ? flow->rxBytes * 8.0 / 1000 / duration : 0)
+            << "," << (delayed ? flow->delaySum / delayed : 0) << ","
+            << flow->delay.GetQuantile(0.5) << "," << flow->delay.GetQuantile(0.99) << ","
+            << (jittered ? flow->jitterSum / jittered : 0) << ","
+            << flow->jitter.GetQuantile(0.99) << "," << flow->rfcJitter << "\n";
+    }
+}
+
+inline void
+FlowStats::WriteHistogramCsv(const std::string& fileName) const
+{
+    std::ofstream out(fileName);
+    out << "FlowId,Kind,LowerEdge,Count\n";
+    for (const Flow* flow : GetFlows())
+    {
+        for (const auto& kind : {std::make_pair("delay", &flow->delay),
+                                 std::make_pair("jitter", &flow->jitter)})
+        {
+            for (uint32_t i = 0; i < LogHistogram::BINS; i++)
+            {
+                uint32_t count = kind.second->GetBinCount(i);
+                if (count > 0)
+                {
+                    out << flow->id << "," << kind.first << "," << LogHistogram::GetLowerEdge(i)
+                        << "," << count << "\n";
+                }
+            }
+        }
+    }
+}
+
+} // namespace ns3
+
+#endif /* FLOW_STATS_H */
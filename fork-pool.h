@@ -0,0 +1,227 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef FORK_POOL_H
+#define FORK_POOL_H
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <thread>
+
+/**
+ * Bounded pool of forked worker processes.
+ *
+ * ns-3 keeps its simulator, node list and random streams in process-wide
+ * singletons, so independent simulations cannot share a process.  Each job
+ * submitted to the pool runs in its own child process; at most
+ * GetMaxWorkers() children are alive at any time and Start() blocks until a
+ * slot becomes free.  Jobs must be started before any simulation state
+ * exists in the parent, unless they are meant to continue the parent's
+ * simulation from where it stopped; either way the parent must not have
+ * other threads running, since only the forking thread exists in a child.
+ */
+class ForkPool
+{
+  public:
+    /**
+     * A job runs in the child; its return value becomes the exit status.
+     */
+    using Job = std::function<int()>;
+    /**
+     * Called in the parent each time a child is reaped.
+     * \param id The id returned by Start() for that job.
+     * \param status The exit status, or 128 + signal number if it was killed.
+     */
+    using Finished = std::function<void(std::size_t id, int status)>;
+
+    /**
+     * \param maxWorkers Maximum number of concurrent children, 0 for one per core.
+     * \param finished Completion callback, may be empty.
+     */
+    ForkPool(unsigned maxWorkers, Finished finished);
+    /**
+     * Waits for all outstanding children.
+     */
+    ~ForkPool();
+
+    /**
+     * Fork a child running the job, waiting for a free slot first.
+     * \param job The job.
+     * \return the job id passed to the completion callback.
+     */
+    std::size_t Start(Job job);
+    /**
+     * Block until every started job has finished.
+     */
+    void WaitAll();
+    /**
+     * Block until one started job has finished, if any is running.
+     */
+    void WaitOne();
+    /**
+     * \return the maximum number of concurrent children.
+     */
+    unsigned GetMaxWorkers() const;
+    /**
+     * \return the number of children still running.
+     */
+    std::size_t GetRunning() const;
+    /**
+     * \return the id the next Start() will return, so that the caller can
+     * be ready for a completion callback made from within Start() when the
+     * fork fails.
+     */
+    std::size_t GetNextId() const;
+
+  private:
+    /**
+     * Reap one child and report it.
+     */
+    void ReapOne();
+
+    unsigned m_maxWorkers;                  //!< Concurrency bound.
+    Finished m_finished;                    //!< Completion callback.
+    std::map<pid_t, std::size_t> m_running; //!< Live children and their job ids.
+    std::size_t m_nextId{0};                //!< Id of the next job.
+};
+
+inline ForkPool::ForkPool(unsigned maxWorkers, Finished finished)
+    : m_maxWorkers(maxWorkers),
+      m_finished(finished)
+{
+    if (m_maxWorkers == 0)
+    {
+        m_maxWorkers = std::max(1U, std::thread::hardware_concurrency());
+    }
+}
+
+inline ForkPool::~ForkPool()
+{
+    WaitAll();
+}
+
+inline unsigned
+ForkPool::GetMaxWorkers() const
+{
+    return m_maxWorkers;
+}
+
+inline std::size_t
+ForkPool::GetRunning() const
+{
+    return m_running.size();
+}
+
+inline std::size_t
+ForkPool::GetNextId() const
+{
+    return m_nextId;
+}
+
+inline std::size_t
+ForkPool::Start(Job job)
+{
+    while (m_running.size() >= m_maxWorkers)
+    {
+        ReapOne();
+    }
+
+    // anything still buffered would otherwise be written by both processes
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+
+    std::size_t id = m_nextId++;
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        std::perror("fork");
+        if (m_finished)
+        {
+            m_finished(id, 127);
+        }
+        return id;
+    }
+    if (pid == 0)
+    {
+        int status = job();
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(nullptr);
+        _exit(status);
+    }
+    m_running[pid] = id;
+    return id;
+}
+
+inline void
+ForkPool::WaitAll()
+{
+    while (!m_running.empty())
+    {
+        ReapOne();
+    }
+}
+
+inline void
+ForkPool::WaitOne()
+{
+    std::size_t running = m_running.size();
+    while (!m_running.empty() && m_running.size() == running)
+    {
+        ReapOne();
+    }
+}
+
+inline void
+ForkPool::ReapOne()
+{
+    int wstatus = 0;
+    pid_t pid = waitpid(-1, &wstatus, 0);
+    if (pid < 0)
+    {
+        if (errno == EINTR)
+        {
+            return;
+        }
+        // no children left that we know of
+        m_running.clear();
+        return;
+    }
+    auto it = m_running.find(pid);
+    if (it == m_running.end())
+    {
+        return;
+    }
+    std::size_t id = it->second;
+    m_running.erase(it);
+
+    int status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128 + WTERMSIG(wstatus);
+    if (m_finished)
+    {
+        m_finished(id, status);
+    }
+}
+
+#endif /* FORK_POOL_H */
@@ -0,0 +1,508 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef GRID_SPECTRUM_CHANNEL_H
+#define GRID_SPECTRUM_CHANNEL_H
+
+#include "ns3/angles.h"
+#include "ns3/antenna-model.h"
+#include "ns3/double.h"
+#include "ns3/mobility-model.h"
+#include "ns3/net-device.h"
+#include "ns3/node.h"
+#include "ns3/nstime.h"
+#include "ns3/propagation-delay-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/simulator.h"
+#include "ns3/spectrum-channel.h"
+#include "ns3/spectrum-phy.h"
+#include "ns3/spectrum-propagation-loss-model.h"
+#include "ns3/spectrum-signal-parameters.h"
+#include "ns3/spectrum-value.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Spectrum channel that only delivers a transmission to the PHYs within
+ * MaxRange of the sender.
+ *
+ * YansWifiChannel hands every frame to every other PHY and evaluates the
+ * propagation loss for each of them, which makes a shared ad hoc channel
+ * O(N) per frame.  This channel keeps the PHYs in a uniform grid of
+ * MaxRange sized cells and, for each transmission, only looks at the cells
+ * around the sender.  The candidates are then handled exactly as
+ * SingleModelSpectrumChannel does (antenna gains, propagation loss and
+ * delay, MaxLossDb, spectrum propagation loss), except that receivers
+ * farther than MaxRange are skipped, and in the same order, so the result
+ * is the one of full delivery with a MaxRange cut.
+ *
+ * A PHY is moved to its new cell when its mobility model reports a course
+ * change, and all PHYs are re-binned every RefreshInterval.  Between two
+ * refreshes a node may drift out of its cell, so the cells searched cover
+ * MaxRange plus MaxSpeed times the time since the last refresh.  MaxSpeed
+ * must therefore be at least the speed of the fastest node.
+ *
+ * With MaxRange set to 0 every PHY is a candidate, as with
+ * SingleModelSpectrumChannel.  All PHYs must use the same spectrum model.
+ */
+class GridSpectrumChannel : public SpectrumChannel
+{
+  public:
+    /**
+     * Register this type.
+     * \return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    void AddRx(Ptr<SpectrumPhy> phy) override;
+    void RemoveRx(Ptr<SpectrumPhy> phy) override;
+    void StartTx(Ptr<SpectrumSignalParameters> params) override;
+    std::size_t GetNDevices() const override;
+    Ptr<NetDevice> GetDevice(std::size_t i) const override;
+
+    /**
+     * \return the number of receivers looked at by the transmissions so far.
+     */
+    uint64_t GetCandidateCount() const;
+    /**
+     * \return the number of receivers the transmissions were delivered to.
+     */
+    uint64_t GetDeliveryCount() const;
+
+  private:
+    void DoDispose() override;
+
+    /// A receiving PHY and its place in the grid.
+    struct Receiver
+    {
+        Ptr<SpectrumPhy> phy;        //!< The PHY, null once removed.
+        Ptr<MobilityModel> mobility; //!< Its mobility, null until connected.
+        int64_t cell{0};             //!< Grid cell.
+        uint32_t slot{0};            //!< Position in the cell list.
+        bool placed{false};          //!< Whether it is in a cell.
+    };
+
+    /**
+     * \param x A coordinate.
+     * \return its cell index along that axis.
+     */
+    int32_t CellIndex(double x) const;
+    /**
+     * \param cx Cell index along x.
+     * \param cy Cell index along y.
+     * \return the cell key.
+     */
+    static int64_t CellKey(int32_t cx, int32_t cy);
+    /**
+     * Put a receiver in the cell of its current position.
+     * \param index The receiver.
+     */
+    void Rebin(uint32_t index);
+    /**
+     * Take a receiver out of its cell.
+     * \param index The receiver.
+     */
+    void Unplace(uint32_t index);
+    /**
+     * Disconnect from the CourseChange trace of a receiver, if connected.
+     * \param index The receiver.
+     */
+    void Disconnect(uint32_t index);
+    /**
+     * Re-bin all the receivers if RefreshInterval has elapsed.
+     */
+    void MaybeRefresh();
+    /**
+     * Collect the receivers that may be within MaxRange of a position.
+     * \param position The sender position.
+     */
+    void CollectCandidates(const Vector& position);
+    /**
+     * CourseChange trace sink.
+     * \param channel The channel.
+     * \param index The receiver.
+     * \param mobility The mobility model.
+     */
+    static void CourseChanged(GridSpectrumChannel* channel,
+                              uint32_t index,
+                              Ptr<const MobilityModel> mobility);
+    /**
+     * Deliver a signal to a receiver.
+     * \param params The signal.
+     * \param receiver The receiver.
+     */
+    static void StartRx(Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver);
+
+    double m_maxRange;                                          //!< Delivery range, 0 for all.
+    double m_maxSpeed;                                          //!< Highest node speed.
+    Time m_refreshInterval;                                     //!< Full re-binning period.
+    Time m_lastRefresh{Seconds(-1)};                            //!< Last full re-binning.
+    std::vector<Receiver> m_receivers;                          //!< Receivers, in AddRx order.
+    std::unordered_map<int64_t, std::vector<uint32_t>> m_cells; //!< Receivers by cell.
+    std::vector<uint32_t> m_unplaced;                           //!< Receivers with no position.
+    std::vector<uint32_t> m_candidates;                         //!< Scratch candidate list.
+    uint64_t m_candidateCount{0};                               //!< Receivers looked at.
+    uint64_t m_deliveryCount{0};                                //!< Receivers delivered to.
+};
+
+NS_OBJECT_ENSURE_REGISTERED(GridSpectrumChannel);
+
+inline TypeId
+GridSpectrumChannel::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::GridSpectrumChannel")
+            .SetParent<SpectrumChannel>()
+            .SetGroupName("Spectrum")
+            .AddConstructor<GridSpectrumChannel>()
+            .AddAttribute("MaxRange",
+                          "Receivers farther than this from the sender (m) are skipped, "
+                          "0 to deliver to all of them.",
+                          DoubleValue(0),
+                          MakeDoubleAccessor(&GridSpectrumChannel::m_maxRange),
+                          MakeDoubleChecker<double>(0))
+            .AddAttribute("MaxSpeed",
+                          "Upper bound of the node speeds (m/s).",
+                          DoubleValue(30),
+                          MakeDoubleAccessor(&GridSpectrumChannel::m_maxSpeed),
+                          MakeDoubleChecker<double>(0))
+            .AddAttribute("RefreshInterval",
+                          "Period of the full re-binning of the receivers.",
+                          TimeValue(Seconds(1)),
+                          MakeTimeAccessor(&GridSpectrumChannel::m_refreshInterval),
+                          MakeTimeChecker());
+    return tid;
+}
+
+inline void
+GridSpectrumChannel::DoDispose()
+{
+    // the trace sinks are bound to this channel and to receiver indices
+    for (uint32_t i = 0; i < m_receivers.size(); i++)
+    {
+        Disconnect(i);
+    }
+    m_receivers.clear();
+    m_cells.clear();
+    m_unplaced.clear();
+    SpectrumChannel::DoDispose();
+}
+
+inline void
+GridSpectrumChannel::AddRx(Ptr<SpectrumPhy> phy)
+{
+    // the mobility is usually installed after the devices, it is looked up
+    // on the next refresh
+    Receiver r;
+    r.phy = phy;
+    m_receivers.push_back(r);
+    m_unplaced.push_back(m_receivers.size() - 1);
+    m_lastRefresh = Seconds(-1);
+}
+
+inline void
+GridSpectrumChannel::RemoveRx(Ptr<SpectrumPhy> phy)
+{
+    for (uint32_t i = 0; i < m_receivers.size(); i++)
+    {
+        if (m_receivers[i].phy == phy)
+        {
+            Unplace(i);
+            Disconnect(i);
+            m_unplaced.erase(std::remove(m_unplaced.begin(), m_unplaced.end(), i),
+                             m_unplaced.end());
+            m_receivers[i].phy = nullptr;
+        }
+    }
+}
+
+inline std::size_t
+GridSpectrumChannel::GetNDevices() const
+{
+    return m_receivers.size();
+}
+
+inline Ptr<NetDevice>
+GridSpectrumChannel::GetDevice(std::size_t i) const
+{
+    NS_ASSERT(i < m_receivers.size());
+    return m_receivers[i].phy ? m_receivers[i].phy->GetDevice() : nullptr;
+}
+
+inline uint64_t
+GridSpectrumChannel::GetCandidateCount() const
+{
+    return m_candidateCount;
+}
+
+inline uint64_t
+GridSpectrumChannel::GetDeliveryCount() const
+{
+    return m_deliveryCount;
+}
+
+inline int32_t
+GridSpectrumChannel::CellIndex(double x) const
+{
+    return static_cast<int32_t>(std::floor(x / m_maxRange));
+}
+
+inline int64_t
+GridSpectrumChannel::CellKey(int32_t cx, int32_t cy)
+{
+    return (static_cast<int64_t>(cx) << 32) | static_cast<uint32_t>(cy);
+}
+
+inline void
+GridSpectrumChannel::Unplace(uint32_t index)
+{
+    Receiver& r = m_receivers[index];
+    if (!r.placed)
+    {
+        return;
+    }
+    std::vector<uint32_t>& cell = m_cells[r.cell];
+    uint32_t moved = cell.back();
+    cell[r.slot] = moved;
+    m_receivers[moved].slot = r.slot;
+    cell.pop_back();
+    r.placed = false;
+}
+
+inline void
+GridSpectrumChannel::Rebin(uint32_t index)
+{
+    Receiver& r = m_receivers[index];
+    if (!r.phy || !r.mobility)
+    {
+        return;
+    }
+    Vector p = r.mobility->GetPosition();
+    int64_t cell = CellKey(CellIndex(p.x), CellIndex(p.y));
+    if (r.placed && r.cell == cell)
+    {
+        return;
+    }
+    Unplace(index);
+    std::vector<uint32_t>& list = m_cells[cell];
+    r.cell = cell;
+    r.slot = list.size();
+    r.placed = true;
+    list.push_back(index);
+}
+
+inline void
+GridSpectrumChannel::CourseChanged(GridSpectrumChannel* channel,
+                                   uint32_t index,
+                                   Ptr<const MobilityModel> /* mobility */)
+{
+    channel->Rebin(index);
+}
+
+inline void
+GridSpectrumChannel::Disconnect(uint32_t index)
+{
+    Receiver& r = m_receivers[index];
+    if (!r.mobility)
+    {
+        return;
+    }
+    r.mobility->TraceDisconnectWithoutContext(
+        "CourseChange",
+        MakeBoundCallback(&GridSpectrumChannel::CourseChanged, this, index));
+    r.mobility = nullptr;
+}
+
+inline void
+GridSpectrumChannel::MaybeRefresh()
+{
+    Time now = Simulator::Now();
+    if (m_lastRefresh >= Time(0) && now - m_lastRefresh < m_refreshInterval)
+    {
+        return;
+    }
+    m_lastRefresh = now;
+
+    // pick up the mobility models installed since the last refresh
+    std::vector<uint32_t> unplaced;
+    for (uint32_t index : m_unplaced)
+    {
+        Receiver& r = m_receivers[index];
+        r.mobility = r.phy->GetMobility();
+        if (!r.mobility)
+        {
+            unplaced.push_back(index);
+            continue;
+        }
+        r.mobility->TraceConnectWithoutContext(
+            "CourseChange",
+            MakeBoundCallback(&GridSpectrumChannel::CourseChanged, this, index));
+    }
+    m_unplaced.swap(unplaced);
+
+    for (uint32_t i = 0; i < m_receivers.size(); i++)
+    {
+        Rebin(i);
+    }
+}
+
+inline void
+GridSpectrumChannel::CollectCandidates(const Vector& position)
+{
+    m_candidates.clear();
+    double slack = m_maxSpeed * (Simulator::Now() - m_lastRefresh).GetSeconds();
+    auto reach = static_cast<int32_t>(std::ceil((m_maxRange + slack) / m_maxRange));
+    int32_t cx = CellIndex(position.x);
+    int32_t cy = CellIndex(position.y);
+    for (int32_t x = cx - reach; x <= cx + reach; x++)
+    {
+        for (int32_t y = cy - reach; y <= cy + reach; y++)
+        {
+            auto it = m_cells.find(CellKey(x, y));
+            if (it != m_cells.end())
+            {
+                m_candidates.insert(m_candidates.end(), it->second.begin(), it->second.end());
+            }
+        }
+    }
+    m_candidates.insert(m_candidates.end(), m_unplaced.begin(), m_unplaced.end());
+    // deliver in AddRx order, like full delivery, so that simultaneous
+    // receptions are scheduled in the same order
+    std::sort(m_candidates.begin(), m_candidates.end());
+}
+
+inline void
+GridSpectrumChannel::StartTx(Ptr<SpectrumSignalParameters> txParams)
+{
+    NS_ASSERT_MSG(txParams->psd, "NULL txPsd");
+    NS_ASSERT_MSG(txParams->txPhy, "NULL txPhy");
+
+    Ptr<SpectrumSignalParameters> txParamsTrace = txParams->Copy();
+    m_txSigParamsTrace(txParamsTrace);
+
+    Ptr<MobilityModel> senderMobility = txParams->txPhy->GetMobility();
+    Ptr<NetDevice> txNetDevice = txParams->txPhy->GetDevice();
+    Vector senderPosition;
+
+    m_candidates.clear();
+    if (m_maxRange > 0 && senderMobility)
+    {
+        MaybeRefresh();
+        senderPosition = senderMobility->GetPosition();
+        CollectCandidates(senderPosition);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < m_receivers.size(); i++)
+        {
+            m_candidates.push_back(i);
+        }
+    }
+    m_candidateCount += m_candidates.size();
+
+    for (uint32_t index : m_candidates)
+    {
+        Ptr<SpectrumPhy> rxPhy = m_receivers[index].phy;
+        if (!rxPhy || rxPhy == txParams->txPhy)
+        {
+            continue;
+        }
+        Ptr<NetDevice> rxNetDevice = rxPhy->GetDevice();
+        if (rxNetDevice && txNetDevice &&
+            rxNetDevice->GetNode()->GetId() == txNetDevice->GetNode()->GetId())
+        {
+            continue;
+        }
+
+        Ptr<MobilityModel> receiverMobility = rxPhy->GetMobility();
+        if (m_maxRange > 0 && senderMobility && receiverMobility &&
+            CalculateDistance(senderPosition, receiverMobility->GetPosition()) > m_maxRange)
+        {
+            continue;
+        }
+
+        Time delay = MicroSeconds(0);
+        Ptr<SpectrumSignalParameters> rxParams = txParams->Copy();
+        if (senderMobility && receiverMobility)
+        {
+            double pathLossDb = 0;
+            if (txParams->txAntenna)
+            {
+                Angles txAngles(receiverMobility->GetPosition(), senderMobility->GetPosition());
+                pathLossDb -= txParams->txAntenna->GetGainDb(txAngles);
+            }
+            Ptr<AntennaModel> rxAntenna = DynamicCast<AntennaModel>(rxPhy->GetAntenna());
+            if (rxAntenna)
+            {
+                Angles rxAngles(senderMobility->GetPosition(), receiverMobility->GetPosition());
+                pathLossDb -= rxAntenna->GetGainDb(rxAngles);
+            }
+            if (m_propagationLoss)
+            {
+                pathLossDb -= m_propagationLoss->CalcRxPower(0, senderMobility, receiverMobility);
+            }
+            m_pathLossTrace(txParams->txPhy, rxPhy, pathLossDb);
+            if (pathLossDb > m_maxLossDb)
+            {
+                // beyond the loss threshold, as in SingleModelSpectrumChannel
+                continue;
+            }
+            *(rxParams->psd) *= std::pow(10.0, -pathLossDb / 10.0);
+            if (m_spectrumPropagationLoss)
+            {
+                rxParams->psd =
+                    m_spectrumPropagationLoss->CalcRxPowerSpectralDensity(rxParams,
+                                                                          senderMobility,
+                                                                          receiverMobility);
+            }
+            if (m_propagationDelay)
+            {
+                delay = m_propagationDelay->GetDelay(senderMobility, receiverMobility);
+            }
+        }
+
+        m_deliveryCount++;
+        if (rxNetDevice)
+        {
+            Simulator::ScheduleWithContext(rxNetDevice->GetNode()->GetId(),
+                                           delay,
+                                           &GridSpectrumChannel::StartRx,
+                                           rxParams,
+                                           rxPhy);
+        }
+        else
+        {
+            Simulator::Schedule(delay, &GridSpectrumChannel::StartRx, rxParams, rxPhy);
+        }
+    }
+}
+
+inline void
+GridSpectrumChannel::StartRx(Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver)
+{
+    receiver->StartRx(params);
+}
+
+} // namespace ns3
+
+#endif /* GRID_SPECTRUM_CHANNEL_H */
@@ -3,7 +3,6 @@
 #include "ns3/command-line.h"
 #include "ns3/csma-helper.h"
 #include "ns3/internet-stack-helper.h"
-#include "ns3/ipv4-address-helper.h"
 #include "ns3/mobility-helper.h"
 #include "ns3/olsr-helper.h"
 #include "ns3/on-off-helper.h"
@@ -20,6 +19,19 @@
 #include "ns3/internet-module.h"
 #include "ns3/mobility-module.h"
 
+#include "address-plan.h"
+#include "anim-flow-aggregator.h"
+#include "async-trace-writer.h"
+#include "binary-trace-writer.h"
+#include "hanet-topology-builder.h"
+#include "mmap-trajectory-mobility-model.h"
+#include "replication-controller.h"
+#include "scheduler-selection.h"
+#include "traffic-matrix.h"
+
+#include <memory>
+#include <string>
+
 using namespace ns3;
 
 //
@@ -54,215 +66,284 @@ main(int argc, char* argv[])
     uint32_t manetNodes = 10;
     //DECLARE m_protocolName
     std::string m_protocolName = "DSR";
-    //uint32_t routingProtocol;
-    //
-    // Simulation defaults are typically set next, before command line
-    // arguments are parsed.
-    //
-    
-    Config::SetDefault("ns3::OnOffApplication::PacketSize", StringValue("1472"));
-    Config::SetDefault("ns3::OnOffApplication::DataRate", StringValue("100kb/s"));
-    //
-    // Create a container to manage the nodes of the adhoc (manet) network.
-    // Later we'll create the rest of the nodes we'll need.
-    //
-    NodeContainer adhocContainer;
-    adhocContainer.Create(manetNodes);
-    //
-    // Create the manet wifi net devices and install them into the nodes in
-    // our container
-    //
-    WifiHelper wifi;
-    WifiMacHelper mac;
-    mac.SetType("ns3::AdhocWifiMac");
-    wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
-                                 "DataMode",
-                                 StringValue("OfdmRate54Mbps"));
-    YansWifiPhyHelper wifiPhy;
-    wifiPhy.SetPcapDataLinkType(WifiPhyHelper::DLT_IEEE802_11_RADIO);
-    YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default();
-    wifiPhy.SetChannel(wifiChannel.Create());
-    NetDeviceContainer manetDevices = wifi.Install(wifiPhy, mac, adhocContainer);
-
-    //setting mobility model
-        MobilityHelper mobilityAdhoc;
-    int64_t streamIndex = 0; // used to get consistent mobility across scenarios
+    std::string traceFormat = "binary";
+    bool traceDigest = false;
+    std::string animMode = "full";
+    double animInterval = 1.0;
+    std::string trajectoryFile;
+    std::string schedulerName = "Map";
+    bool schedulerStats = false;
+    std::string trafficMatrix = "uniform";
+    uint32_t flows = 1;
+    std::string flowRate = "100kb/s";
+    bool ipv6 = false;
+    double ciTarget = 0;
+    double ciConfidence = 0.95;
+    uint32_t minRuns = 5;
+    uint32_t maxRuns = 30;
+    uint32_t jobs = 0;
 
-    ObjectFactory pos;
-    pos.SetTypeId("ns3::RandomRectanglePositionAllocator");
-    pos.Set("X", StringValue("ns3::UniformRandomVariable[Min=0.0|Max=300.0]"));
-    pos.Set("Y", StringValue("ns3::UniformRandomVariable[Min=0.0|Max=1500.0]"));
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("traceFormat", "packet trace format: binary, ascii or none", traceFormat);
+    cmd.AddValue("traceDigest",
+                 "store a digest of the packet headers in binary traces",
+                 traceDigest);
+    cmd.AddValue("animMode", "NetAnim output: full, decimated or off", animMode);
+    cmd.AddValue("animInterval",
+                 "position and flow sampling interval of the decimated animation (seconds)",
+                 animInterval);
+    cmd.AddValue("trajectoryFile",
+                 "replay the trajectories of this trajectory-gen file instead of RandomWaypoint",
+                 trajectoryFile);
+    cmd.AddValue("scheduler", "event scheduler: " + SchedulerSelection::GetNames(), schedulerName);
+    cmd.AddValue("schedulerStats", "track and report the peak event queue size", schedulerStats);
+    cmd.AddValue("trafficMatrix",
+                 "flows between the STAs: uniform, hotspot or gravity",
+                 trafficMatrix);
+    cmd.AddValue("flows", "number of flows of the traffic matrix", flows);
+    cmd.AddValue("flowRate", "data rate of each flow", flowRate);
+    cmd.AddValue("ipv6", "also give every link an IPv6 /64", ipv6);
+    cmd.AddValue("ciTarget",
+                 "replicate until the KPI confidence half-widths are below this fraction "
+                 "of their means, 0 for a single run",
+                 ciTarget);
+    cmd.AddValue("ciConfidence", "confidence level of the KPI intervals", ciConfidence);
+    cmd.AddValue("minRuns", "minimum replications with ciTarget", minRuns);
+    cmd.AddValue("maxRuns", "maximum replications with ciTarget", maxRuns);
+    cmd.AddValue("jobs", "concurrent replications, 0 for one per core", jobs);
+    cmd.Parse(argc, argv);
 
-    Ptr<PositionAllocator> taPositionAlloc = pos.Create()->GetObject<PositionAllocator>();
-    streamIndex += taPositionAlloc->AssignStreams(streamIndex);
-
-    std::stringstream ssSpeed;
-    ssSpeed << "ns3::UniformRandomVariable[Min=0.0|Max=" << nodeSpeed << "]";
-    std::stringstream ssPause;
-    ssPause << "ns3::ConstantRandomVariable[Constant=" << nodePause << "]";
-    mobilityAdhoc.SetMobilityModel("ns3::RandomWaypointMobilityModel",
-                                   "Speed",
-                                   StringValue(ssSpeed.str()),
-                                   "Pause",
-                                   StringValue(ssPause.str()),
-                                   "PositionAllocator",
-                                   PointerValue(taPositionAlloc));
-    mobilityAdhoc.SetPositionAllocator(taPositionAlloc);
-    mobilityAdhoc.Install(adhocContainer);
-    streamIndex += mobilityAdhoc.AssignStreams(adhocContainer, streamIndex);
-//routing protocols for networks, it depends on the distance between nodes.
-    if (m_protocolName == "OLSR")
+    if (traceFormat != "binary" && traceFormat != "ascii" && traceFormat != "none")
     {
-        list.Add(olsr, 100);
-        internet.SetRoutingHelper(list);
-        internet.Install(adhocContainer);
+        NS_FATAL_ERROR("Unknown trace format " << traceFormat);
     }
-    else if (m_protocolName == "AODV")
+    if (!AnimOutput::IsValidMode(animMode))
     {
-        list.Add(aodv, 100);
-        internet.SetRoutingHelper(list);
-        internet.Install(adhocContainer);
+        NS_FATAL_ERROR("Unknown animation mode " << animMode);
     }
-    else if (m_protocolName == "DSDV")
+    if (!TrafficMatrix::IsValidPattern(trafficMatrix))
     {
-        list.Add(dsdv, 100);
-        internet.SetRoutingHelper(list);
-        internet.Install(adhocContainer);
+        NS_FATAL_ERROR("Unknown traffic matrix " << trafficMatrix);
     }
-    else if (m_protocolName == "DSR")
+    if (ciConfidence <= 0 || ciConfidence >= 1)
     {
-        internet.Install(adhocContainer);
-        dsrMain.Install(dsr, adhocContainer);
+        NS_FATAL_ERROR("ciConfidence must be in (0, 1)");
     }
-        else
-    {
-        NS_FATAL_ERROR("No such protocol:" << m_protocolName);
-    }
-    Ipv4AddressHelper ipAddrs;
-    ipAddrs.SetBase("192.168.0.0", "255.255.255.0");
-    ipAddrs.Assign(manetDevices);
-    ipAddrs.SetBase("172.16.0.0", "255.255.255.0");
-    for (uint32_t i = 0; i < manetNodes; ++i)
-    {
-        NS_LOG_INFO("Configuring wireless network for manet node " << i);
+    SchedulerSelection scheduler(schedulerName, schedulerStats);
+    //uint32_t routingProtocol;
+    //
+    // Simulation defaults are typically set next, before command line
+    // arguments are parsed.
+    //
+    
+    Config::SetDefault("ns3::OnOffApplication::PacketSize", StringValue("1472"));
+    Config::SetDefault("ns3::OnOffApplication::DataRate", StringValue("100kb/s"));
+
+    // one run of the scenario, whose output files start with outName
+    auto runScenario = [&](const std::string& outName) {
         //
-        // Create a container to manage the nodes of the LAN.  We need
-        // two containers here; one with all of the new nodes, and one
-        // with all of the nodes including new and existing nodes
+        // Create a container to manage the nodes of the adhoc (manet) network.
+        // Later we'll create the rest of the nodes we'll need.
         //
-        NodeContainer stas;
-        stas.Create(movilNodes - 1);
-        // Now, create the container with all nodes on this link
-        NodeContainer movil(adhocContainer.Get(i), stas);
+        NodeContainer adhocContainer;
+        adhocContainer.Create(manetNodes);
         //
-        // Create an infrastructure network
+        // Create the manet wifi net devices and install them into the nodes in
+        // our container
         //
-        WifiHelper wifimovil;
-        WifiMacHelper macmovil;
+        WifiHelper wifi;
+        WifiMacHelper mac;
+        mac.SetType("ns3::AdhocWifiMac");
+        wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
+                                     "DataMode",
+                                     StringValue("OfdmRate54Mbps"));
+        YansWifiPhyHelper wifiPhy;
+        wifiPhy.SetPcapDataLinkType(WifiPhyHelper::DLT_IEEE802_11_RADIO);
+        YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default();
         wifiPhy.SetChannel(wifiChannel.Create());
-        // Create unique ssids for these networks
-        std::string ssidString("wifi-movil");
-        std::stringstream ss;
-        ss << i;
-        ssidString += ss.str();
-        Ssid ssid = Ssid(ssidString);
-        // setup stas
-        macmovil.SetType("ns3::StaWifiMac", "Ssid", SsidValue(ssid));
-        NetDeviceContainer staDevices = wifimovil.Install(wifiPhy, macmovil, stas);
-        // setup ap.
-        macmovil.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid));
-        NetDeviceContainer apDevices = wifimovil.Install(wifiPhy, macmovil, adhocContainer.Get(i));
-        // Collect all of these new devices
-        NetDeviceContainer movilDevices(apDevices, staDevices);
+        NetDeviceContainer manetDevices = wifi.Install(wifiPhy, mac, adhocContainer);
 
-        // Add the IPv4 protocol stack to the nodes in our container
-        //
-        internet.Install(stas);
-        //
-        // Assign IPv4 addresses to the device drivers (actually to the associated
-        // IPv4 interfaces) we just created.
-        //
-        ipAddrs.Assign(movilDevices);
-        //
-        // Assign a new network prefix for each movil network, according to
-        // the network mask initialized above
-        //
-        ipAddrs.NewNetwork();
-        //
-        // The new wireless nodes need a mobility model so we aggregate one
-        // to each of the nodes we just finished building.
-        //
-        Ptr<ListPositionAllocator> subnetAlloc = CreateObject<ListPositionAllocator>();
-        for (uint32_t j = 0; j < movil.GetN(); ++j)
+        //setting mobility model
+            MobilityHelper mobilityAdhoc;
+        if (!trajectoryFile.empty())
         {
-            subnetAlloc->Add(Vector(0.0, j, 0.0));
+            // precomputed motion, the same for every protocol
+            mobilityAdhoc.SetMobilityModel("ns3::MmapTrajectoryMobilityModel",
+                                           "TrajectoryFile",
+                                           StringValue(trajectoryFile));
+            mobilityAdhoc.Install(adhocContainer);
         }
-        
-        mobilityAdhoc.PushReferenceMobilityModel(adhocContainer.Get(i));
-        mobilityAdhoc.SetPositionAllocator(subnetAlloc);
-        mobilityAdhoc.SetMobilityModel("ns3::RandomDirection2dMobilityModel",
-                                  "Bounds",
-                                  RectangleValue(Rectangle(-10, 10, -10, 10)),
-                                  "Speed",
-                                  StringValue("ns3::ConstantRandomVariable[Constant=3]"),
-                                  "Pause",
-                                  StringValue("ns3::ConstantRandomVariable[Constant=0.4]"));
-        mobilityAdhoc.Install(stas);
-    }
-    NS_LOG_INFO("Create Applications.");
-    
-    //create application to send data from the first movilNOde to the last movilNode
-    //create source and sink
-    
-    // we want the first node created in the topology to be the source.
-    
-    /*
-    Ptr<Node> appSource = NodeList::GetNode(10);
-    // We want the sink to be the last node created in the topology.
-    uint32_t lastNodeIndex = manetNodes + manetNodes * (movilNodes - 1) - 1;
-    NS_LOG_UNCOND(lastNodeIndex);
-    Ptr<Node> appSink = NodeList::GetNode(11);
-    uint16_t port = 9;
-    Ipv4Address remoteAddr = appSink->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
-    OnOffHelper onoff("ns3::UdpSocketFactory", Address(InetSocketAddress(remoteAddr, port)));
+        else
+        {
+            int64_t streamIndex = 0; // used to get consistent mobility across scenarios
 
-    ApplicationContainer apps = onoff.Install(appSource);
-    apps.Start(Seconds(3));
-    apps.Stop(Seconds(stopTime - 1));
+            ObjectFactory pos;
+            pos.SetTypeId("ns3::RandomRectanglePositionAllocator");
+            pos.Set("X", StringValue("ns3::UniformRandomVariable[Min=0.0|Max=300.0]"));
+            pos.Set("Y", StringValue("ns3::UniformRandomVariable[Min=0.0|Max=1500.0]"));
 
-   // Create a packet sink to receive these packets
-    PacketSinkHelper sink("ns3::UdpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port));
-    apps = sink.Install(appSink);
-    apps.Start(Seconds(3));
-    */
+            Ptr<PositionAllocator> taPositionAlloc = pos.Create()->GetObject<PositionAllocator>();
+            streamIndex += taPositionAlloc->AssignStreams(streamIndex);
+
+            std::stringstream ssSpeed;
+            ssSpeed << "ns3::UniformRandomVariable[Min=0.0|Max=" << nodeSpeed << "]";
+            std::stringstream ssPause;
+            ssPause << "ns3::ConstantRandomVariable[Constant=" << nodePause << "]";
+            mobilityAdhoc.SetMobilityModel("ns3::RandomWaypointMobilityModel",
+                                           "Speed",
+                                           StringValue(ssSpeed.str()),
+                                           "Pause",
+                                           StringValue(ssPause.str()),
+                                           "PositionAllocator",
+                                           PointerValue(taPositionAlloc));
+            mobilityAdhoc.SetPositionAllocator(taPositionAlloc);
+            mobilityAdhoc.Install(adhocContainer);
+            streamIndex += mobilityAdhoc.AssignStreams(adhocContainer, streamIndex);
+        }
+    //routing protocols for networks, it depends on the distance between nodes.
+        if (m_protocolName == "OLSR")
+        {
+            list.Add(olsr, 100);
+            internet.SetRoutingHelper(list);
+            internet.Install(adhocContainer);
+        }
+        else if (m_protocolName == "AODV")
+        {
+            list.Add(aodv, 100);
+            internet.SetRoutingHelper(list);
+            internet.Install(adhocContainer);
+        }
+        else if (m_protocolName == "DSDV")
+        {
+            list.Add(dsdv, 100);
+            internet.SetRoutingHelper(list);
+            internet.Install(adhocContainer);
+        }
+        else if (m_protocolName == "DSR")
+        {
+            internet.Install(adhocContainer);
+            dsrMain.Install(dsr, adhocContainer);
+        }
+            else
+        {
+            NS_FATAL_ERROR("No such protocol:" << m_protocolName);
+        }
+        // One prefix per link, sized to the link, see AddressPlan
+        AddressPlan manetAddrs(Ipv4Address("192.168.0.0"), 16);
+        AddressPlan subnetAddrs(Ipv4Address("172.16.0.0"), 12);
+        if (ipv6)
+        {
+            manetAddrs.EnableIpv6(Ipv6Address("2001:db8::"));
+            subnetAddrs.EnableIpv6(Ipv6Address("2001:db8:1::"));
+        }
+        manetAddrs.Assign(manetDevices);
+        TrafficMatrix matrix(trafficMatrix, flows);
+        // The AP subnets of the manet nodes, with movilNodes - 1 STAs each
+        // moving around their AP, built all at once
+        NS_LOG_INFO("Configuring the wireless networks of the manet nodes");
+        HanetTopologyBuilder topology;
+        topology.SetSubnetNodes(movilNodes);
+        topology.SetSsidPrefix("wifi-movil");
+        topology.SetWifi(wifiPhy, wifiChannel);
+        topology.Build(adhocContainer, internet, subnetAddrs);
+        for (uint32_t i = 0; i < manetNodes; ++i)
+        {
+            matrix.AddSubnet(topology.GetStas(i));
+        }
+        topology.PrintReport(std::cout);
+        subnetAddrs.PrintReport(std::cout);
+        NS_LOG_INFO("Create Applications.");
+    
+        // flows between STAs of different subnets, one flow by default; the
+        // traffic matrix installs one sender and one sink application per node
+        matrix.Install(9, DataRate(flowRate), 1472, Seconds(3), Seconds(stopTime - 1));
+        KpiProbe kpis;
+        kpis.AddSources(matrix.GetSources());
+        ApplicationContainer sinks = matrix.GetSinks();
+        for (auto it = sinks.Begin(); it != sinks.End(); ++it)
+        {
+            (*it)->TraceConnectWithoutContext("Rx", MakeCallback(&KpiProbe::ReceiveFrom, &kpis));
+        }
+        // the node of the first sink, for the pcap trace
+        Ptr<Node> appSink = matrix.GetSinks().Get(0)->GetNode();
 
-   NS_LOG_INFO("Configure Tracing.");
-    CsmaHelper csma;
+       NS_LOG_INFO("Configure Tracing.");
+        CsmaHelper csma;
 
-    //
-    // Let's set up some ns-2-like ascii traces, using another helper class
-    //
-    AsciiTraceHelper ascii;
-    Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream("hanet-tracing.tr");
-    wifiPhy.EnableAsciiAll(stream);
-    csma.EnableAsciiAll(stream);
-    internet.EnableAsciiIpv4All(stream);
+        //
+        // Packet traces: compact binary records by default (decode them with
+        // binary-trace-decode), or the ns-2-like ascii traces
+        //
+        std::unique_ptr<BinaryTraceWriter> binaryTrace;
+        std::unique_ptr<AsyncOstream> asciiTrace;
+        if (traceFormat == "binary")
+        {
+            binaryTrace =
+                std::make_unique<BinaryTraceWriter>(outName + "-tracing.btr", traceDigest);
+            binaryTrace->EnableWifi(NodeContainer::GetGlobal());
+            binaryTrace->EnableCsma(NodeContainer::GetGlobal());
+            binaryTrace->EnableIpv4(NodeContainer::GetGlobal());
+        }
+        else if (traceFormat == "ascii")
+        {
+            asciiTrace = std::make_unique<AsyncOstream>(outName + "-tracing.tr");
+            Ptr<OutputStreamWrapper> stream = Create<OutputStreamWrapper>(asciiTrace.get());
+            wifiPhy.EnableAsciiAll(stream);
+            csma.EnableAsciiAll(stream);
+            internet.EnableAsciiIpv4All(stream);
+        }
 
-    // Csma captures in non-promiscuous mode
-    csma.EnablePcapAll("hanet", false);
-    // pcap captures on the backbone wifi devices
-    wifiPhy.EnablePcap("hanet", manetDevices, false);
-    // pcap trace on the application data sink
-    wifiPhy.EnablePcap("hanet", appSink->GetId(), 0);
+        // Csma captures in non-promiscuous mode
+        csma.EnablePcapAll(outName, false);
+        // pcap captures on the backbone wifi devices
+        wifiPhy.EnablePcap(outName, manetDevices, false);
+        // pcap trace on the application data sink
+        wifiPhy.EnablePcap(outName, appSink->GetId(), 0);
 
-    AnimationInterface anim("hanet.xml");
-    NS_LOG_INFO("Run Simulation.");
+        AnimOutput anim(outName + ".xml", animMode, Seconds(animInterval));
+        NS_LOG_INFO("Run Simulation.");
 
-    Simulator::Stop(Seconds(stopTime));
-    Simulator::Run();
-    Simulator::Destroy();
+        Simulator::Stop(Seconds(stopTime));
+        scheduler.Start();
+        Simulator::Run();
+        scheduler.Stop();
+        scheduler.PrintReport(std::clog);
+        anim.Close();
+        matrix.PrintReport(std::cout);
+        if (binaryTrace)
+        {
+            binaryTrace->Close();
+            NS_LOG_UNCOND("Binary trace records: " << binaryTrace->GetRecordCount());
+            binaryTrace->GetOutput().PrintStats(std::clog, outName + "-tracing.btr");
+        }
+        if (asciiTrace)
+        {
+            asciiTrace->Close();
+            asciiTrace->GetWriter().PrintStats(std::clog, outName + "-tracing.tr");
+        }
+        Simulator::Destroy();
 
-    return 0;
+        // the traffic runs from 3 s to stopTime - 1
+        return kpis.GetKpis(Seconds(stopTime - 4));
+    };
 
+    if (ciTarget > 0)
+    {
+        ReplicationController replications(KpiProbe::GetKpiNames(),
+                                           ciTarget,
+                                           ciConfidence,
+                                           minRuns,
+                                           maxRuns,
+                                           jobs);
+        ReplicationController::Summary summary =
+            replications.Run(RngSeedManager::GetRun(), [&](uint32_t run) {
+                RngSeedManager::SetRun(run);
+                return runScenario("hanet-run" + std::to_string(run));
+            });
+        replications.PrintSummary(std::cout, m_protocolName, summary);
+        return summary.failedRuns.empty() ? 0 : 1;
+    }
+    runScenario("hanet");
 
-}
\ No newline at end of file
+    return 0;
+}
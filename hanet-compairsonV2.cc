@@ -2,15 +2,14 @@
 #include "ns3/command-line.h"
 #include "ns3/csma-helper.h"
 #include "ns3/internet-stack-helper.h"
-#include "ns3/ipv4-address-helper.h"
 #include "ns3/mobility-helper.h"
 #include "ns3/olsr-helper.h"
-#include "ns3/on-off-helper.h"
-#include "ns3/packet-sink-helper.h"
+#include "ns3/udp-client-server-helper.h"
 #include "ns3/qos-txop.h"
 #include "ns3/ssid.h"
 #include "ns3/string.h"
 #include "ns3/yans-wifi-channel.h"
+#include "ns3/spectrum-wifi-helper.h"
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/core-module.h"
 #include "ns3/dsdv-module.h"
@@ -19,6 +18,24 @@
 #include "ns3/internet-module.h"
 #include "ns3/mobility-module.h"
 
+#include "address-plan.h"
+#include "anim-flow-aggregator.h"
+#include "async-trace-writer.h"
+#include "binary-trace-writer.h"
+#include "grid-spectrum-channel.h"
+#include "hanet-topology-builder.h"
+#include "latency-probe.h"
+#include "partition-profiler.h"
+#include "replication-controller.h"
+#include "scaling-study.h"
+#include "scheduler-selection.h"
+#include "traffic-matrix.h"
+
+#include <cmath>
+#include <memory>
+#include <sstream>
+#include <vector>
+
 using namespace ns3;
 
 //
@@ -30,15 +47,16 @@ NS_LOG_COMPONENT_DEFINE("hanet-compairsonV2");
  * This function will be used below as a trace sink, if the command-line
  * argument or default value "useCourseChangeCallback" is set to true
  *
+ * \param os The output stream.
  * \param path The callback path.
  * \param model The mobility model.
  */
 static void
-CourseChangeCallback(std::string path, Ptr<const MobilityModel> model)
+CourseChangeCallback(std::ostream* os, std::string path, Ptr<const MobilityModel> model)
 {
     Vector position = model->GetPosition();
-    std::cout << "CourseChange " << path << " x=" << position.x << ", y=" << position.y
-              << ", z=" << position.z << std::endl;
+    *os << "CourseChange " << path << " x=" << position.x << ", y=" << position.y
+        << ", z=" << position.z << "\n";
 }
 
 int
@@ -53,13 +71,30 @@ main(int argc, char* argv[])
     std::string m_protocolName = "OLSR";
     uint32_t stopTime = 20;
     bool useCourseChangeCallback = false;
-
-    //
-    // Simulation defaults are typically set next, before command line
-    // arguments are parsed.
-    //
-    Config::SetDefault("ns3::OnOffApplication::PacketSize", StringValue("1472"));
-    Config::SetDefault("ns3::OnOffApplication::DataRate", StringValue("100kb/s"));
+    std::string traceFormat = "binary";
+    bool traceDigest = false;
+    std::string animMode = "full";
+    double animInterval = 1.0;
+    bool gridChannel = false;
+    double gridRange = 0;
+    uint32_t partitions = 0;
+    Time partitionLookahead = MicroSeconds(1);
+    std::string schedulerName = "Map";
+    bool schedulerStats = false;
+    double ciTarget = 0;
+    double ciConfidence = 0.95;
+    uint32_t minRuns = 5;
+    uint32_t maxRuns = 30;
+    uint32_t jobs = 0;
+    std::string dataRate = "100kb/s";
+    uint32_t packetSize = 1472;
+    std::string trafficMatrix;
+    uint32_t flows = 100;
+    std::string flowRate = "8kb/s";
+    uint32_t hotspots = 1;
+    double hotspotShare = 0.5;
+    std::string scalingStudy;
+    bool ipv6 = false;
 
     //
     // For convenience, we add the local variables to the command line argument
@@ -74,6 +109,50 @@ main(int argc, char* argv[])
     cmd.AddValue("useCourseChangeCallback",
                  "whether to enable course change tracing",
                  useCourseChangeCallback);
+    cmd.AddValue("traceFormat", "packet trace format: binary, ascii or none", traceFormat);
+    cmd.AddValue("traceDigest",
+                 "store a digest of the packet headers in binary traces",
+                 traceDigest);
+    cmd.AddValue("animMode", "NetAnim output: full, decimated or off", animMode);
+    cmd.AddValue("animInterval",
+                 "position and flow sampling interval of the decimated animation (seconds)",
+                 animInterval);
+    cmd.AddValue("gridChannel",
+                 "use a spectrum channel with spatial grid culling for the manet",
+                 gridChannel);
+    cmd.AddValue("gridRange",
+                 "delivery range of the grid channel (m), 0 for the default link budget",
+                 gridRange);
+    cmd.AddValue("partitions",
+                 "count the events of this many AP subnet partitions, 0 to disable",
+                 partitions);
+    cmd.AddValue("partitionLookahead",
+                 "synchronization window of the partition estimate",
+                 partitionLookahead);
+    cmd.AddValue("scheduler", "event scheduler: " + SchedulerSelection::GetNames(), schedulerName);
+    cmd.AddValue("schedulerStats", "track and report the peak event queue size", schedulerStats);
+    cmd.AddValue("ciTarget",
+                 "replicate until the KPI confidence half-widths are below this fraction "
+                 "of their means, 0 for a single run",
+                 ciTarget);
+    cmd.AddValue("ciConfidence", "confidence level of the KPI intervals", ciConfidence);
+    cmd.AddValue("minRuns", "minimum replications with ciTarget", minRuns);
+    cmd.AddValue("maxRuns", "maximum replications with ciTarget", maxRuns);
+    cmd.AddValue("jobs", "concurrent replications, 0 for one per core", jobs);
+    cmd.AddValue("dataRate", "data rate of the measured flow", dataRate);
+    cmd.AddValue("packetSize", "UDP payload of the measured flow (bytes)", packetSize);
+    cmd.AddValue("trafficMatrix",
+                 "replace the measured flow by many flows between the STAs: uniform, hotspot "
+                 "or gravity",
+                 trafficMatrix);
+    cmd.AddValue("flows", "number of flows of the traffic matrix", flows);
+    cmd.AddValue("flowRate", "data rate of each flow of the traffic matrix", flowRate);
+    cmd.AddValue("hotspots", "number of hotspot STAs of the hotspot matrix", hotspots);
+    cmd.AddValue("hotspotShare", "share of the flows to the hotspots", hotspotShare);
+    cmd.AddValue("scalingStudy",
+                 "comma separated manetNodes values to run and fit, e.g. 10,50,200,1000",
+                 scalingStudy);
+    cmd.AddValue("ipv6", "also give every link an IPv6 /64", ipv6);
 
     //
     // The system global variables and the local values added to the argument
@@ -86,236 +165,434 @@ main(int argc, char* argv[])
         std::cout << "Use a simulation stop time >= 10 seconds" << std::endl;
         exit(1);
     }
-    ///////////////////////////////////////////////////////////////////////////
-    //                                                                       //
-    // Construct the manet                                                //
-    //                                                                       //
-    ///////////////////////////////////////////////////////////////////////////
-
-    //
-    // Create a container to manage the nodes of the adhoc (manet) network.
-    // Later we'll create the rest of the nodes we'll need.
-    //
-    NodeContainer manet;
-    manet.Create(manetNodes);
-    //
-    // Create the manet wifi net devices and install them into the nodes in
-    // our container
-    //
-    WifiHelper wifi;
-    WifiMacHelper mac;
-    mac.SetType("ns3::AdhocWifiMac");
-    wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
-                                 "DataMode",
-                                 StringValue("OfdmRate54Mbps"));
-    YansWifiPhyHelper wifiPhy;
-    wifiPhy.SetPcapDataLinkType(WifiPhyHelper::DLT_IEEE802_11_RADIO);
-    YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default();
-    wifiPhy.SetChannel(wifiChannel.Create());
-    NetDeviceContainer manetDevices = wifi.Install(wifiPhy, mac, manet);
-
-    // We enable OLSR (which will be consulted at a higher priority than
-    // the global routing) on the manet ad hoc nodes
-    NS_LOG_INFO("Enabling routing protocols on all manet nodes");
-    OlsrHelper olsr;
-    AodvHelper aodv;
-    DsdvHelper dsdv;
-    Ipv4ListRoutingHelper list;
-
-    //
-    //
-    // Add the IPv4 protocol stack to the nodes in our container
-    //
-    InternetStackHelper internet;
-    NS_LOG_UNCOND(m_protocolName);
-    // change here the parameter to use the routing protocol
-    if (m_protocolName == "OLSR"){
-        internet.SetRoutingHelper(olsr);
-    } else if (m_protocolName == "AODV"){
-        internet.SetRoutingHelper(aodv);
-    } else if (m_protocolName == "DSDV"){
-        internet.SetRoutingHelper(dsdv);
-    } else {
-        NS_FATAL_ERROR("No routing protocol selected or no such protocol existant");
+    if (traceFormat != "binary" && traceFormat != "ascii" && traceFormat != "none")
+    {
+        NS_FATAL_ERROR("Unknown trace format " << traceFormat);
     }
-     // has effect on the next Install ()
-    internet.Install(manet);
-
-    //
-    // Assign IPv4 addresses to the device drivers (actually to the associated
-    // IPv4 interfaces) we just created.
-    //
-    Ipv4AddressHelper ipAddrs;
-    ipAddrs.SetBase("192.168.0.0", "255.255.255.0");
-    ipAddrs.Assign(manetDevices);
-
-    //
-    // The ad-hoc network nodes need a mobility model so we aggregate one to
-    // each of the nodes we just finished building.
-    //
-    MobilityHelper mobility;
-    mobility.SetPositionAllocator("ns3::GridPositionAllocator",
-                                  "MinX",
-                                  DoubleValue(20.0),
-                                  "MinY",
-                                  DoubleValue(20.0),
-                                  "DeltaX",
-                                  DoubleValue(20.0),
-                                  "DeltaY",
-                                  DoubleValue(20.0),
-                                  "GridWidth",
-                                  UintegerValue(5),
-                                  "LayoutType",
-                                  StringValue("RowFirst"));
-    mobility.SetMobilityModel("ns3::RandomDirection2dMobilityModel",
-                              "Bounds",
-                              RectangleValue(Rectangle(-500, 500, -500, 500)),
-                              "Speed",
-                              StringValue("ns3::ConstantRandomVariable[Constant=2]"),
-                              "Pause",
-                              StringValue("ns3::ConstantRandomVariable[Constant=0.2]"));
-    mobility.Install(manet);
-
-
-    ipAddrs.SetBase("10.0.0.0", "255.255.255.0");
-
-    for (uint32_t i = 0; i < manetNodes; ++i)
+    if (!AnimOutput::IsValidMode(animMode))
+    {
+        NS_FATAL_ERROR("Unknown animation mode " << animMode);
+    }
+    if (!trafficMatrix.empty() && !TrafficMatrix::IsValidPattern(trafficMatrix))
+    {
+        NS_FATAL_ERROR("Unknown traffic matrix " << trafficMatrix);
+    }
+    if (ciConfidence <= 0 || ciConfidence >= 1)
+    {
+        NS_FATAL_ERROR("ciConfidence must be in (0, 1)");
+    }
+    if (partitions > manetNodes)
     {
-        NS_LOG_INFO("Configuring wireless network for manet node " << i);
-
-        NodeContainer stas;
-        stas.Create(mobileNodes - 1);
-        // Now, create the container with all nodes on this link
-        NodeContainer mobile(manet.Get(i), stas);
-
-        WifiHelper wifimobile;
-        WifiMacHelper macmobile;
-        wifiPhy.SetChannel(wifiChannel.Create());
-        // Create unique ssids for these networks
-        std::string ssidString("wifi-mobile");
-        std::stringstream ss;
-        ss << i;
-        ssidString += ss.str();
-        Ssid ssid = Ssid(ssidString);
-        // setup stas
-        macmobile.SetType("ns3::StaWifiMac", "Ssid", SsidValue(ssid));
-        NetDeviceContainer staDevices = wifimobile.Install(wifiPhy, macmobile, stas);
-        // setup ap.
-        macmobile.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid));
-        NetDeviceContainer apDevices = wifimobile.Install(wifiPhy, macmobile, manet.Get(i));
-        // Collect all of these new devices
-        NetDeviceContainer mobileDevices(apDevices, staDevices);
+        NS_FATAL_ERROR("Cannot split " << manetNodes << " subnets into " << partitions
+                                       << " partitions");
+    }
+    std::vector<uint32_t> scalingSizes;
+    if (!scalingStudy.empty())
+    {
+        if (partitions > 0 || ciTarget > 0)
+        {
+            NS_FATAL_ERROR("scalingStudy cannot be combined with partitions or ciTarget");
+        }
+        std::istringstream sizes(scalingStudy);
+        std::string size;
+        while (std::getline(sizes, size, ','))
+        {
+            scalingSizes.push_back(std::stoul(size));
+            if (scalingSizes.back() == 0)
+            {
+                NS_FATAL_ERROR("Invalid scaling study size " << size);
+            }
+            // fail now rather than after the smaller sizes have run: the
+            // backbone is one link of 192.168.0.0/16 and the AP subnets
+            // are links of mobileNodes devices in 10.0.0.0/8
+            if (AddressPlan::GetMaxLinks(16, scalingSizes.back()) == 0 ||
+                AddressPlan::GetMaxLinks(8, mobileNodes) < scalingSizes.back())
+            {
+                NS_FATAL_ERROR("Scaling study size " << size << " does not fit the address plan");
+            }
+        }
+        GlobalValue::Bind("SimulatorImplementationType",
+                          StringValue("ns3::ModuleProfilingSimulatorImpl"));
+    }
+    std::unique_ptr<PartitionPlan> partitionPlan;
+    if (partitions > 0)
+    {
+        GlobalValue::Bind("SimulatorImplementationType",
+                          StringValue("ns3::PartitionProfilingSimulatorImpl"));
+        partitionPlan = std::make_unique<PartitionPlan>(partitions, manetNodes);
+    }
+    SchedulerSelection scheduler(schedulerName, schedulerStats);
+    PhaseTimer phases;
+    ScalingStudy::Sample scalingSample;
+
+    // one run of the scenario, whose output files start with outName
+    auto runScenario = [&](const std::string& outName) {
+        phases.Start();
+        ///////////////////////////////////////////////////////////////////////////
+        //                                                                       //
+        // Construct the manet                                                //
+        //                                                                       //
+        ///////////////////////////////////////////////////////////////////////////
 
-        // Add the IPv4 protocol stack to the nodes in our container
         //
-        internet.Install(stas);
+        // Create a container to manage the nodes of the adhoc (manet) network.
+        // Later we'll create the rest of the nodes we'll need.
         //
-        // Assign IPv4 addresses to the device drivers (actually to the associated
-        // IPv4 interfaces) we just created.
+        NodeContainer manet;
+        manet.Create(manetNodes);
         //
-        ipAddrs.Assign(mobileDevices);
+        // Create the manet wifi net devices and install them into the nodes in
+        // our container
+        //
+        WifiHelper wifi;
+        WifiMacHelper mac;
+        mac.SetType("ns3::AdhocWifiMac");
+        wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
+                                     "DataMode",
+                                     StringValue("OfdmRate54Mbps"));
+        YansWifiPhyHelper wifiPhy;
+        wifiPhy.SetPcapDataLinkType(WifiPhyHelper::DLT_IEEE802_11_RADIO);
+        YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default();
+        SpectrumWifiPhyHelper gridPhy;
+        Ptr<GridSpectrumChannel> manetChannel;
+        NetDeviceContainer manetDevices;
+        if (gridChannel)
+        {
+            // Same propagation as YansWifiChannelHelper::Default(), but a frame
+            // only reaches the PHYs within gridRange of its sender.  By default
+            // that is where the default 16.0206 dBm Tx power falls 10 dB below
+            // the -101 dBm RX sensitivity with the default log distance loss.
+            if (gridRange <= 0)
+            {
+                gridRange = std::pow(10.0, (16.0206 + 101.0 + 10.0 - 46.6777) / 30.0);
+            }
+            manetChannel = CreateObject<GridSpectrumChannel>();
+            manetChannel->SetAttribute("MaxRange", DoubleValue(gridRange));
+            manetChannel->AddPropagationLossModel(CreateObject<LogDistancePropagationLossModel>());
+            manetChannel->SetPropagationDelayModel(
+                CreateObject<ConstantSpeedPropagationDelayModel>());
+            gridPhy.SetPcapDataLinkType(WifiPhyHelper::DLT_IEEE802_11_RADIO);
+            gridPhy.SetChannel(manetChannel);
+            manetDevices = wifi.Install(gridPhy, mac, manet);
+        }
+        else
+        {
+            wifiPhy.SetChannel(wifiChannel.Create());
+            manetDevices = wifi.Install(wifiPhy, mac, manet);
+        }
+        WifiPhyHelper& manetPhy = gridChannel ? static_cast<WifiPhyHelper&>(gridPhy) : wifiPhy;
+
+        // We enable OLSR (which will be consulted at a higher priority than
+        // the global routing) on the manet ad hoc nodes
+        NS_LOG_INFO("Enabling routing protocols on all manet nodes");
+        OlsrHelper olsr;
+        AodvHelper aodv;
+        DsdvHelper dsdv;
+        Ipv4ListRoutingHelper list;
+
         //
-        // Assign a new network prefix for each mobile network, according to
-        // the network mask initialized above
         //
-        ipAddrs.NewNetwork();
+        // Add the IPv4 protocol stack to the nodes in our container
+        //
+        InternetStackHelper internet;
+        NS_LOG_UNCOND(m_protocolName);
+        // change here the parameter to use the routing protocol
+        if (m_protocolName == "OLSR"){
+            internet.SetRoutingHelper(olsr);
+        } else if (m_protocolName == "AODV"){
+            internet.SetRoutingHelper(aodv);
+        } else if (m_protocolName == "DSDV"){
+            internet.SetRoutingHelper(dsdv);
+        } else {
+            NS_FATAL_ERROR("No routing protocol selected or no such protocol existant");
+        }
+         // has effect on the next Install ()
+        internet.Install(manet);
+
         //
-        // The new wireless nodes need a mobility model so we aggregate one
-        // to each of the nodes we just finished building.
+        // Assign IPv4 addresses to the device drivers (actually to the associated
+        // IPv4 interfaces) we just created.
         //
-        Ptr<ListPositionAllocator> subnetAlloc = CreateObject<ListPositionAllocator>();
-        for (uint32_t j = 0; j < mobile.GetN(); ++j)
+        // One prefix per link, sized to the link, see AddressPlan
+        AddressPlan manetAddrs(Ipv4Address("192.168.0.0"), 16);
+        AddressPlan subnetAddrs(Ipv4Address("10.0.0.0"), 8);
+        if (ipv6)
         {
-            subnetAlloc->Add(Vector(0.0, j, 0.0));
+            manetAddrs.EnableIpv6(Ipv6Address("2001:db8::"));
+            subnetAddrs.EnableIpv6(Ipv6Address("2001:db8:1::"));
         }
-        mobility.PushReferenceMobilityModel(manet.Get(i));
-        mobility.SetPositionAllocator(subnetAlloc);
+        manetAddrs.Assign(manetDevices);
+
+        //
+        // The ad-hoc network nodes need a mobility model so we aggregate one to
+        // each of the nodes we just finished building.
+        //
+        MobilityHelper mobility;
+        mobility.SetPositionAllocator("ns3::GridPositionAllocator",
+                                      "MinX",
+                                      DoubleValue(20.0),
+                                      "MinY",
+                                      DoubleValue(20.0),
+                                      "DeltaX",
+                                      DoubleValue(20.0),
+                                      "DeltaY",
+                                      DoubleValue(20.0),
+                                      "GridWidth",
+                                      UintegerValue(5),
+                                      "LayoutType",
+                                      StringValue("RowFirst"));
         mobility.SetMobilityModel("ns3::RandomDirection2dMobilityModel",
                                   "Bounds",
-                                  RectangleValue(Rectangle(-10, 10, -10, 10)),
+                                  RectangleValue(Rectangle(-500, 500, -500, 500)),
                                   "Speed",
-                                  StringValue("ns3::ConstantRandomVariable[Constant=3]"),
+                                  StringValue("ns3::ConstantRandomVariable[Constant=2]"),
                                   "Pause",
-                                  StringValue("ns3::ConstantRandomVariable[Constant=0.4]"));
-        mobility.Install(stas);
-    }
+                                  StringValue("ns3::ConstantRandomVariable[Constant=0.2]"));
+        mobility.Install(manet);
+
+        TrafficMatrix matrix(trafficMatrix.empty() ? "uniform" : trafficMatrix, flows);
+        matrix.SetHotspots(hotspots, hotspotShare);
+        phases.Lap("build");
+        // The AP subnets of the manet nodes, with mobileNodes - 1 STAs each
+        // moving around their AP, built all at once
+        NS_LOG_INFO("Configuring the wireless networks of the manet nodes");
+        HanetTopologyBuilder topology;
+        topology.SetSubnetNodes(mobileNodes);
+        topology.SetSsidPrefix("wifi-mobile");
+        topology.SetWifi(wifiPhy, wifiChannel);
+        topology.Build(manet, internet, subnetAddrs);
+        for (uint32_t i = 0; i < manetNodes; ++i)
+        {
+            matrix.AddSubnet(topology.GetStas(i));
+            if (partitionPlan)
+            {
+                partitionPlan->AddSubnet(i, NodeContainer(manet.Get(i), topology.GetStas(i)));
+            }
+        }
+        phases.Lap("subnets");
+        topology.PrintReport(std::cout);
+        subnetAddrs.PrintReport(std::cout);
+
+        ///////////////////////////////////////////////////////////////////////////
+        //                                                                       //
+        // Application configuration                                             //
+        //                                                                       //
+        ///////////////////////////////////////////////////////////////////////////
+
+        // Create a UdpClient to send UDP datagrams of packetSize bytes at
+        // dataRate between two nodes; each starts with a sequence number and
+        // its send time, which the LatencySink turns into delay, jitter,
+        // reordering and loss as the packets arrive
+        // We'll send data from the first wired LAN node on the first wired LAN
+        // to the last wireless STA on the last mobilestructure net, thereby
+        // causing packets to traverse CSMA to adhoc to mobilestructure links
+
+        NS_LOG_INFO("Create Applications.");
+        uint16_t port = 9; // Discard port (RFC 863)
+
+        // Let's make sure that the user does not define too few nodes
+        // to make this example work.  We need lanNodes > 1  and mobileNodes > 1
+        //NS_ASSERT(lanNodes > 1 && mobileNodes > 1);
+        // We want the source to be the first node created outside of the manet
+        // Conveniently, the variable "manetNodes" holds this node index value
+        Ptr<Node> appSource = NodeList::GetNode(manetNodes);
+        // We want the sink to be the last node created in the topology.
+        uint32_t lastNodeIndex =
+            manetNodes + manetNodes * (mobileNodes - 1) - 1;
+        Ptr<Node> appSink = NodeList::GetNode(lastNodeIndex);
+        // Let's fetch the IP address of the last node, which is on Ipv4Interface 1
+        Ipv4Address remoteAddr = appSink->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+
+        KpiProbe kpis;
+        Ptr<LatencySink> sink;
+        if (!trafficMatrix.empty())
+        {
+            // many flows between the STAs of different subnets instead, one
+            // sender and one sink application per node
+            matrix.Install(port,
+                           DataRate(flowRate),
+                           packetSize,
+                           Seconds(3),
+                           Seconds(stopTime - 1));
+            kpis.AddSources(matrix.GetSources());
+            ApplicationContainer sinks = matrix.GetSinks();
+            for (auto it = sinks.Begin(); it != sinks.End(); ++it)
+            {
+                (*it)->TraceConnectWithoutContext("Rx",
+                                                  MakeCallback(&KpiProbe::ReceiveFrom, &kpis));
+            }
+        }
+        else
+        {
+            UdpClientHelper client(remoteAddr, port);
+            client.SetAttribute("PacketSize", UintegerValue(packetSize));
+            client.SetAttribute(
+                "Interval",
+                TimeValue(Seconds(packetSize * 8.0 / DataRate(dataRate).GetBitRate())));
+            client.SetAttribute("MaxPackets", UintegerValue(0));
+
+            ApplicationContainer apps = client.Install(appSource);
+            kpis.AddSources(apps);
+            apps.Start(Seconds(3));
+            apps.Stop(Seconds(stopTime - 1));
+
+            // Create a latency sink to receive these packets
+            sink = CreateObject<LatencySink>();
+            sink->SetAttribute("Local",
+                               AddressValue(InetSocketAddress(Ipv4Address::GetAny(), port)));
+            appSink->AddApplication(sink);
+            sink->TraceConnectWithoutContext("Rx", MakeCallback(&KpiProbe::ReceiveFrom, &kpis));
+            sink->SetStartTime(Seconds(3));
+        }
 
-    ///////////////////////////////////////////////////////////////////////////
-    //                                                                       //
-    // Application configuration                                             //
-    //                                                                       //
-    ///////////////////////////////////////////////////////////////////////////
-
-    // Create the OnOff application to send UDP datagrams of size
-    // 210 bytes at a rate of 10 Kb/s, between two nodes
-    // We'll send data from the first wired LAN node on the first wired LAN
-    // to the last wireless STA on the last mobilestructure net, thereby
-    // causing packets to traverse CSMA to adhoc to mobilestructure links
-
-    NS_LOG_INFO("Create Applications.");
-    uint16_t port = 9; // Discard port (RFC 863)
-
-    // Let's make sure that the user does not define too few nodes
-    // to make this example work.  We need lanNodes > 1  and mobileNodes > 1
-    //NS_ASSERT(lanNodes > 1 && mobileNodes > 1);
-    // We want the source to be the first node created outside of the manet
-    // Conveniently, the variable "manetNodes" holds this node index value
-    Ptr<Node> appSource = NodeList::GetNode(manetNodes);
-    // We want the sink to be the last node created in the topology.
-    uint32_t lastNodeIndex =
-        manetNodes + manetNodes * (mobileNodes - 1) - 1;
-    Ptr<Node> appSink = NodeList::GetNode(lastNodeIndex);
-    // Let's fetch the IP address of the last node, which is on Ipv4Interface 1
-    Ipv4Address remoteAddr = appSink->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
-
-    OnOffHelper onoff("ns3::UdpSocketFactory", Address(InetSocketAddress(remoteAddr, port)));
-
-    ApplicationContainer apps = onoff.Install(appSource);
-    apps.Start(Seconds(3));
-    apps.Stop(Seconds(stopTime - 1));
-
-    // Create a packet sink to receive these packets
-    PacketSinkHelper sink("ns3::UdpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port));
-    apps = sink.Install(appSink);
-    apps.Start(Seconds(3));
-
-    ///////////////////////////////////////////////////////////////////////////
-    //                                                                       //
-    // Tracing configuration                                                 //
-    //                                                                       //
-    ///////////////////////////////////////////////////////////////////////////
-
-    NS_LOG_INFO("Configure Tracing.");
-    CsmaHelper csma;
+        ///////////////////////////////////////////////////////////////////////////
+        //                                                                       //
+        // Tracing configuration                                                 //
+        //                                                                       //
+        ///////////////////////////////////////////////////////////////////////////
 
-    //
-    // Let's set up some ns-2-like ascii traces, using another helper class
-    //
-    AsciiTraceHelper ascii;
-    Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream("hanet-compairson.tr");
-    wifiPhy.EnableAsciiAll(stream);
-    csma.EnableAsciiAll(stream);
-    internet.EnableAsciiIpv4All(stream);
-
-    // Csma captures in non-promiscuous mode
-    csma.EnablePcapAll("hanet-compairson", false);
-    // pcap captures on the manet wifi devices
-    wifiPhy.EnablePcap("hanet-compairson", manetDevices, false);
-    // pcap trace on the application data sink
-    wifiPhy.EnablePcap("hanet-compairson", appSink->GetId(), 0);
-
-    if (useCourseChangeCallback)
+        NS_LOG_INFO("Configure Tracing.");
+        CsmaHelper csma;
+
+        //
+        // Packet traces: compact binary records by default (decode them with
+        // binary-trace-decode), or the ns-2-like ascii traces
+        //
+        std::unique_ptr<BinaryTraceWriter> binaryTrace;
+        std::unique_ptr<AsyncOstream> asciiTrace;
+        if (traceFormat == "binary")
+        {
+            binaryTrace = std::make_unique<BinaryTraceWriter>(outName + ".btr", traceDigest);
+            binaryTrace->EnableWifi(NodeContainer::GetGlobal());
+            binaryTrace->EnableCsma(NodeContainer::GetGlobal());
+            binaryTrace->EnableIpv4(NodeContainer::GetGlobal());
+        }
+        else if (traceFormat == "ascii")
+        {
+            asciiTrace = std::make_unique<AsyncOstream>(outName + ".tr");
+            Ptr<OutputStreamWrapper> stream = Create<OutputStreamWrapper>(asciiTrace.get());
+            wifiPhy.EnableAsciiAll(stream);
+            csma.EnableAsciiAll(stream);
+            internet.EnableAsciiIpv4All(stream);
+        }
+
+        // Csma captures in non-promiscuous mode
+        csma.EnablePcapAll(outName, false);
+        // pcap captures on the manet wifi devices
+        manetPhy.EnablePcap(outName, manetDevices, false);
+        // pcap trace on the application data sink
+        wifiPhy.EnablePcap(outName, appSink->GetId(), 0);
+
+        // course changes are printed on stdout from the trace writer thread
+        std::unique_ptr<AsyncOstream> courseChanges;
+        if (useCourseChangeCallback)
+        {
+            courseChanges = std::make_unique<AsyncOstream>(STDOUT_FILENO);
+            Config::Connect("/NodeList/*/$ns3::MobilityModel/CourseChange",
+                            MakeBoundCallback(&CourseChangeCallback, courseChanges.get()));
+        }
+        NS_LOG_UNCOND(lastNodeIndex);
+        AnimOutput anim(outName + ".xml", animMode, Seconds(animInterval));
+
+        Ptr<PartitionProfilingSimulatorImpl> partitionProfiler;
+        if (partitionPlan)
+        {
+            partitionProfiler =
+                DynamicCast<PartitionProfilingSimulatorImpl>(Simulator::GetImplementation());
+            partitionProfiler->SetPlan(partitionPlan.get(), partitionLookahead);
+        }
+
+        Ptr<ModuleProfilingSimulatorImpl> moduleProfiler;
+        if (!scalingSizes.empty())
+        {
+            moduleProfiler =
+                DynamicCast<ModuleProfilingSimulatorImpl>(Simulator::GetImplementation());
+        }
+
+        NS_LOG_INFO("Run Simulation.");
+        Simulator::Stop(Seconds(stopTime));
+        phases.Lap("setup");
+        scheduler.Start();
+        Simulator::Run();
+        scheduler.Stop();
+        phases.Lap("run");
+        scheduler.PrintReport(std::clog);
+        anim.Close();
+        if (manetChannel)
+        {
+            NS_LOG_UNCOND("Grid channel: " << manetChannel->GetCandidateCount()
+                                           << " receivers looked at, "
+                                           << manetChannel->GetDeliveryCount() << " deliveries");
+        }
+        if (partitionProfiler)
+        {
+            partitionProfiler->PrintReport(std::cout);
+        }
+        if (binaryTrace)
+        {
+            binaryTrace->Close();
+            NS_LOG_UNCOND("Binary trace records: " << binaryTrace->GetRecordCount());
+            binaryTrace->GetOutput().PrintStats(std::clog, outName + ".btr");
+        }
+        if (asciiTrace)
+        {
+            asciiTrace->Close();
+            asciiTrace->GetWriter().PrintStats(std::clog, outName + ".tr");
+        }
+        if (courseChanges)
+        {
+            courseChanges->Close();
+        }
+        if (sink)
+        {
+            sink->PrintReport(std::cout, outName);
+        }
+        else
+        {
+            matrix.PrintReport(std::cout);
+        }
+        if (moduleProfiler)
+        {
+            scalingSample.nodes = NodeList::GetNNodes();
+            scalingSample.modules = moduleProfiler->GetModuleStats();
+        }
+        Simulator::Destroy();
+        phases.Lap("teardown");
+
+        // the traffic runs from 3 s to stopTime - 1
+        return kpis.GetKpis(Seconds(stopTime - 4));
+    };
+
+    if (ciTarget > 0)
     {
-        Config::Connect("/NodeList/*/$ns3::MobilityModel/CourseChange",
-                        MakeCallback(&CourseChangeCallback));
+        ReplicationController replications(KpiProbe::GetKpiNames(),
+                                           ciTarget,
+                                           ciConfidence,
+                                           minRuns,
+                                           maxRuns,
+                                           jobs);
+        ReplicationController::Summary summary =
+            replications.Run(RngSeedManager::GetRun(), [&](uint32_t run) {
+                RngSeedManager::SetRun(run);
+                return runScenario("hanet-compairson-run" + std::to_string(run));
+            });
+        replications.PrintSummary(std::cout, m_protocolName, summary);
+        return summary.failedRuns.empty() ? 0 : 1;
     }
-    NS_LOG_UNCOND(lastNodeIndex);
-    AnimationInterface anim("hanet-compairson.xml");
-
-    NS_LOG_INFO("Run Simulation.");
-    Simulator::Stop(Seconds(stopTime));
-    Simulator::Run();
-    Simulator::Destroy();
+    if (!scalingSizes.empty())
+    {
+        // each size runs in a child of its own, see ScalingStudy
+        ScalingStudy study(scalingSizes);
+        std::vector<ScalingStudy::Sample> samples = study.Run([&](uint32_t size) {
+            manetNodes = size;
+            runScenario("hanet-compairson-scale" + std::to_string(size));
+            scalingSample.phases = phases.GetSeconds();
+            return scalingSample;
+        });
+        ScalingStudy::PrintReport(std::cout, samples);
+        return samples.size() == scalingSizes.size() ? 0 : 1;
+    }
+    runScenario("hanet-compairson");
 
     return 0;
 }
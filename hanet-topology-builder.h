@@ -0,0 +1,364 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef HANET_TOPOLOGY_BUILDER_H
+#define HANET_TOPOLOGY_BUILDER_H
+
+#include "address-plan.h"
+
+#include "ns3/assert.h"
+#include "ns3/csma-helper.h"
+#include "ns3/data-rate.h"
+#include "ns3/double.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/mobility-helper.h"
+#include "ns3/net-device-container.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/rectangle.h"
+#include "ns3/ssid.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/wifi-mac-helper.h"
+#include "ns3/wifi-mac.h"
+#include "ns3/wifi-net-device.h"
+#include "ns3/yans-wifi-helper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Builds the edge of a hierarchical MANET: behind every backbone node, an
+ * optional CSMA LAN and an 802.11 infrastructure subnet with the backbone
+ * node as its AP, the STAs moving around it.
+ *
+ * The scenarios used to build each LAN and subnet in a loop of its own
+ * helpers, SSID string stream, position allocator and stack installation.
+ * The builder does each step for all of them at once instead, in the
+ * order the loops created things, so node ids and addresses are the same:
+ * it creates every node, installs the devices with MAC helpers configured
+ * once (the SSID of each subnet is set on its MACs afterwards), installs
+ * the stack on all the new nodes in one call, addresses the links with
+ * AddressPlan and places the nodes with one grid allocator per kind.
+ * Every subnet keeps a channel of its own, since that is what keeps the
+ * BSSs apart.
+ */
+class HanetTopologyBuilder
+{
+  public:
+    HanetTopologyBuilder();
+
+    /**
+     * \param nodes The nodes of each AP subnet, the AP included.
+     */
+    void SetSubnetNodes(uint32_t nodes);
+    /**
+     * \param nodes The nodes of each LAN, the backbone node included; less
+     * than 2 for no LANs.
+     */
+    void SetLanNodes(uint32_t nodes);
+    /**
+     * \param prefix The SSIDs are the prefix followed by the subnet index.
+     */
+    void SetSsidPrefix(const std::string& prefix);
+    /**
+     * \param phy The PHY of the subnets.
+     * \param channel The helper that creates the channel of each subnet.
+     */
+    void SetWifi(const YansWifiPhyHelper& phy, const YansWifiChannelHelper& channel);
+
+    /**
+     * Build the LANs, then the subnets, of every backbone node.  Call once.
+     * \param backbone The backbone nodes, with their stack and mobility.
+     * \param internet The stack of the new nodes.
+     * \param subnetAddrs The address plan of the subnets.
+     * \param lanAddrs The address plan of the LANs, if any.
+     */
+    void Build(const NodeContainer& backbone,
+               const InternetStackHelper& internet,
+               AddressPlan& subnetAddrs,
+               AddressPlan* lanAddrs = nullptr);
+
+    /**
+     * \param subnet A backbone node index.
+     * \return the STAs of its subnet.
+     */
+    const NodeContainer& GetStas(uint32_t subnet) const;
+    /**
+     * \param subnet A backbone node index.
+     * \return the devices of its subnet, the AP first.
+     */
+    const NetDeviceContainer& GetSubnetDevices(uint32_t subnet) const;
+    /**
+     * \param lan A backbone node index.
+     * \return the hosts of its LAN.
+     */
+    const NodeContainer& GetLanHosts(uint32_t lan) const;
+    /**
+     * \return every STA, subnet by subnet.
+     */
+    const NodeContainer& GetAllStas() const;
+    /**
+     * \return the wall clock seconds Build() took.
+     */
+    double GetBuildSeconds() const;
+
+    /**
+     * Print a topology-build line.
+     * \param os The output stream.
+     */
+    void PrintReport(std::ostream& os) const;
+
+  private:
+    /**
+     * Take consecutive nodes of a container.
+     * \param nodes The container.
+     * \param first The first node.
+     * \param count The number of nodes.
+     * \return those nodes.
+     */
+    static NodeContainer Slice(const NodeContainer& nodes, uint32_t first, uint32_t count);
+
+    uint32_t m_subnetNodes{2};                       //!< Nodes of a subnet, AP included.
+    uint32_t m_lanNodes{0};                          //!< Nodes of a LAN, router included.
+    std::string m_ssidPrefix{"wifi-mobile"};         //!< SSID prefix.
+    WifiHelper m_wifi;                               //!< Subnet wifi.
+    YansWifiPhyHelper m_phy;                         //!< Subnet PHY.
+    YansWifiChannelHelper m_channel;                 //!< Subnet channels.
+    NodeContainer m_allStas;                         //!< Every STA.
+    std::vector<NodeContainer> m_stas;               //!< STAs by subnet.
+    std::vector<NetDeviceContainer> m_subnetDevices; //!< Devices by subnet.
+    std::vector<NodeContainer> m_lanHosts;           //!< Hosts by LAN.
+    double m_buildSeconds{0};                        //!< Duration of Build().
+};
+
+inline HanetTopologyBuilder::HanetTopologyBuilder()
+    : m_channel(YansWifiChannelHelper::Default())
+{
+    m_phy.SetPcapDataLinkType(WifiPhyHelper::DLT_IEEE802_11_RADIO);
+}
+
+inline void
+HanetTopologyBuilder::SetSubnetNodes(uint32_t nodes)
+{
+    NS_ASSERT_MSG(nodes > 0, "A subnet has at least its AP");
+    m_subnetNodes = nodes;
+}
+
+inline void
+HanetTopologyBuilder::SetLanNodes(uint32_t nodes)
+{
+    m_lanNodes = nodes;
+}
+
+inline void
+HanetTopologyBuilder::SetSsidPrefix(const std::string& prefix)
+{
+    m_ssidPrefix = prefix;
+}
+
+inline void
+HanetTopologyBuilder::SetWifi(const YansWifiPhyHelper& phy, const YansWifiChannelHelper& channel)
+{
+    m_phy = phy;
+    m_channel = channel;
+}
+
+inline NodeContainer
+HanetTopologyBuilder::Slice(const NodeContainer& nodes, uint32_t first, uint32_t count)
+{
+    NodeContainer slice;
+    for (uint32_t j = 0; j < count; j++)
+    {
+        slice.Add(nodes.Get(first + j));
+    }
+    return slice;
+}
+
+inline void
+HanetTopologyBuilder::Build(const NodeContainer& backbone,
+                            const InternetStackHelper& internet,
+                            AddressPlan& subnetAddrs,
+                            AddressPlan* lanAddrs)
+{
+    auto start = std::chrono::steady_clock::now();
+    uint32_t n = backbone.GetN();
+    uint32_t hostsPerLan = m_lanNodes > 1 ? m_lanNodes - 1 : 0;
+    uint32_t stasPerSubnet = m_subnetNodes - 1;
+    NS_ASSERT_MSG(hostsPerLan == 0 || lanAddrs, "LANs need an address plan");
+    NS_ASSERT_MSG(m_stas.empty(), "The topology is already built");
+
+    // the nodes, in the order the per backbone node loops created them
+    NodeContainer allLanHosts;
+    allLanHosts.Create(n * hostsPerLan);
+    m_allStas.Create(n * stasPerSubnet);
+    m_lanHosts.reserve(n);
+    m_stas.reserve(n);
+    m_subnetDevices.reserve(n);
+
+    // the devices
+    std::vector<NetDeviceContainer> lanDevices;
+    if (hostsPerLan > 0)
+    {
+        lanDevices.reserve(n);
+        CsmaHelper csma;
+        csma.SetChannelAttribute("DataRate", DataRateValue(DataRate(5000000)));
+        csma.SetChannelAttribute("Delay", TimeValue(MilliSeconds(2)));
+        for (uint32_t i = 0; i < n; i++)
+        {
+            m_lanHosts.push_back(Slice(allLanHosts, i * hostsPerLan, hostsPerLan));
+            lanDevices.push_back(csma.Install(NodeContainer(backbone.Get(i), m_lanHosts.back())));
+        }
+    }
+    WifiMacHelper staMac;
+    staMac.SetType("ns3::StaWifiMac");
+    WifiMacHelper apMac;
+    apMac.SetType("ns3::ApWifiMac");
+    for (uint32_t i = 0; i < n; i++)
+    {
+        m_stas.push_back(Slice(m_allStas, i * stasPerSubnet, stasPerSubnet));
+        m_phy.SetChannel(m_channel.Create());
+        NetDeviceContainer staDevices = m_wifi.Install(m_phy, staMac, m_stas.back());
+        NetDeviceContainer apDevices = m_wifi.Install(m_phy, apMac, backbone.Get(i));
+        m_subnetDevices.emplace_back(apDevices, staDevices);
+        Ssid ssid(m_ssidPrefix + std::to_string(i));
+        const NetDeviceContainer& devices = m_subnetDevices.back();
+        for (auto it = devices.Begin(); it != devices.End(); ++it)
+        {
+            DynamicCast<WifiNetDevice>(*it)->GetMac()->SetSsid(ssid);
+        }
+    }
+
+    // the stacks and the addresses
+    internet.Install(allLanHosts);
+    internet.Install(m_allStas);
+    for (const NetDeviceContainer& devices : lanDevices)
+    {
+        lanAddrs->Assign(devices);
+    }
+    for (const NetDeviceContainer& devices : m_subnetDevices)
+    {
+        subnetAddrs.Assign(devices);
+    }
+
+    // the positions, relative to the backbone node: the LAN hosts at rest
+    // 10 m apart, the STAs moving within 10 m
+    MobilityHelper lanMobility;
+    lanMobility.SetPositionAllocator("ns3::GridPositionAllocator",
+                                     "MinX",
+                                     DoubleValue(0.0),
+                                     "MinY",
+                                     DoubleValue(10.0),
+                                     "DeltaX",
+                                     DoubleValue(0.0),
+                                     "DeltaY",
+                                     DoubleValue(10.0),
+                                     "GridWidth",
+                                     UintegerValue(std::max(hostsPerLan, 1U)),
+                                     "LayoutType",
+                                     StringValue("ColumnFirst"));
+    lanMobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    MobilityHelper staMobility;
+    staMobility.SetPositionAllocator("ns3::GridPositionAllocator",
+                                     "MinX",
+                                     DoubleValue(0.0),
+                                     "MinY",
+                                     DoubleValue(0.0),
+                                     "DeltaX",
+                                     DoubleValue(0.0),
+                                     "DeltaY",
+                                     DoubleValue(1.0),
+                                     "GridWidth",
+                                     UintegerValue(std::max(stasPerSubnet, 1U)),
+                                     "LayoutType",
+                                     StringValue("ColumnFirst"));
+    staMobility.SetMobilityModel("ns3::RandomDirection2dMobilityModel",
+                                 "Bounds",
+                                 RectangleValue(Rectangle(-10, 10, -10, 10)),
+                                 "Speed",
+                                 StringValue("ns3::ConstantRandomVariable[Constant=3]"),
+                                 "Pause",
+                                 StringValue("ns3::ConstantRandomVariable[Constant=0.4]"));
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (hostsPerLan > 0)
+        {
+            lanMobility.PushReferenceMobilityModel(backbone.Get(i));
+            lanMobility.Install(m_lanHosts[i]);
+            lanMobility.PopReferenceMobilityModel();
+        }
+        staMobility.PushReferenceMobilityModel(backbone.Get(i));
+        staMobility.Install(m_stas[i]);
+        staMobility.PopReferenceMobilityModel();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    m_buildSeconds = elapsed.count();
+}
+
+inline const NodeContainer&
+HanetTopologyBuilder::GetStas(uint32_t subnet) const
+{
+    return m_stas.at(subnet);
+}
+
+inline const NetDeviceContainer&
+HanetTopologyBuilder::GetSubnetDevices(uint32_t subnet) const
+{
+    return m_subnetDevices.at(subnet);
+}
+
+inline const NodeContainer&
+HanetTopologyBuilder::GetLanHosts(uint32_t lan) const
+{
+    return m_lanHosts.at(lan);
+}
+
+inline const NodeContainer&
+HanetTopologyBuilder::GetAllStas() const
+{
+    return m_allStas;
+}
+
+inline double
+HanetTopologyBuilder::GetBuildSeconds() const
+{
+    return m_buildSeconds;
+}
+
+inline void
+HanetTopologyBuilder::PrintReport(std::ostream& os) const
+{
+    uint32_t lanHosts = 0;
+    for (const NodeContainer& hosts : m_lanHosts)
+    {
+        lanHosts += hosts.GetN();
+    }
+    os << "topology-build subnets=" << m_stas.size() << " stas=" << m_allStas.GetN()
+       << " lans=" << m_lanHosts.size() << " lanHosts=" << lanHosts
+       << " seconds=" << m_buildSeconds << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* HANET_TOPOLOGY_BUILDER_H */
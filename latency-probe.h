@@ -0,0 +1,309 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include "p2-quantile.h"
+
+#include "ns3/address.h"
+#include "ns3/application.h"
+#include "ns3/packet.h"
+#include "ns3/seq-ts-header.h"
+#include "ns3/simulator.h"
+#include "ns3/socket.h"
+#include "ns3/traced-callback.h"
+#include "ns3/udp-socket-factory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * UDP sink that measures the one-way latency of the packets of UdpClient
+ * sources, which start every packet with a SeqTsHeader (sequence number and
+ * send time).  Everything is computed as the packets arrive, in memory that
+ * does not grow with the length of the run:
+ * - the delay mean and maximum, and its p50, p90 and p99 with P-square
+ *   sketches (see P2Quantile);
+ * - the RFC 3550 interarrival jitter of each source, J += (|D| - J) / 16
+ *   with D the difference of the transit times of consecutive packets;
+ * - reordering, the packets that arrive after a higher sequence number of
+ *   their source;
+ * - loss, the sequence numbers up to the highest one received that never
+ *   arrived, so packets still in flight at the end are not counted.
+ *
+ * The Rx trace has the signature of the PacketSink one, so a KpiProbe can
+ * be attached the same way.
+ */
+class LatencySink : public Application
+{
+  public:
+    /**
+     * Register this type.
+     * \return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    LatencySink();
+
+    /**
+     * \return the packets received with a SeqTsHeader.
+     */
+    uint64_t GetReceived() const;
+    /**
+     * \return the packets lost, over all the sources.
+     */
+    uint64_t GetLost() const;
+    /**
+     * \return the packets received out of order.
+     */
+    uint64_t GetReordered() const;
+    /**
+     * \return the mean delay in seconds.
+     */
+    double GetMeanDelay() const;
+    /**
+     * \return the median delay in seconds.
+     */
+    double GetDelayP50() const;
+    /**
+     * \return the 99th percentile of the delay in seconds.
+     */
+    double GetDelayP99() const;
+    /**
+     * \return the mean over the sources of their RFC 3550 jitter, in seconds.
+     */
+    double GetJitter() const;
+
+    /**
+     * Print a latency-report line.
+     * \param os The output stream.
+     * \param label The label of the line.
+     */
+    void PrintReport(std::ostream& os, const std::string& label) const;
+
+  private:
+    /// Sequence and jitter state of one source.
+    struct SourceState
+    {
+        uint32_t highestSeq{0}; //!< Highest sequence number received.
+        uint64_t received{0};   //!< Packets received.
+        double lastTransit{0};  //!< Transit time of the previous packet.
+        double jitter{0};       //!< RFC 3550 jitter in seconds.
+    };
+
+    void StartApplication() override;
+    void StopApplication() override;
+
+    /**
+     * Read the pending packets.
+     * \param socket The socket.
+     */
+    void HandleRead(Ptr<Socket> socket);
+    /**
+     * Account for a packet.
+     * \param header Its SeqTsHeader.
+     * \param from Its sender.
+     */
+    void Record(const SeqTsHeader& header, const Address& from);
+
+    Address m_local;                                             //!< Listening address.
+    Ptr<Socket> m_socket;                                        //!< Listening socket.
+    std::map<Address, SourceState> m_sources;                    //!< State by sender address.
+    uint64_t m_received{0};                                      //!< Packets received.
+    uint64_t m_reordered{0};                                     //!< Packets out of order.
+    double m_delaySum{0};                                        //!< Sum of the delays.
+    double m_maxDelay{0};                                        //!< Largest delay.
+    P2Quantile m_p50;                                            //!< Median delay sketch.
+    P2Quantile m_p90;                                            //!< 90th percentile sketch.
+    P2Quantile m_p99;                                            //!< 99th percentile sketch.
+    TracedCallback<Ptr<const Packet>, const Address&> m_rxTrace; //!< Received packets.
+};
+
+NS_OBJECT_ENSURE_REGISTERED(LatencySink);
+
+inline TypeId
+LatencySink::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::LatencySink")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<LatencySink>()
+            .AddAttribute("Local",
+                          "The address to listen on.",
+                          AddressValue(),
+                          MakeAddressAccessor(&LatencySink::m_local),
+                          MakeAddressChecker())
+            .AddTraceSource("Rx",
+                            "A packet has been received.",
+                            MakeTraceSourceAccessor(&LatencySink::m_rxTrace),
+                            "ns3::Packet::AddressTracedCallback");
+    return tid;
+}
+
+inline LatencySink::LatencySink()
+    : m_p50(0.5),
+      m_p90(0.9),
+      m_p99(0.99)
+{
+}
+
+inline void
+LatencySink::StartApplication()
+{
+    if (!m_socket)
+    {
+        m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+        if (m_socket->Bind(m_local) == -1)
+        {
+            NS_FATAL_ERROR("LatencySink cannot bind its socket");
+        }
+    }
+    m_socket->SetRecvCallback(MakeCallback(&LatencySink::HandleRead, this));
+}
+
+inline void
+LatencySink::StopApplication()
+{
+    if (m_socket)
+    {
+        m_socket->Close();
+        m_socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+    }
+}
+
+inline void
+LatencySink::HandleRead(Ptr<Socket> socket)
+{
+    Ptr<Packet> packet;
+    Address from;
+    while ((packet = socket->RecvFrom(from)))
+    {
+        SeqTsHeader header;
+        if (packet->GetSize() >= header.GetSerializedSize())
+        {
+            packet->PeekHeader(header);
+            Record(header, from);
+        }
+        m_rxTrace(packet, from);
+    }
+}
+
+inline void
+LatencySink::Record(const SeqTsHeader& header, const Address& from)
+{
+    double delay = (Simulator::Now() - header.GetTs()).GetSeconds();
+    m_received++;
+    m_delaySum += delay;
+    m_maxDelay = std::max(m_maxDelay, delay);
+    m_p50.Add(delay);
+    m_p90.Add(delay);
+    m_p99.Add(delay);
+
+    // the source port tells apart the sources of one node
+    SourceState& source = m_sources[from];
+    uint32_t seq = header.GetSeq();
+    if (source.received > 0)
+    {
+        if (seq < source.highestSeq)
+        {
+            m_reordered++;
+        }
+        // the transit time is the delay, as the clocks are the same
+        source.jitter += (std::abs(delay - source.lastTransit) - source.jitter) / 16;
+    }
+    source.highestSeq = source.received > 0 ? std::max(source.highestSeq, seq) : seq;
+    source.lastTransit = delay;
+    source.received++;
+}
+
+inline uint64_t
+LatencySink::GetReceived() const
+{
+    return m_received;
+}
+
+inline uint64_t
+LatencySink::GetLost() const
+{
+    uint64_t lost = 0;
+    for (const auto& entry : m_sources)
+    {
+        // UdpClient numbers its packets from 0
+        uint64_t expected = uint64_t(entry.second.highestSeq) + 1;
+        lost += expected > entry.second.received ? expected - entry.second.received : 0;
+    }
+    return lost;
+}
+
+inline uint64_t
+LatencySink::GetReordered() const
+{
+    return m_reordered;
+}
+
+inline double
+LatencySink::GetMeanDelay() const
+{
+    return m_received ? m_delaySum / m_received : 0.0;
+}
+
+inline double
+LatencySink::GetDelayP50() const
+{
+    return m_p50.Get();
+}
+
+inline double
+LatencySink::GetDelayP99() const
+{
+    return m_p99.Get();
+}
+
+inline double
+LatencySink::GetJitter() const
+{
+    double sum = 0;
+    for (const auto& entry : m_sources)
+    {
+        sum += entry.second.jitter;
+    }
+    return m_sources.empty() ? 0.0 : sum / m_sources.size();
+}
+
+inline void
+LatencySink::PrintReport(std::ostream& os, const std::string& label) const
+{
+    uint64_t lost = GetLost();
+    os << "latency-report " << label << " sources=" << m_sources.size()
+       << " received=" << m_received << " lost=" << lost
+       << " lossRatio=" << (m_received + lost ? double(lost) / (m_received + lost) : 0.0)
+       << " reordered=" << m_reordered << " meanDelay=" << GetMeanDelay()
+       << " p50=" << m_p50.Get() << " p90=" << m_p90.Get() << " p99=" << m_p99.Get()
+       << " maxDelay=" << m_maxDelay << " jitter=" << GetJitter() << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* LATENCY_PROBE_H */
@@ -56,12 +56,98 @@
  * to the end of the simulation.
  *
  * The program outputs a few items:
- * - packet receptions are notified to stdout such as:
+ * - with --logPackets, packet receptions are notified to stdout such as:
  *   <timestamp> <node-id> received one packet from <src-address>
- * - each second, the data reception statistics are tabulated and output
- *   to a comma-separated value (csv) file
+ *   (one packet out of every --logSampleEvery); otherwise receptions are only
+ *   counted, and per-sink and per-source totals with first and last arrival
+ *   times are written to <trace-name>.rx.csv at the end of the run
+ * - each second, the data reception statistics are tabulated and buffered;
+ *   they are written to a comma-separated value (csv) file, or to a compact
+ *   columnar binary file with --outputFormat=binary, when the run ends (or
+ *   every --flushRows samples)
+ * - with --flowStats, per-flow counters, throughput, and delay and jitter
+ *   means and quantiles go to <trace-name>.flows.csv and the delay and
+ *   jitter histograms to <trace-name>.flowhist.csv (see flow-stats.h); unlike
+ *   --flowMonitor this works with DSR too, and costs a hash lookup per packet
+ *   (the flow-statistics cases of scenario-benchmark compare the two)
  * - some tracing and flow monitor configuration that used to work is
  *   left commented inline in the program
+ *
+ * With --sweep the program becomes a driver: it expands the parameter grid
+ * given by --sweepProtocols, --sweepTxp, --sweepNodes, --sweepSpeeds and
+ * --sweepRuns, runs every point as an independent experiment in a forked
+ * worker process (at most --jobs at a time, default one per core) and merges
+ * the per-run CSV files into --CSVfileName, adding the NumberOfNodes,
+ * NodeSpeed and RngRun columns.
+ *
+ * With --ciTarget the number of replications is no longer fixed: they run
+ * with consecutive RngRun values from --firstRun until the --ciConfidence
+ * Student t interval of the throughput, delivery ratio and mean delay of the
+ * measured traffic is narrower than --ciTarget times their mean (at least
+ * --minRuns, at most --maxRuns replications), and a replication-report line
+ * is printed; see replication-controller.h.  Without --sweep the current
+ * configuration is replicated and each run keeps its own -run<N> files;
+ * with --sweep each grid point is replicated in turn (--sweepRuns is then
+ * unused) and the runs are merged as usual.
+ *
+ * With --resultCache=DIR the sweep and replication runs first look their
+ * parameters, RngRun, attribute defaults and build up in DIR (see
+ * result-cache.h); a hit copies the stored time series and side outputs
+ * (.rx.csv, .mob, and the flow statistics asked for) back to their per-run
+ * names and returns the stored KPIs without simulating, and a miss stores
+ * the results of the run.  Extending a grid only simulates the new cells.
+ * Snapshot runs are never cached.
+ *
+ * With --detectWarmup the per-second receive rate of the measured traffic
+ * goes through an online MSER-5 transient detector (transient-detector.h),
+ * and a warmup-report line gives the end of the start-up transient (route
+ * discovery, ARP) and the steady-state mean after it.  The throughput KPI
+ * of every such run is then the mean of the 5 s batches after the detected
+ * warm-up, or of all of them when none was found, so that the runs of a
+ * replication set or sweep share one definition.  --stopWhenSteady=N ends
+ * the run as soon as N steady-state batches exist instead of after the
+ * full 100 s.
+ *
+ * With --trajectoryFile the nodes replay precomputed waypoint trajectories
+ * (written by trajectory-gen) instead of drawing RandomWaypoint motion
+ * online, so that every protocol run sees exactly the same motion.  Course
+ * changes are then only traced with --traceMobility.  The speed is then
+ * that of the file, so a --sweep over several --sweepSpeeds is rejected.
+ * One file would also give every RngRun the same motion, so replications
+ * (--ciTarget, --sweepRuns above 1) need a file name with "{run}" in it,
+ * which is replaced by the RngRun of each run.
+ *
+ * With --warmStart the OLSR and DSDV timers are shortened until the routing
+ * tables cover the connectivity graph of the current node positions, then
+ * restored, and the traffic starts as soon as the coverage has held for two
+ * of the normal update periods (at the latest at the usual 100 s), for the
+ * same 100 s of measurement; see routing-warm-start.h.  AODV and DSR start
+ * their traffic at once.  Either way the routing coverage at the start of
+ * the measurement is printed, so warm and cold runs can be compared.
+ * RandomWaypoint nodes start uniformly spread and only drift towards the
+ * centre-heavy distribution over the first legs, and with speeds drawn from
+ * [0, nodeSpeed] the motion never becomes stationary, so no shorter warm-up
+ * measures the same thing as a cold run.  The measurement therefore never
+ * starts before --mobilityWarmup seconds of motion, 100 s by default as in
+ * a cold run: with online RandomWaypoint motion a warm start only gives
+ * converged routes at the start of the measurement and saves no simulated
+ * time.  The time is saved with --trajectoryFile, whose replay then starts
+ * --mobilityWarmup seconds into the trajectories (generate them with a
+ * --duration that covers it), so the motion is already that old at 0 s and
+ * the measurement starts once the routing has converged.
+ *
+ * With --snapshotVariants the network is built and warmed up once, up to
+ * the point where the traffic would start, and then forked into one process
+ * per traffic variant (at most --jobs at a time), each continuing from the
+ * same in-memory state through copy-on-write pages.  Variants are separated
+ * by ';' and set any of rate (OnOff data rate), size (packet size) and
+ * sinks (number of source/sink pairs), e.g.
+ * "rate=2048bps,sinks=10;rate=8192bps,size=512,sinks=5".  Each variant
+ * writes <CSVfileName>-<variant>.csv and <trace-name>-<variant>.* files
+ * covering the measurement only, with seconds counted from the branch
+ * point; the shared prefix goes to the usual files.  The exit status is
+ * non-zero if any variant failed.  Within a --sweep the variants of each
+ * point run one at a time, since the sweep already fills the --jobs.
  */
 
 #include "ns3/aodv-module.h"
@@ -76,8 +162,24 @@
 #include "ns3/olsr-module.h"
 #include "ns3/yans-wifi-helper.h"
 
+#include "async-trace-writer.h"
+#include "flow-stats.h"
+#include "fork-pool.h"
+#include "mmap-trajectory-mobility-model.h"
+#include "receive-stats.h"
+#include "replication-controller.h"
+#include "result-cache.h"
+#include "routing-warm-start.h"
+#include "scheduler-selection.h"
+#include "throughput-recorder.h"
+#include "transient-detector.h"
+
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 
 using namespace ns3;
 using namespace dsr;
@@ -95,8 +197,9 @@ class RoutingExperiment
     RoutingExperiment();
     /**
      * Run the experiment.
+     * \return the process exit status, non-zero if a snapshot variant failed.
      */
-    void Run();
+    int Run();
 
     /**
      * Handles the command-line parameters.
@@ -105,7 +208,50 @@ class RoutingExperiment
      */
     void CommandSetup(int argc, char** argv);
 
+    /**
+     * \return true if the command line asked for a parameter sweep.
+     */
+    bool IsSweep() const;
+
+    /**
+     * Run every point of the sweep grid in a pool of worker processes
+     * and merge their CSV output.
+     * \return the process exit status, non-zero if any run failed.
+     */
+    int RunSweep();
+
+    /**
+     * \return true if the command line asked for sequential replications.
+     */
+    bool IsReplicated() const;
+
+    /**
+     * Replicate the configuration until its KPIs are precise enough.
+     * \return the process exit status, non-zero if any run failed.
+     */
+    int RunReplications();
+
   private:
+    /**
+     * \param run The RngRun.
+     * \return the parameters that decide the results of a run, one
+     * key=value per line.
+     */
+    std::string DescribeParameters(uint32_t run) const;
+    /**
+     * \param run The RngRun.
+     * \return the trajectory file of a run: --trajectoryFile with any
+     * "{run}" replaced by the RngRun.
+     */
+    std::string GetTrajectoryFile(uint32_t run) const;
+    /**
+     * Run with the given RngRun, or take the results from the cache.
+     * \param cache The result cache.
+     * \param run The RngRun.
+     * \return the KPIs.
+     */
+    std::vector<double> RunCached(const ResultCache& cache, uint32_t run);
+
     /**
      * Setup the receiving socket in a Sink Node.
      * \param addr The address of the node.
@@ -128,11 +274,50 @@ class RoutingExperiment
     uint32_t packetsReceived{0}; //!< Total received packets.
 
     std::string m_CSVfileName{"manet-routing.output.csv"}; //!< CSV filename.
+    std::string m_traceName{"manet-routing-compare"};      //!< Prefix of the trace files.
     int m_nSinks{10};                                      //!< Number of sink nodes.
     std::string m_protocolName{"AODV"};                    //!< Protocol name.
     double m_txp{7.5};                                     //!< Tx power.
+    int m_nWifis{50};                                      //!< Number of nodes.
+    int m_nodeSpeed{20};                                   //!< Maximum node speed in m/s.
     bool m_traceMobility{false};                           //!< Enable mobility tracing.
+    std::string m_trajectoryFile;                          //!< Precomputed trajectories.
     bool m_flowMonitor{false};                             //!< Enable FlowMonitor.
+    bool m_flowStats{false};                               //!< Enable FlowStats.
+    FlowStats m_flows;                                     //!< Per-flow statistics.
+    std::string m_outputFormat{"csv"};                     //!< Throughput output format.
+    uint32_t m_flushRows{0};                               //!< Samples per write, 0 = at end.
+    ThroughputRecorder m_recorder;                         //!< Throughput time series.
+    bool m_logPackets{false};                              //!< Log received packets.
+    uint32_t m_logSampleEvery{1};                          //!< Log one packet out of N.
+    ReceiveStats m_rxStats;                                //!< Receive counters.
+    std::string m_scheduler{"Map"};                        //!< Event scheduler.
+    bool m_schedulerStats{false};                          //!< Report the peak queue size.
+    bool m_warmStart{false};                               //!< Start once routing converged.
+    double m_warmStartCoverage{0.95};                      //!< Converged routing coverage.
+    double m_mobilityWarmup{100.0};                        //!< Motion before a warm start.
+    std::string m_snapshotVariants;                        //!< Traffic variants to fork.
+    KpiProbe m_kpis;                                       //!< KPIs of the measured traffic.
+    std::vector<double> m_kpiValues;                       //!< KPIs of the last run.
+    bool m_detectWarmup{false};                            //!< Detect the start-up transient.
+    uint32_t m_stopWhenSteady{0};                          //!< Steady batches to stop at, 0 = off.
+    TransientDetector m_transient;                         //!< Receive rate warm-up detector.
+    double m_trafficStart{-1};                             //!< Start of the measured traffic.
+    double m_timeOrigin{0};                                //!< Time of the first sample row.
+
+    bool m_sweep{false};                                //!< Run the sweep driver.
+    std::string m_sweepProtocols{"OLSR,AODV,DSDV,DSR"}; //!< Protocols to sweep.
+    std::string m_sweepTxp{"7.5"};                      //!< Tx powers to sweep.
+    std::string m_sweepNodes{"50"};                     //!< Node counts to sweep.
+    std::string m_sweepSpeeds{"20"};                    //!< Node speeds to sweep.
+    uint32_t m_sweepRuns{1};                            //!< Replications per grid point.
+    uint32_t m_firstRun{1};                             //!< RngRun of the first replication.
+    uint32_t m_jobs{0};                                 //!< Worker processes, 0 for all cores.
+    double m_ciTarget{0};                               //!< Relative CI half-width, 0 = off.
+    std::string m_resultCache;                          //!< Result cache directory.
+    double m_ciConfidence{0.95};                        //!< CI confidence level.
+    uint32_t m_minRuns{5};                              //!< Minimum replications.
+    uint32_t m_maxRuns{30};                             //!< Maximum replications.
 };
 
 RoutingExperiment::RoutingExperiment()
@@ -167,7 +352,25 @@ RoutingExperiment::ReceivePacket(Ptr<Socket> socket)
     {
         bytesTotal += packet->GetSize();
         packetsReceived += 1;
-        NS_LOG_UNCOND(PrintReceivedPacket(socket, packet, senderAddress));
+        m_kpis.Receive(packet);
+        if (m_flowStats)
+        {
+            Address local;
+            socket->GetSockName(local);
+            m_flows.Receive(packet, senderAddress, local);
+        }
+        uint32_t source = 0;
+        if (InetSocketAddress::IsMatchingType(senderAddress))
+        {
+            source = InetSocketAddress::ConvertFrom(senderAddress).GetIpv4().Get();
+        }
+        if (m_rxStats.Record(socket->GetNode()->GetId(),
+                             source,
+                             packet->GetSize(),
+                             Simulator::Now().GetSeconds()))
+        {
+            NS_LOG_UNCOND(PrintReceivedPacket(socket, packet, senderAddress));
+        }
     }
 }
 
@@ -177,12 +380,18 @@ RoutingExperiment::CheckThroughput()
     double kbs = (bytesTotal * 8.0) / 1000;
     bytesTotal = 0;
 
-    std::ofstream out(m_CSVfileName, std::ios::app);
-
-    out << (Simulator::Now()).GetSeconds() << "," << kbs << "," << packetsReceived << ","
-        << m_nSinks << "," << m_protocolName << "," << m_txp << "" << std::endl;
+    m_recorder.Record((Simulator::Now()).GetSeconds() - m_timeOrigin, kbs, packetsReceived);
+    // every source has started a second after the traffic start
+    double now = Simulator::Now().GetSeconds();
+    if (m_detectWarmup && m_trafficStart >= 0 && now >= m_trafficStart + 1.0)
+    {
+        m_transient.Add(now, kbs);
+        if (m_stopWhenSteady > 0 && m_transient.GetSteadyBatches() >= m_stopWhenSteady)
+        {
+            Simulator::Stop();
+        }
+    }
 
-    out.close();
     packetsReceived = 0;
     Simulator::Schedule(Seconds(1.0), &RoutingExperiment::CheckThroughput, this);
 }
@@ -195,61 +404,653 @@ RoutingExperiment::SetupPacketReceive(Ipv4Address addr, Ptr<Node> node)
     InetSocketAddress local = InetSocketAddress(addr, port);
     sink->Bind(local);
     sink->SetRecvCallback(MakeCallback(&RoutingExperiment::ReceivePacket, this));
+    m_rxStats.AddSink(node->GetId());
 
     return sink;
 }
 
+/**
+ * \param protocol A routing protocol name.
+ * \return whether the experiment can run it.
+ */
+static bool
+IsKnownProtocol(const std::string& protocol)
+{
+    static const std::vector<std::string> allowedProtocols{"OLSR", "AODV", "DSDV", "DSR"};
+    return std::find(allowedProtocols.begin(), allowedProtocols.end(), protocol) !=
+           allowedProtocols.end();
+}
+
 void
 RoutingExperiment::CommandSetup(int argc, char** argv)
 {
     CommandLine cmd(__FILE__);
     cmd.AddValue("CSVfileName", "The name of the CSV output file name", m_CSVfileName);
     cmd.AddValue("traceMobility", "Enable mobility tracing", m_traceMobility);
+    cmd.AddValue("trajectoryFile",
+                 "Replay the trajectories of this trajectory-gen file instead of RandomWaypoint "
+                 "({run} stands for the RngRun)",
+                 m_trajectoryFile);
     cmd.AddValue("protocol", "Routing protocol (OLSR, AODV, DSDV, DSR)", m_protocolName);
     cmd.AddValue("flowMonitor", "enable FlowMonitor", m_flowMonitor);
+    cmd.AddValue("flowStats", "Write per-flow statistics (any protocol)", m_flowStats);
+    cmd.AddValue("txp", "Transmission power in dBm", m_txp);
+    cmd.AddValue("nWifis", "Number of nodes", m_nWifis);
+    cmd.AddValue("nodeSpeed", "Maximum node speed in m/s", m_nodeSpeed);
+    cmd.AddValue("sweep", "Run the parameter sweep driver", m_sweep);
+    cmd.AddValue("sweepProtocols", "Comma separated protocols to sweep", m_sweepProtocols);
+    cmd.AddValue("sweepTxp", "Comma separated Tx powers to sweep", m_sweepTxp);
+    cmd.AddValue("sweepNodes", "Comma separated node counts to sweep", m_sweepNodes);
+    cmd.AddValue("sweepSpeeds", "Comma separated node speeds to sweep", m_sweepSpeeds);
+    cmd.AddValue("sweepRuns", "Replications (RngRun values) per grid point", m_sweepRuns);
+    cmd.AddValue("firstRun", "RngRun of the first replication", m_firstRun);
+    cmd.AddValue("jobs", "Concurrent worker processes (0 = one per core)", m_jobs);
+    cmd.AddValue("ciTarget",
+                 "Replicate until the KPI confidence half-widths are below this fraction "
+                 "of their means (0 = fixed runs)",
+                 m_ciTarget);
+    cmd.AddValue("resultCache",
+                 "Reuse the results of earlier sweep and replication runs stored here",
+                 m_resultCache);
+    cmd.AddValue("ciConfidence", "Confidence level of the KPI intervals", m_ciConfidence);
+    cmd.AddValue("minRuns", "Minimum replications with --ciTarget", m_minRuns);
+    cmd.AddValue("maxRuns", "Maximum replications with --ciTarget", m_maxRuns);
+    cmd.AddValue("outputFormat", "Throughput output format (csv, binary)", m_outputFormat);
+    cmd.AddValue("flushRows", "Write throughput samples every N rows (0 = at end)", m_flushRows);
+    cmd.AddValue("logPackets", "Print received packets to stdout", m_logPackets);
+    cmd.AddValue("logSampleEvery", "Print one received packet out of N", m_logSampleEvery);
+    cmd.AddValue("scheduler", "Event scheduler: " + SchedulerSelection::GetNames(), m_scheduler);
+    cmd.AddValue("warmStart",
+                 "Accelerate OLSR/DSDV convergence and start the traffic once converged",
+                 m_warmStart);
+    cmd.AddValue("warmStartCoverage",
+                 "Fraction of connected node pairs that must have a route",
+                 m_warmStartCoverage);
+    cmd.AddValue("mobilityWarmup",
+                 "Seconds of motion before a warm start may start measuring (at most 100)",
+                 m_mobilityWarmup);
+    cmd.AddValue("snapshotVariants",
+                 "Warm up once and fork these ';' separated traffic variants",
+                 m_snapshotVariants);
+    cmd.AddValue("schedulerStats", "Track and report the peak event queue size", m_schedulerStats);
+    cmd.AddValue("detectWarmup",
+                 "Detect the end of the start-up transient of the receive rate",
+                 m_detectWarmup);
+    cmd.AddValue("stopWhenSteady",
+                 "Stop once this many steady-state batches exist (0 = full run)",
+                 m_stopWhenSteady);
     cmd.Parse(argc, argv);
 
-    std::vector<std::string> allowedProtocols{"OLSR", "AODV", "DSDV", "DSR"};
+    if (m_stopWhenSteady > 0)
+    {
+        m_detectWarmup = true;
+    }
 
-    if (std::find(std::begin(allowedProtocols), std::end(allowedProtocols), m_protocolName) ==
-        std::end(allowedProtocols))
+    if (m_logSampleEvery == 0)
+    {
+        NS_FATAL_ERROR("logSampleEvery must be at least 1");
+    }
+    if (!SchedulerSelection::IsValidName(m_scheduler))
+    {
+        NS_FATAL_ERROR("No such scheduler:" << m_scheduler);
+    }
+
+    ThroughputRecorder::Format format;
+    if (!ThroughputRecorder::ParseFormat(m_outputFormat, format))
+    {
+        NS_FATAL_ERROR("No such output format:" << m_outputFormat);
+    }
+
+    if (!IsKnownProtocol(m_protocolName))
     {
         NS_FATAL_ERROR("No such protocol:" << m_protocolName);
     }
+    if (m_ciConfidence <= 0 || m_ciConfidence >= 1)
+    {
+        NS_FATAL_ERROR("ciConfidence must be in (0, 1)");
+    }
+    if (m_mobilityWarmup < 0 || m_mobilityWarmup > 100)
+    {
+        NS_FATAL_ERROR("mobilityWarmup must be within [0, 100] s");
+    }
+    if (IsReplicated() && !m_snapshotVariants.empty())
+    {
+        NS_FATAL_ERROR("snapshotVariants cannot be replicated");
+    }
+    if (m_sweep && !m_trajectoryFile.empty() && m_sweepSpeeds.find(',') != std::string::npos)
+    {
+        // the file fixes the motion, so every speed would replay the same runs
+        NS_FATAL_ERROR("sweepSpeeds cannot be swept with a trajectoryFile");
+    }
+    if ((IsReplicated() || (m_sweep && m_sweepRuns > 1)) && !m_trajectoryFile.empty() &&
+        m_trajectoryFile.find("{run}") == std::string::npos)
+    {
+        // every run would replay the same motion, and the intervals would
+        // leave out the mobility variance
+        NS_FATAL_ERROR("Replications need one trajectoryFile per run, e.g. rwp-{run}.traj");
+    }
+    if (!m_sweep && m_nWifis < 2 * m_nSinks)
+    {
+        NS_FATAL_ERROR("Need at least " << 2 * m_nSinks << " nodes for " << m_nSinks << " sinks");
+    }
 }
 
-int
-main(int argc, char* argv[])
+bool
+RoutingExperiment::IsSweep() const
 {
-    RoutingExperiment experiment;
-    experiment.CommandSetup(argc, argv);
-    experiment.Run();
+    return m_sweep;
+}
 
-    return 0;
+bool
+RoutingExperiment::IsReplicated() const
+{
+    return m_ciTarget > 0;
 }
 
-void
-RoutingExperiment::Run()
+std::string
+RoutingExperiment::DescribeParameters(uint32_t run) const
 {
-    Packet::EnablePrinting();
+    std::ostringstream os;
+    os << std::setprecision(17) << "protocol=" << m_protocolName << "\n"
+       << "txp=" << m_txp << "\n"
+       << "nWifis=" << m_nWifis << "\n"
+       << "nSinks=" << m_nSinks << "\n"
+       << "nodeSpeed=" << m_nodeSpeed << "\n"
+       << "warmStart=" << m_warmStart << "\n"
+       << "warmStartCoverage=" << m_warmStartCoverage << "\n"
+       << "mobilityWarmup=" << m_mobilityWarmup << "\n"
+       << "detectWarmup=" << m_detectWarmup << "\n"
+       << "stopWhenSteady=" << m_stopWhenSteady << "\n"
+       << "outputFormat=" << m_outputFormat << "\n"
+       << "traceMobility=" << m_traceMobility << "\n"
+       << "flowStats=" << m_flowStats << "\n"
+       << "flowMonitor=" << m_flowMonitor << "\n"
+       << "logPackets=" << m_logPackets << "\n"
+       << "logSampleEvery=" << m_logSampleEvery << "\n"
+       << "run=" << run << "\n";
+    if (!m_trajectoryFile.empty())
+    {
+        // the same name may be regenerated with other trajectories
+        struct stat st;
+        std::string file = GetTrajectoryFile(run);
+        os << "trajectoryFile=" << file;
+        if (stat(file.c_str(), &st) == 0)
+        {
+            os << " " << st.st_size << " " << st.st_mtim.tv_sec << "." << st.st_mtim.tv_nsec;
+        }
+        os << "\n";
+    }
+    return os.str();
+}
+
+std::string
+RoutingExperiment::GetTrajectoryFile(uint32_t run) const
+{
+    std::string file = m_trajectoryFile;
+    std::size_t pos = file.find("{run}");
+    if (pos != std::string::npos)
+    {
+        file.replace(pos, 5, std::to_string(run));
+    }
+    return file;
+}
+
+std::vector<double>
+RoutingExperiment::RunCached(const ResultCache& cache, uint32_t run)
+{
+    // everything a run writes, so that a hit leaves the same files
+    ResultCache::Outputs outputs{{"csv", m_CSVfileName},
+                                 {"rx.csv", m_traceName + ".rx.csv"},
+                                 {"mob", m_traceName + ".mob"}};
+    if (m_flowStats)
+    {
+        outputs.emplace_back("flows.csv", m_traceName + ".flows.csv");
+        outputs.emplace_back("flowhist.csv", m_traceName + ".flowhist.csv");
+    }
+    if (m_flowMonitor)
+    {
+        outputs.emplace_back("flowmon", m_traceName + ".flowmon");
+    }
+    // the variants of a snapshot run write files of their own
+    bool cached = cache.IsEnabled() && m_snapshotVariants.empty();
+    std::string parameters;
+    std::string key;
+    if (cached)
+    {
+        parameters = DescribeParameters(run);
+        key = cache.MakeKey(parameters);
+        std::vector<double> kpis;
+        if (cache.Lookup(key, kpis, outputs))
+        {
+            std::cout << "result cache: " << m_CSVfileName << " from " << key << std::endl;
+            return kpis;
+        }
+    }
+    RngSeedManager::SetRun(run);
+    if (Run() != 0)
+    {
+        // counts as a failed run, and is not cached
+        return {};
+    }
+    if (cached)
+    {
+        cache.Store(key, parameters, m_kpiValues, outputs);
+    }
+    return m_kpiValues;
+}
 
-    // blank out the last output file and write the column headers
+/**
+ * Split a comma separated command-line list.
+ * \param list The list.
+ * \return the non-empty items.
+ */
+static std::vector<std::string>
+SplitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+/**
+ * Parse a number given on the command line.
+ * \tparam T The number type.
+ * \param name The option the number belongs to, for the error message.
+ * \param item The number.
+ * \return the number.
+ */
+template <typename T>
+static T
+ParseNumber(const std::string& name, const std::string& item)
+{
+    std::istringstream iss(item);
+    T value;
+    if (!(iss >> value) || !(iss >> std::ws).eof())
+    {
+        NS_FATAL_ERROR("Bad " << name << " entry: " << item);
+    }
+    return value;
+}
+
+/**
+ * Parse a comma separated command-line list of numbers.
+ * \tparam T The number type.
+ * \param name The option, for the error messages.
+ * \param list The list.
+ * \return the numbers, at least one.
+ */
+template <typename T>
+static std::vector<T>
+ParseNumberList(const std::string& name, const std::string& list)
+{
+    std::vector<T> values;
+    for (const auto& item : SplitList(list))
+    {
+        values.push_back(ParseNumber<T>(name, item));
+    }
+    if (values.empty())
+    {
+        NS_FATAL_ERROR(name << " is empty");
+    }
+    return values;
+}
+
+/**
+ * \param fileName A CSV file name.
+ * \return the name without its .csv extension.
+ */
+static std::string
+CsvBaseName(const std::string& fileName)
+{
+    std::string base = fileName;
+    if (base.size() > 4 && base.compare(base.size() - 4, 4, ".csv") == 0)
+    {
+        base.erase(base.size() - 4);
+    }
+    return base;
+}
+
+/// A traffic variant of a snapshot run.
+struct TrafficVariant
+{
+    std::string name;    //!< Suffix of its output files.
+    std::string rate;    //!< OnOff data rate.
+    uint32_t packetSize; //!< OnOff packet size.
+    int nSinks;          //!< Number of source/sink pairs.
+};
+
+/**
+ * Parse the --snapshotVariants list.
+ * \param list The ';' separated variants of comma separated key=value pairs.
+ * \param rate The default data rate.
+ * \param packetSize The default packet size.
+ * \param nSinks The default number of sinks.
+ * \return the variants.
+ */
+static std::vector<TrafficVariant>
+ParseTrafficVariants(const std::string& list,
+                     const std::string& rate,
+                     uint32_t packetSize,
+                     int nSinks)
+{
+    std::vector<TrafficVariant> variants;
+    std::stringstream ss(list);
+    std::string spec;
+    while (std::getline(ss, spec, ';'))
+    {
+        if (spec.empty())
+        {
+            continue;
+        }
+        TrafficVariant variant{"", rate, packetSize, nSinks};
+        for (const auto& item : SplitList(spec))
+        {
+            std::size_t eq = item.find('=');
+            std::string key = item.substr(0, eq);
+            std::string value = eq == std::string::npos ? "" : item.substr(eq + 1);
+            if (key == "rate" && !value.empty())
+            {
+                variant.rate = value;
+            }
+            else if (key == "size" && !value.empty())
+            {
+                // parsed signed, an unsigned read would wrap a negative size
+                int64_t size = ParseNumber<int64_t>("snapshotVariants", value);
+                // the sources start every packet with a SeqTsSizeHeader
+                if (size < SeqTsSizeHeader().GetSerializedSize() || size > UINT32_MAX)
+                {
+                    NS_FATAL_ERROR("Traffic variant packet size out of range: " << item);
+                }
+                variant.packetSize = static_cast<uint32_t>(size);
+            }
+            else if (key == "sinks" && !value.empty())
+            {
+                variant.nSinks = ParseNumber<int>("snapshotVariants", value);
+                if (variant.nSinks < 1)
+                {
+                    NS_FATAL_ERROR("Traffic variant needs at least one sink: " << item);
+                }
+            }
+            else
+            {
+                NS_FATAL_ERROR("Bad traffic variant item: " << item);
+            }
+        }
+        std::ostringstream name;
+        name << "rate" << variant.rate << "-size" << variant.packetSize << "-sinks"
+             << variant.nSinks;
+        variant.name = name.str();
+        variants.push_back(variant);
+    }
+    return variants;
+}
+
+int
+RoutingExperiment::RunSweep()
+{
+    /// One point of the sweep grid.
+    struct SweepPoint
+    {
+        std::string protocol; //!< Routing protocol.
+        double txp;           //!< Tx power.
+        int nWifis;           //!< Number of nodes.
+        int nodeSpeed;        //!< Maximum node speed.
+        uint32_t run;         //!< RngRun.
+        std::string csv;      //!< Per-run CSV file.
+    };
+
+    std::string base = CsvBaseName(m_CSVfileName);
+
+    // check every entry before the first run starts
+    std::vector<std::string> protocols = SplitList(m_sweepProtocols);
+    if (protocols.empty())
+    {
+        NS_FATAL_ERROR("sweepProtocols is empty");
+    }
+    for (const auto& protocol : protocols)
+    {
+        if (!IsKnownProtocol(protocol))
+        {
+            NS_FATAL_ERROR("No such protocol in sweepProtocols:" << protocol);
+        }
+    }
+    std::vector<double> txps = ParseNumberList<double>("sweepTxp", m_sweepTxp);
+    std::vector<int> nodeCounts = ParseNumberList<int>("sweepNodes", m_sweepNodes);
+    for (int nodes : nodeCounts)
+    {
+        if (nodes < 2 * m_nSinks)
+        {
+            NS_FATAL_ERROR("Need at least " << 2 * m_nSinks << " nodes, got " << nodes);
+        }
+    }
+    std::vector<int> speeds = ParseNumberList<int>("sweepSpeeds", m_sweepSpeeds);
+    for (int speed : speeds)
+    {
+        if (speed < 0)
+        {
+            NS_FATAL_ERROR("Bad sweepSpeeds entry: " << speed);
+        }
+    }
+
+    // the grid without the run dimension; csv is the per-run file prefix
+    std::vector<SweepPoint> configs;
+    for (const auto& protocol : protocols)
+    {
+        for (double txp : txps)
+        {
+            for (int nodes : nodeCounts)
+            {
+                for (int speed : speeds)
+                {
+                    SweepPoint point{protocol, txp, nodes, speed, 0, ""};
+                    std::ostringstream oss;
+                    oss << "-" << protocol << "-txp" << txp << "-n" << nodes << "-s" << speed;
+                    point.csv = base + oss.str();
+                    configs.push_back(point);
+                }
+            }
+        }
+    }
+    auto withRun = [](SweepPoint point, uint32_t run) {
+        point.run = run;
+        point.csv += "-run" + std::to_string(run) + ".csv";
+        return point;
+    };
+
+    ResultCache cache(m_resultCache);
+    if (cache.IsEnabled())
+    {
+        // hash the attribute defaults and the build once, for every worker
+        cache.MakeKey("");
+    }
+
+    // runs in the worker process
+    auto runPoint = [this, &cache](const SweepPoint& point) {
+        RoutingExperiment experiment = *this;
+        experiment.m_sweep = false;
+        experiment.m_protocolName = point.protocol;
+        experiment.m_txp = point.txp;
+        experiment.m_nWifis = point.nWifis;
+        experiment.m_nodeSpeed = point.nodeSpeed;
+        experiment.m_CSVfileName = point.csv;
+        experiment.m_traceName = point.csv.substr(0, point.csv.size() - 4);
+        // the merge step below reads the per-run files back as text
+        experiment.m_outputFormat = "csv";
+        // the sweep already keeps every worker busy
+        experiment.m_jobs = 1;
+        return experiment.RunCached(cache, point.run);
+    };
+
+    std::vector<SweepPoint> grid;
+    std::vector<int> status;
+    if (IsReplicated())
+    {
+        // each configuration gets as many runs as its intervals need
+        ReplicationController replications(KpiProbe::GetKpiNames(),
+                                           m_ciTarget,
+                                           m_ciConfidence,
+                                           m_minRuns,
+                                           m_maxRuns,
+                                           m_jobs);
+        for (const auto& config : configs)
+        {
+            ReplicationController::Summary summary =
+                replications.Run(m_firstRun, [&](uint32_t run) {
+                    return runPoint(withRun(config, run));
+                });
+            replications.PrintSummary(std::cout, config.csv.substr(base.size() + 1), summary);
+            std::sort(summary.runs.begin(), summary.runs.end());
+            for (uint32_t run : summary.runs)
+            {
+                grid.push_back(withRun(config, run));
+                status.push_back(0);
+            }
+            for (uint32_t run : summary.failedRuns)
+            {
+                grid.push_back(withRun(config, run));
+                status.push_back(1);
+            }
+        }
+    }
+    else
+    {
+        for (const auto& config : configs)
+        {
+            for (uint32_t run = m_firstRun; run < m_firstRun + m_sweepRuns; run++)
+            {
+                grid.push_back(withRun(config, run));
+            }
+        }
+        status.assign(grid.size(), -1);
+        ForkPool pool(m_jobs, [&](std::size_t id, int exitStatus) {
+            status[id] = exitStatus;
+            std::cout << "sweep: run " << id + 1 << "/" << grid.size() << " (" << grid[id].csv
+                      << ") finished with status " << exitStatus << std::endl;
+        });
+        std::cout << "sweep: " << grid.size() << " runs on " << pool.GetMaxWorkers()
+                  << " workers" << std::endl;
+
+        for (const auto& point : grid)
+        {
+            pool.Start([&runPoint, point]() { return runPoint(point).empty() ? 1 : 0; });
+        }
+        pool.WaitAll();
+    }
+
+    // merge into one tidy table, one row per (run, second)
     std::ofstream out(m_CSVfileName);
     out << "SimulationSecond,"
         << "ReceiveRate,"
         << "PacketsReceived,"
         << "NumberOfSinks,"
         << "RoutingProtocol,"
-        << "TransmissionPower" << std::endl;
+        << "TransmissionPower,"
+        << "NumberOfNodes,"
+        << "NodeSpeed,"
+        << "RngRun" << std::endl;
+
+    int failed = 0;
+    for (std::size_t i = 0; i < grid.size(); i++)
+    {
+        if (status[i] != 0)
+        {
+            failed++;
+            continue;
+        }
+        std::ifstream in(grid[i].csv);
+        std::string line;
+        std::getline(in, line); // header
+        while (std::getline(in, line))
+        {
+            out << line << "," << grid[i].nWifis << "," << grid[i].nodeSpeed << "," << grid[i].run
+                << "\n";
+        }
+        in.close();
+        std::remove(grid[i].csv.c_str());
+    }
     out.close();
 
-    int nWifis = 50;
+    std::cout << "sweep: merged " << grid.size() - failed << " runs into " << m_CSVfileName;
+    if (failed)
+    {
+        std::cout << ", " << failed << " failed (per-run files kept)";
+    }
+    std::cout << std::endl;
+    return failed ? 1 : 0;
+}
+
+int
+RoutingExperiment::RunReplications()
+{
+    std::string base = CsvBaseName(m_CSVfileName);
+    ResultCache cache(m_resultCache);
+    if (cache.IsEnabled())
+    {
+        cache.MakeKey("");
+    }
+    ReplicationController replications(KpiProbe::GetKpiNames(),
+                                       m_ciTarget,
+                                       m_ciConfidence,
+                                       m_minRuns,
+                                       m_maxRuns,
+                                       m_jobs);
+    ReplicationController::Summary summary = replications.Run(m_firstRun, [&](uint32_t run) {
+        // runs in the worker process
+        RoutingExperiment experiment = *this;
+        experiment.m_ciTarget = 0;
+        experiment.m_CSVfileName = base + "-run" + std::to_string(run) + ".csv";
+        experiment.m_traceName = m_traceName + "-run" + std::to_string(run);
+        return experiment.RunCached(cache, run);
+    });
+    std::ostringstream label;
+    label << m_protocolName << "-txp" << m_txp << "-n" << m_nWifis << "-s" << m_nodeSpeed;
+    replications.PrintSummary(std::cout, label.str(), summary);
+    return summary.failedRuns.empty() ? 0 : 1;
+}
+
+int
+main(int argc, char* argv[])
+{
+    RoutingExperiment experiment;
+    experiment.CommandSetup(argc, argv);
+    if (experiment.IsSweep())
+    {
+        return experiment.RunSweep();
+    }
+    if (experiment.IsReplicated())
+    {
+        return experiment.RunReplications();
+    }
+    return experiment.Run();
+}
+
+int
+RoutingExperiment::Run()
+{
+    Packet::EnablePrinting();
+    SchedulerSelection scheduler(m_scheduler, m_schedulerStats);
+
+    int nWifis = m_nWifis;
 
     double TotalTime = 200.0;
+
+    ThroughputRecorder::Format format;
+    ThroughputRecorder::ParseFormat(m_outputFormat, format);
+    m_recorder.SetRunInfo(m_nSinks, m_protocolName, m_txp);
+    m_recorder.Open(m_CSVfileName, format, static_cast<std::size_t>(TotalTime) + 1, m_flushRows);
+    m_rxStats.SetLogSampling(m_logPackets ? m_logSampleEvery : 0);
     std::string rate("2048bps");
     std::string phyMode("DsssRate11Mbps");
-    std::string tr_name("manet-routing-compare");
-    int nodeSpeed = 20; // in m/s
+    std::string tr_name(m_traceName);
+    int nodeSpeed = m_nodeSpeed; // in m/s
     int nodePause = 0;  // in s
 
     Config::SetDefault("ns3::OnOffApplication::PacketSize", StringValue("64"));
@@ -286,30 +1087,50 @@ RoutingExperiment::Run()
     NetDeviceContainer adhocDevices = wifi.Install(wifiPhy, wifiMac, adhocNodes);
 
     MobilityHelper mobilityAdhoc;
-    int64_t streamIndex = 0; // used to get consistent mobility across scenarios
-
-    ObjectFactory pos;
-    pos.SetTypeId("ns3::RandomRectanglePositionAllocator");
-    pos.Set("X", StringValue("ns3::UniformRandomVariable[Min=0.0|Max=300.0]"));
-    pos.Set("Y", StringValue("ns3::UniformRandomVariable[Min=0.0|Max=1500.0]"));
-
-    Ptr<PositionAllocator> taPositionAlloc = pos.Create()->GetObject<PositionAllocator>();
-    streamIndex += taPositionAlloc->AssignStreams(streamIndex);
-
-    std::stringstream ssSpeed;
-    ssSpeed << "ns3::UniformRandomVariable[Min=0.0|Max=" << nodeSpeed << "]";
-    std::stringstream ssPause;
-    ssPause << "ns3::ConstantRandomVariable[Constant=" << nodePause << "]";
-    mobilityAdhoc.SetMobilityModel("ns3::RandomWaypointMobilityModel",
-                                   "Speed",
-                                   StringValue(ssSpeed.str()),
-                                   "Pause",
-                                   StringValue(ssPause.str()),
-                                   "PositionAllocator",
-                                   PointerValue(taPositionAlloc));
-    mobilityAdhoc.SetPositionAllocator(taPositionAlloc);
-    mobilityAdhoc.Install(adhocNodes);
-    streamIndex += mobilityAdhoc.AssignStreams(adhocNodes, streamIndex);
+    // seconds of motion that happened before the simulation started
+    double motionAge = 0;
+    if (!m_trajectoryFile.empty())
+    {
+        // precomputed motion, the same for every protocol of a sweep; a
+        // warm start replays it from mobilityWarmup on, so that it can
+        // measure as soon as the routing has converged
+        motionAge = m_warmStart ? m_mobilityWarmup : 0;
+        mobilityAdhoc.SetMobilityModel("ns3::MmapTrajectoryMobilityModel",
+                                       "TrajectoryFile",
+                                       StringValue(GetTrajectoryFile(RngSeedManager::GetRun())),
+                                       "NotifyCourseChanges",
+                                       BooleanValue(m_traceMobility),
+                                       "TimeOffset",
+                                       DoubleValue(motionAge));
+        mobilityAdhoc.Install(adhocNodes);
+    }
+    else
+    {
+        int64_t streamIndex = 0; // used to get consistent mobility across scenarios
+
+        ObjectFactory pos;
+        pos.SetTypeId("ns3::RandomRectanglePositionAllocator");
+        pos.Set("X", StringValue("ns3::UniformRandomVariable[Min=0.0|Max=300.0]"));
+        pos.Set("Y", StringValue("ns3::UniformRandomVariable[Min=0.0|Max=1500.0]"));
+
+        Ptr<PositionAllocator> taPositionAlloc = pos.Create()->GetObject<PositionAllocator>();
+        streamIndex += taPositionAlloc->AssignStreams(streamIndex);
+
+        std::stringstream ssSpeed;
+        ssSpeed << "ns3::UniformRandomVariable[Min=0.0|Max=" << nodeSpeed << "]";
+        std::stringstream ssPause;
+        ssPause << "ns3::ConstantRandomVariable[Constant=" << nodePause << "]";
+        mobilityAdhoc.SetMobilityModel("ns3::RandomWaypointMobilityModel",
+                                       "Speed",
+                                       StringValue(ssSpeed.str()),
+                                       "Pause",
+                                       StringValue(ssPause.str()),
+                                       "PositionAllocator",
+                                       PointerValue(taPositionAlloc));
+        mobilityAdhoc.SetPositionAllocator(taPositionAlloc);
+        mobilityAdhoc.Install(adhocNodes);
+        streamIndex += mobilityAdhoc.AssignStreams(adhocNodes, streamIndex);
+    }
 
     AodvHelper aodv;
     OlsrHelper olsr;
@@ -343,7 +1164,8 @@ RoutingExperiment::Run()
         dsrMain.Install(dsr, adhocNodes);
         if (m_flowMonitor)
         {
-            NS_FATAL_ERROR("Error: FlowMonitor does not work with DSR. Terminating.");
+            NS_FATAL_ERROR("Error: FlowMonitor does not work with DSR, use --flowStats. "
+                           "Terminating.");
         }
     }
     else
@@ -362,17 +1184,77 @@ RoutingExperiment::Run()
     onoff1.SetAttribute("OnTime", StringValue("ns3::ConstantRandomVariable[Constant=1.0]"));
     onoff1.SetAttribute("OffTime", StringValue("ns3::ConstantRandomVariable[Constant=0.0]"));
 
-    for (int i = 0; i < m_nSinks; i++)
+    std::vector<TrafficVariant> variants =
+        ParseTrafficVariants(m_snapshotVariants, rate, 64, m_nSinks);
+    for (const auto& variant : variants)
     {
-        Ptr<Socket> sink = SetupPacketReceive(adhocInterfaces.GetAddress(i), adhocNodes.Get(i));
+        if (variant.nSinks < 1 || nWifis < 2 * variant.nSinks)
+        {
+            NS_FATAL_ERROR("Cannot fit " << variant.nSinks << " sinks in " << nWifis << " nodes");
+        }
+    }
+    bool snapshot = !variants.empty();
 
-        AddressValue remoteAddress(InetSocketAddress(adhocInterfaces.GetAddress(i), port));
-        onoff1.SetAttribute("Remote", remoteAddress);
+    // the measured traffic of nSinks pairs, starting within a second of
+    // start (seconds from now) and lasting until stop
+    double measureTime = 100.0;
+    auto startTraffic = [&](double start, double stop, int nSinks) {
+        m_trafficStart = Simulator::Now().GetSeconds() + start;
+        for (int i = 0; i < nSinks; i++)
+        {
+            SetupPacketReceive(adhocInterfaces.GetAddress(i), adhocNodes.Get(i));
 
-        Ptr<UniformRandomVariable> var = CreateObject<UniformRandomVariable>();
-        ApplicationContainer temp = onoff1.Install(adhocNodes.Get(i + m_nSinks));
-        temp.Start(Seconds(var->GetValue(100.0, 101.0)));
-        temp.Stop(Seconds(TotalTime));
+            AddressValue remoteAddress(InetSocketAddress(adhocInterfaces.GetAddress(i), port));
+            onoff1.SetAttribute("Remote", remoteAddress);
+
+            Ptr<UniformRandomVariable> var = CreateObject<UniformRandomVariable>();
+            ApplicationContainer temp = onoff1.Install(adhocNodes.Get(i + nSinks));
+            temp.Start(Seconds(var->GetValue(start, start + 1.0)));
+            temp.Stop(Seconds(stop));
+            m_kpis.AddSources(temp);
+            if (m_flowStats)
+            {
+                m_flows.AddSources(temp);
+            }
+        }
+    };
+    RoutingWarmStart warmStart(adhocNodes, m_protocolName, m_txp);
+    auto printCoverage = [&]() {
+        if (RoutingWarmStart::IsProactive(m_protocolName))
+        {
+            NS_LOG_UNCOND("Routing coverage at " << Simulator::Now().GetSeconds()
+                                                 << " s: " << warmStart.GetCoverage());
+        }
+    };
+    if (m_warmStart)
+    {
+        warmStart.Start(m_warmStartCoverage, Seconds(TotalTime - measureTime), [&]() {
+            // converged routing does not make the node placement stationary
+            double hold =
+                std::max(0.0, m_mobilityWarmup - motionAge - Simulator::Now().GetSeconds());
+            Simulator::Schedule(Seconds(hold), printCoverage);
+            if (snapshot)
+            {
+                // the variants branch off here
+                Simulator::Stop(Seconds(hold));
+                return;
+            }
+            startTraffic(hold, hold + measureTime, m_nSinks);
+            Simulator::Stop(Seconds(hold + measureTime));
+        });
+    }
+    else
+    {
+        // before the snapshot stop, so that the variants do not print it again
+        Simulator::Schedule(Seconds(TotalTime - measureTime), printCoverage);
+        if (snapshot)
+        {
+            Simulator::Stop(Seconds(TotalTime - measureTime));
+        }
+        else
+        {
+            startTraffic(TotalTime - measureTime, TotalTime, m_nSinks);
+        }
     }
 
     std::stringstream ss;
@@ -398,8 +1280,10 @@ RoutingExperiment::Run()
     // AsciiTraceHelper ascii;
     // Ptr<OutputStreamWrapper> osw = ascii.CreateFileStream(tr_name + ".tr");
     // wifiPhy.EnableAsciiAll(osw);
-    AsciiTraceHelper ascii;
-    MobilityHelper::EnableAsciiAll(ascii.CreateFileStream(tr_name + ".mob"));
+    AsyncOstream mobilityTrace(tr_name + ".mob");
+    // the variants of a snapshot run point this at their own file
+    std::ostream mobilityStream(mobilityTrace.rdbuf());
+    MobilityHelper::EnableAsciiAll(Create<OutputStreamWrapper>(&mobilityStream));
 
     FlowMonitorHelper flowmonHelper;
     Ptr<FlowMonitor> flowmon;
@@ -413,12 +1297,95 @@ RoutingExperiment::Run()
     CheckThroughput();
 
     Simulator::Stop(Seconds(TotalTime));
+    scheduler.Start();
     Simulator::Run();
+    scheduler.Stop();
+    scheduler.PrintReport(std::clog);
 
-    if (m_flowMonitor)
+    auto finish = [&](const std::string& name, AsyncOstream& mobility) {
+        // shorter than measureTime if the run stopped once steady
+        double trafficTime =
+            m_trafficStart < 0 ? 0 : Simulator::Now().GetSeconds() - m_trafficStart;
+        m_kpiValues = m_kpis.GetKpis(Seconds(trafficTime));
+        if (m_detectWarmup)
+        {
+            m_transient.PrintReport(std::cout);
+            m_kpiValues[0] = m_transient.GetTruncatedMean();
+        }
+        m_recorder.Close();
+        m_rxStats.WriteCsv(name + ".rx.csv");
+        mobility.Close();
+        mobility.GetWriter().PrintStats(std::clog, name + ".mob");
+
+        if (m_flowMonitor)
+        {
+            flowmon->SerializeToXmlFile(name + ".flowmon", false, false);
+        }
+        if (m_flowStats)
+        {
+            m_flows.WriteCsv(name + ".flows.csv");
+            m_flows.WriteHistogramCsv(name + ".flowhist.csv");
+            std::cout << "flow-stats flows=" << m_flows.GetNFlows()
+                      << " packets=" << m_flows.GetNPackets() << std::endl;
+        }
+    };
+    // closing the shared mobility trace also stops its writer thread, which
+    // must not be alive when the variants are forked
+    finish(tr_name, mobilityTrace);
+
+    if (snapshot)
     {
-        flowmon->SerializeToXmlFile(tr_name + ".flowmon", false, false);
+        std::string csvBase = CsvBaseName(m_CSVfileName);
+        std::cout << "snapshot: forking " << variants.size() << " variants at "
+                  << Simulator::Now().GetSeconds() << " s" << std::endl;
+        int failed = 0;
+        ForkPool pool(m_jobs, [&](std::size_t id, int exitStatus) {
+            std::cout << "snapshot: variant " << variants[id].name << " finished with status "
+                      << exitStatus << std::endl;
+            failed += exitStatus != 0;
+        });
+        for (const auto& variant : variants)
+        {
+            pool.Start([&, variant]() {
+                std::string name = tr_name + "-" + variant.name;
+                AsyncOstream variantMobility(name + ".mob");
+                mobilityStream.rdbuf(variantMobility.rdbuf());
+                m_recorder.SetRunInfo(variant.nSinks, m_protocolName, m_txp);
+                m_recorder.Open(csvBase + "-" + variant.name + ".csv",
+                                format,
+                                static_cast<std::size_t>(measureTime) + 1,
+                                m_flushRows);
+                m_rxStats = ReceiveStats();
+                m_rxStats.SetLogSampling(m_logPackets ? m_logSampleEvery : 0);
+                // the variant's samples and flows start at the branch point
+                m_timeOrigin = Simulator::Now().GetSeconds();
+                if (m_flowMonitor)
+                {
+                    flowmon->ResetAllStats();
+                }
+                onoff1.SetAttribute("DataRate", StringValue(variant.rate));
+                onoff1.SetAttribute("PacketSize", UintegerValue(variant.packetSize));
+                startTraffic(0.0, measureTime, variant.nSinks);
+
+                Simulator::Stop(Seconds(measureTime));
+                scheduler.Start();
+                Simulator::Run();
+                scheduler.Stop();
+                scheduler.PrintReport(std::clog);
+                finish(name, variantMobility);
+                return 0;
+            });
+        }
+        pool.WaitAll();
+        if (failed)
+        {
+            std::cout << "snapshot: " << failed << " of " << variants.size()
+                      << " variants failed" << std::endl;
+            Simulator::Destroy();
+            return 1;
+        }
     }
 
     Simulator::Destroy();
+    return 0;
 }
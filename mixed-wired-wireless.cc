@@ -61,7 +61,6 @@
 #include "ns3/command-line.h"
 #include "ns3/csma-helper.h"
 #include "ns3/internet-stack-helper.h"
-#include "ns3/ipv4-address-helper.h"
 #include "ns3/mobility-helper.h"
 #include "ns3/olsr-helper.h"
 #include "ns3/on-off-helper.h"
@@ -72,6 +71,15 @@
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
 
+#include "address-plan.h"
+#include "anim-flow-aggregator.h"
+#include "async-trace-writer.h"
+#include "cached-propagation.h"
+#include "hanet-topology-builder.h"
+#include "scheduler-selection.h"
+
+#include <memory>
+
 using namespace ns3;
 
 //
@@ -83,15 +91,16 @@ NS_LOG_COMPONENT_DEFINE("MixedWireless");
  * This function will be used below as a trace sink, if the command-line
  * argument or default value "useCourseChangeCallback" is set to true
  *
+ * \param os The output stream.
  * \param path The callback path.
  * \param model The mobility model.
  */
 static void
-CourseChangeCallback(std::string path, Ptr<const MobilityModel> model)
+CourseChangeCallback(std::ostream* os, std::string path, Ptr<const MobilityModel> model)
 {
     Vector position = model->GetPosition();
-    std::cout << "CourseChange " << path << " x=" << position.x << ", y=" << position.y
-              << ", z=" << position.z << std::endl;
+    *os << "CourseChange " << path << " x=" << position.x << ", y=" << position.y
+        << ", z=" << position.z << "\n";
 }
 
 int
@@ -106,6 +115,12 @@ main(int argc, char* argv[])
     uint32_t lanNodes = 2;
     uint32_t stopTime = 20;
     bool useCourseChangeCallback = false;
+    std::string animMode = "full";
+    double animInterval = 1.0;
+    bool cachePropagation = true;
+    std::string schedulerName = "Map";
+    bool schedulerStats = false;
+    bool ipv6 = false;
 
     //
     // Simulation defaults are typically set next, before command line
@@ -127,6 +142,16 @@ main(int argc, char* argv[])
     cmd.AddValue("useCourseChangeCallback",
                  "whether to enable course change tracing",
                  useCourseChangeCallback);
+    cmd.AddValue("animMode", "NetAnim output: full, decimated or off", animMode);
+    cmd.AddValue("animInterval",
+                 "position and flow sampling interval of the decimated animation (seconds)",
+                 animInterval);
+    cmd.AddValue("cachePropagation",
+                 "Memoize the propagation loss and delay of node pairs at rest",
+                 cachePropagation);
+    cmd.AddValue("scheduler", "event scheduler: " + SchedulerSelection::GetNames(), schedulerName);
+    cmd.AddValue("schedulerStats", "track and report the peak event queue size", schedulerStats);
+    cmd.AddValue("ipv6", "also give every link an IPv6 /64", ipv6);
 
     //
     // The system global variables and the local values added to the argument
@@ -139,6 +164,11 @@ main(int argc, char* argv[])
         std::cout << "Use a simulation stop time >= 10 seconds" << std::endl;
         exit(1);
     }
+    if (!AnimOutput::IsValidMode(animMode))
+    {
+        NS_FATAL_ERROR("Unknown animation mode " << animMode);
+    }
+    SchedulerSelection scheduler(schedulerName, schedulerStats);
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
     // Construct the backbone                                                //
@@ -163,7 +193,8 @@ main(int argc, char* argv[])
                                  StringValue("OfdmRate54Mbps"));
     YansWifiPhyHelper wifiPhy;
     wifiPhy.SetPcapDataLinkType(WifiPhyHelper::DLT_IEEE802_11_RADIO);
-    YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default();
+    YansWifiChannelHelper wifiChannel =
+        cachePropagation ? CachedYansWifiChannelHelper() : YansWifiChannelHelper::Default();
     wifiPhy.SetChannel(wifiChannel.Create());
     NetDeviceContainer backboneDevices = wifi.Install(wifiPhy, mac, backbone);
 
@@ -180,11 +211,19 @@ main(int argc, char* argv[])
 
     //
     // Assign IPv4 addresses to the device drivers (actually to the associated
-    // IPv4 interfaces) we just created.
+    // IPv4 interfaces) we just created.  Every link gets a prefix of its
+    // own, sized to it, out of the block of its kind; see AddressPlan.
     //
-    Ipv4AddressHelper ipAddrs;
-    ipAddrs.SetBase("192.168.0.0", "255.255.255.0");
-    ipAddrs.Assign(backboneDevices);
+    AddressPlan backboneAddrs(Ipv4Address("192.168.0.0"), 16);
+    AddressPlan lanAddrs(Ipv4Address("172.16.0.0"), 12);
+    AddressPlan infraAddrs(Ipv4Address("10.0.0.0"), 8);
+    if (ipv6)
+    {
+        backboneAddrs.EnableIpv6(Ipv6Address("2001:db8::"));
+        lanAddrs.EnableIpv6(Ipv6Address("2001:db8:1::"));
+        infraAddrs.EnableIpv6(Ipv6Address("2001:db8:2::"));
+    }
+    backboneAddrs.Assign(backboneDevices);
 
     //
     // The ad-hoc network nodes need a mobility model so we aggregate one to
@@ -215,140 +254,24 @@ main(int argc, char* argv[])
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
-    // Construct the LANs                                                    //
-    //                                                                       //
-    ///////////////////////////////////////////////////////////////////////////
-
-    // Reset the address base-- all of the CSMA networks will be in
-    // the "172.16 address space
-    ipAddrs.SetBase("172.16.0.0", "255.255.255.0");
-
-    for (uint32_t i = 0; i < backboneNodes; ++i)
-    {
-        NS_LOG_INFO("Configuring local area network for backbone node " << i);
-        //
-        // Create a container to manage the nodes of the LAN.  We need
-        // two containers here; one with all of the new nodes, and one
-        // with all of the nodes including new and existing nodes
-        //
-        NodeContainer newLanNodes;
-        newLanNodes.Create(lanNodes - 1);
-        // Now, create the container with all nodes on this link
-        NodeContainer lan(backbone.Get(i), newLanNodes);
-        //
-        // Create the CSMA net devices and install them into the nodes in our
-        // collection.
-        //
-        CsmaHelper csma;
-        csma.SetChannelAttribute("DataRate", DataRateValue(DataRate(5000000)));
-        csma.SetChannelAttribute("Delay", TimeValue(MilliSeconds(2)));
-        NetDeviceContainer lanDevices = csma.Install(lan);
-        //
-        // Add the IPv4 protocol stack to the new LAN nodes
-        //
-        internet.Install(newLanNodes);
-        //
-        // Assign IPv4 addresses to the device drivers (actually to the
-        // associated IPv4 interfaces) we just created.
-        //
-        ipAddrs.Assign(lanDevices);
-        //
-        // Assign a new network prefix for the next LAN, according to the
-        // network mask initialized above
-        //
-        ipAddrs.NewNetwork();
-        //
-        // The new LAN nodes need a mobility model so we aggregate one
-        // to each of the nodes we just finished building.
-        //
-        MobilityHelper mobilityLan;
-        Ptr<ListPositionAllocator> subnetAlloc = CreateObject<ListPositionAllocator>();
-        for (uint32_t j = 0; j < newLanNodes.GetN(); ++j)
-        {
-            subnetAlloc->Add(Vector(0.0, j * 10 + 10, 0.0));
-        }
-        mobilityLan.PushReferenceMobilityModel(backbone.Get(i));
-        mobilityLan.SetPositionAllocator(subnetAlloc);
-        mobilityLan.SetMobilityModel("ns3::ConstantPositionMobilityModel");
-        mobilityLan.Install(newLanNodes);
-    }
-
-    ///////////////////////////////////////////////////////////////////////////
-    //                                                                       //
-    // Construct the mobile networks                                         //
+    // Construct the LANs and the mobile networks                            //
     //                                                                       //
     ///////////////////////////////////////////////////////////////////////////
 
-    // Reset the address base-- all of the 802.11 networks will be in
-    // the "10.0" address space
-    ipAddrs.SetBase("10.0.0.0", "255.255.255.0");
-
-    for (uint32_t i = 0; i < backboneNodes; ++i)
-    {
-        NS_LOG_INFO("Configuring wireless network for backbone node " << i);
-        //
-        // Create a container to manage the nodes of the LAN.  We need
-        // two containers here; one with all of the new nodes, and one
-        // with all of the nodes including new and existing nodes
-        //
-        NodeContainer stas;
-        stas.Create(infraNodes - 1);
-        // Now, create the container with all nodes on this link
-        NodeContainer infra(backbone.Get(i), stas);
-        //
-        // Create an infrastructure network
-        //
-        WifiHelper wifiInfra;
-        WifiMacHelper macInfra;
-        wifiPhy.SetChannel(wifiChannel.Create());
-        // Create unique ssids for these networks
-        std::string ssidString("wifi-infra");
-        std::stringstream ss;
-        ss << i;
-        ssidString += ss.str();
-        Ssid ssid = Ssid(ssidString);
-        // setup stas
-        macInfra.SetType("ns3::StaWifiMac", "Ssid", SsidValue(ssid));
-        NetDeviceContainer staDevices = wifiInfra.Install(wifiPhy, macInfra, stas);
-        // setup ap.
-        macInfra.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid));
-        NetDeviceContainer apDevices = wifiInfra.Install(wifiPhy, macInfra, backbone.Get(i));
-        // Collect all of these new devices
-        NetDeviceContainer infraDevices(apDevices, staDevices);
-
-        // Add the IPv4 protocol stack to the nodes in our container
-        //
-        internet.Install(stas);
-        //
-        // Assign IPv4 addresses to the device drivers (actually to the associated
-        // IPv4 interfaces) we just created.
-        //
-        ipAddrs.Assign(infraDevices);
-        //
-        // Assign a new network prefix for each mobile network, according to
-        // the network mask initialized above
-        //
-        ipAddrs.NewNetwork();
-        //
-        // The new wireless nodes need a mobility model so we aggregate one
-        // to each of the nodes we just finished building.
-        //
-        Ptr<ListPositionAllocator> subnetAlloc = CreateObject<ListPositionAllocator>();
-        for (uint32_t j = 0; j < infra.GetN(); ++j)
-        {
-            subnetAlloc->Add(Vector(0.0, j, 0.0));
-        }
-        mobility.PushReferenceMobilityModel(backbone.Get(i));
-        mobility.SetPositionAllocator(subnetAlloc);
-        mobility.SetMobilityModel("ns3::RandomDirection2dMobilityModel",
-                                  "Bounds",
-                                  RectangleValue(Rectangle(-10, 10, -10, 10)),
-                                  "Speed",
-                                  StringValue("ns3::ConstantRandomVariable[Constant=3]"),
-                                  "Pause",
-                                  StringValue("ns3::ConstantRandomVariable[Constant=0.4]"));
-        mobility.Install(stas);
-    }
+    // Every backbone node gets a LAN of lanNodes - 1 hosts at rest in the
+    // 172.16/12 address space, and an infrastructure network of
+    // infraNodes - 1 STAs moving around it in the 10/8 address space,
+    // all built at once
+    NS_LOG_INFO("Configuring the LANs and wireless networks of the backbone nodes");
+    HanetTopologyBuilder topology;
+    topology.SetLanNodes(lanNodes);
+    topology.SetSubnetNodes(infraNodes);
+    topology.SetSsidPrefix("wifi-infra");
+    topology.SetWifi(wifiPhy, wifiChannel);
+    topology.Build(backbone, internet, infraAddrs, &lanAddrs);
+    topology.PrintReport(std::cout);
+    lanAddrs.PrintReport(std::cout);
+    infraAddrs.PrintReport(std::cout);
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -399,10 +322,11 @@ main(int argc, char* argv[])
     CsmaHelper csma;
 
     //
-    // Let's set up some ns-2-like ascii traces, using another helper class
+    // Let's set up some ns-2-like ascii traces, written to disk by a
+    // background thread
     //
-    AsciiTraceHelper ascii;
-    Ptr<OutputStreamWrapper> stream = ascii.CreateFileStream("mixed-wireless.tr");
+    AsyncOstream asciiTrace("mixed-wireless.tr");
+    Ptr<OutputStreamWrapper> stream = Create<OutputStreamWrapper>(&asciiTrace);
     wifiPhy.EnableAsciiAll(stream);
     csma.EnableAsciiAll(stream);
     internet.EnableAsciiIpv4All(stream);
@@ -414,13 +338,16 @@ main(int argc, char* argv[])
     // pcap trace on the application data sink
     wifiPhy.EnablePcap("mixed-wireless", appSink->GetId(), 0);
 
+    // course changes are printed on stdout from the trace writer thread
+    std::unique_ptr<AsyncOstream> courseChanges;
     if (useCourseChangeCallback)
     {
+        courseChanges = std::make_unique<AsyncOstream>(STDOUT_FILENO);
         Config::Connect("/NodeList/*/$ns3::MobilityModel/CourseChange",
-                        MakeCallback(&CourseChangeCallback));
+                        MakeBoundCallback(&CourseChangeCallback, courseChanges.get()));
     }
     NS_LOG_UNCOND(lastNodeIndex);
-    AnimationInterface anim("mixed-wireless.xml");
+    AnimOutput anim("mixed-wireless.xml", animMode, Seconds(animInterval));
 
     ///////////////////////////////////////////////////////////////////////////
     //                                                                       //
@@ -430,7 +357,17 @@ main(int argc, char* argv[])
 
     NS_LOG_INFO("Run Simulation.");
     Simulator::Stop(Seconds(stopTime));
+    scheduler.Start();
     Simulator::Run();
+    scheduler.Stop();
+    scheduler.PrintReport(std::clog);
+    anim.Close();
+    asciiTrace.Close();
+    asciiTrace.GetWriter().PrintStats(std::clog, "mixed-wireless.tr");
+    if (courseChanges)
+    {
+        courseChanges->Close();
+    }
     Simulator::Destroy();
 
     return 0;
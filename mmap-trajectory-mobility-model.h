@@ -0,0 +1,374 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef MMAP_TRAJECTORY_MOBILITY_MODEL_H
+#define MMAP_TRAJECTORY_MOBILITY_MODEL_H
+
+#include "trajectory-format.h"
+
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * A read-only mapping of a trajectory file, shared by all the mobility
+ * models that use the same file.
+ */
+class TrajectoryMapping
+{
+  public:
+    /**
+     * Map a file, or return the existing mapping of it.
+     * \param fileName The .traj file.
+     * \return the mapping.
+     */
+    static std::shared_ptr<const TrajectoryMapping> Open(const std::string& fileName);
+
+    /**
+     * Map and validate a file; aborts the simulation on error.
+     * \param fileName The .traj file.
+     */
+    explicit TrajectoryMapping(const std::string& fileName);
+    ~TrajectoryMapping();
+
+    TrajectoryMapping(const TrajectoryMapping&) = delete;
+    TrajectoryMapping& operator=(const TrajectoryMapping&) = delete;
+
+    /**
+     * \return the number of node trajectories.
+     */
+    uint32_t GetNNodes() const;
+    /**
+     * \param node A node trajectory index.
+     * \return its first segment.
+     */
+    const TrajectorySegment* Begin(uint32_t node) const;
+    /**
+     * \param node A node trajectory index.
+     * \return one past its last segment.
+     */
+    const TrajectorySegment* End(uint32_t node) const;
+
+  private:
+    void* m_data{nullptr};                //!< Mapped file.
+    std::size_t m_size{0};                //!< Mapping size.
+    const TrajectoryFileHeader* m_header; //!< File header.
+    const uint64_t* m_first;              //!< First segment of each node.
+    const TrajectorySegment* m_segments;  //!< All the segments.
+};
+
+/**
+ * Mobility model that replays a precomputed trajectory from a memory mapped
+ * .traj file (see trajectory-gen).
+ *
+ * GetPosition() and GetVelocity() look up the segment that contains the
+ * current time; the last segment used is remembered, so the common case of
+ * a time that moved forward by less than a segment costs no search, and a
+ * binary search is used otherwise.  No events are scheduled unless
+ * NotifyCourseChanges is set, in which case a CourseChange is fired at the
+ * start of each segment, as RandomWaypointMobilityModel does.
+ *
+ * The initial position comes from the file, so the position set by the
+ * MobilityHelper position allocator is ignored.  With a TimeOffset the
+ * replay starts that far into the trajectories, which lets a run begin
+ * with motion that has already been going on for a while.
+ */
+class MmapTrajectoryMobilityModel : public MobilityModel
+{
+  public:
+    /**
+     * Register this type.
+     * \return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+  private:
+    void DoInitialize() override;
+    void DoDispose() override;
+    Vector DoGetPosition() const override;
+    void DoSetPosition(const Vector& position) override;
+    Vector DoGetVelocity() const override;
+
+    /**
+     * Map the file and select the trajectory of this node, once.
+     */
+    void Load() const;
+    /**
+     * \return the current time in the trajectories, in seconds.
+     */
+    double Now() const;
+    /**
+     * \return the segment that contains the current time.
+     */
+    const TrajectorySegment* Current() const;
+    /**
+     * Fire CourseChange and schedule the next one.
+     */
+    void CourseChange();
+
+    std::string m_fileName;                                 //!< Trajectory file.
+    uint32_t m_nodeIndex;                                   //!< Trajectory index, or auto.
+    bool m_notifyCourseChanges;                             //!< Fire CourseChange events.
+    double m_timeOffset;                                    //!< Trajectory time at 0 s.
+    mutable std::shared_ptr<const TrajectoryMapping> m_map; //!< The mapping.
+    mutable const TrajectorySegment* m_begin{nullptr};      //!< First segment.
+    mutable const TrajectorySegment* m_end{nullptr};        //!< One past the last segment.
+    mutable const TrajectorySegment* m_cursor{nullptr};     //!< Last segment used.
+    const TrajectorySegment* m_nextChange{nullptr};         //!< Next course change segment.
+    EventId m_event;                                        //!< Next course change.
+};
+
+NS_OBJECT_ENSURE_REGISTERED(MmapTrajectoryMobilityModel);
+
+inline std::shared_ptr<const TrajectoryMapping>
+TrajectoryMapping::Open(const std::string& fileName)
+{
+    static std::map<std::string, std::weak_ptr<const TrajectoryMapping>> cache;
+    std::shared_ptr<const TrajectoryMapping> mapping = cache[fileName].lock();
+    if (!mapping)
+    {
+        mapping = std::make_shared<const TrajectoryMapping>(fileName);
+        cache[fileName] = mapping;
+    }
+    return mapping;
+}
+
+inline TrajectoryMapping::TrajectoryMapping(const std::string& fileName)
+{
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0)
+    {
+        NS_FATAL_ERROR("Cannot open trajectory file " << fileName);
+    }
+    m_size = st.st_size;
+    if (m_size < sizeof(TrajectoryFileHeader))
+    {
+        NS_FATAL_ERROR("Trajectory file " << fileName << " is truncated");
+    }
+    m_data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (m_data == MAP_FAILED)
+    {
+        NS_FATAL_ERROR("Cannot map trajectory file " << fileName);
+    }
+
+    auto base = static_cast<const uint8_t*>(m_data);
+    m_header = reinterpret_cast<const TrajectoryFileHeader*>(base);
+    if (std::memcmp(m_header->magic, "MTRJ", 4) != 0 ||
+        m_header->version != TrajectoryFileHeader::VERSION)
+    {
+        NS_FATAL_ERROR(fileName << " is not a version " << TrajectoryFileHeader::VERSION
+                                << " trajectory file");
+    }
+    std::size_t offsets = sizeof(TrajectoryFileHeader);
+    std::size_t segments = offsets + (m_header->nodes + 1) * sizeof(uint64_t);
+    m_first = reinterpret_cast<const uint64_t*>(base + offsets);
+    m_segments = reinterpret_cast<const TrajectorySegment*>(base + segments);
+    if (m_size < segments ||
+        m_size < segments + m_first[m_header->nodes] * sizeof(TrajectorySegment))
+    {
+        NS_FATAL_ERROR("Trajectory file " << fileName << " is truncated");
+    }
+}
+
+inline TrajectoryMapping::~TrajectoryMapping()
+{
+    ::munmap(m_data, m_size);
+}
+
+inline uint32_t
+TrajectoryMapping::GetNNodes() const
+{
+    return m_header->nodes;
+}
+
+inline const TrajectorySegment*
+TrajectoryMapping::Begin(uint32_t node) const
+{
+    return m_segments + m_first[node];
+}
+
+inline const TrajectorySegment*
+TrajectoryMapping::End(uint32_t node) const
+{
+    return m_segments + m_first[node + 1];
+}
+
+inline TypeId
+MmapTrajectoryMobilityModel::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::MmapTrajectoryMobilityModel")
+            .SetParent<MobilityModel>()
+            .SetGroupName("Mobility")
+            .AddConstructor<MmapTrajectoryMobilityModel>()
+            .AddAttribute("TrajectoryFile",
+                          "The .traj file written by trajectory-gen.",
+                          StringValue(""),
+                          MakeStringAccessor(&MmapTrajectoryMobilityModel::m_fileName),
+                          MakeStringChecker())
+            .AddAttribute("NodeIndex",
+                          "The trajectory to replay; by default the id of the node.",
+                          UintegerValue(std::numeric_limits<uint32_t>::max()),
+                          MakeUintegerAccessor(&MmapTrajectoryMobilityModel::m_nodeIndex),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("NotifyCourseChanges",
+                          "Fire CourseChange at the start of every segment.",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&MmapTrajectoryMobilityModel::m_notifyCourseChanges),
+                          MakeBooleanChecker())
+            .AddAttribute("TimeOffset",
+                          "Trajectory time, in seconds, replayed at simulation time 0.",
+                          DoubleValue(0.0),
+                          MakeDoubleAccessor(&MmapTrajectoryMobilityModel::m_timeOffset),
+                          MakeDoubleChecker<double>(0.0));
+    return tid;
+}
+
+inline void
+MmapTrajectoryMobilityModel::Load() const
+{
+    if (m_begin)
+    {
+        return;
+    }
+    m_map = TrajectoryMapping::Open(m_fileName);
+    uint32_t index = m_nodeIndex;
+    if (index == std::numeric_limits<uint32_t>::max())
+    {
+        Ptr<Node> node = GetObject<Node>();
+        NS_ASSERT_MSG(node, "NodeIndex is needed for a model that is not aggregated to a node");
+        index = node->GetId();
+    }
+    if (index >= m_map->GetNNodes())
+    {
+        NS_FATAL_ERROR("Trajectory file " << m_fileName << " has " << m_map->GetNNodes()
+                                          << " trajectories, no trajectory " << index);
+    }
+    m_begin = m_map->Begin(index);
+    m_end = m_map->End(index);
+    m_cursor = m_begin;
+}
+
+inline double
+MmapTrajectoryMobilityModel::Now() const
+{
+    return Simulator::Now().GetSeconds() + m_timeOffset;
+}
+
+inline const TrajectorySegment*
+MmapTrajectoryMobilityModel::Current() const
+{
+    Load();
+    double now = Now();
+    if (m_cursor->t <= now)
+    {
+        // time normally moves forward by less than a segment between calls
+        if (m_cursor + 1 == m_end || (m_cursor + 1)->t > now)
+        {
+            return m_cursor;
+        }
+        if (m_cursor + 2 == m_end || (m_cursor + 2)->t > now)
+        {
+            return ++m_cursor;
+        }
+    }
+    auto next = std::upper_bound(m_begin + 1,
+                                 m_end,
+                                 now,
+                                 [](double t, const TrajectorySegment& s) { return t < s.t; });
+    m_cursor = next - 1;
+    return m_cursor;
+}
+
+inline Vector
+MmapTrajectoryMobilityModel::DoGetPosition() const
+{
+    const TrajectorySegment* s = Current();
+    double dt = Now() - s->t;
+    return Vector(s->x + s->vx * dt, s->y + s->vy * dt, s->z + s->vz * dt);
+}
+
+inline void
+MmapTrajectoryMobilityModel::DoSetPosition(const Vector& /* position */)
+{
+    // the trajectory is fixed by the file
+    Load();
+}
+
+inline Vector
+MmapTrajectoryMobilityModel::DoGetVelocity() const
+{
+    const TrajectorySegment* s = Current();
+    return Vector(s->vx, s->vy, s->vz);
+}
+
+inline void
+MmapTrajectoryMobilityModel::DoInitialize()
+{
+    Load();
+    if (m_notifyCourseChanges)
+    {
+        m_nextChange = Current() + 1;
+        CourseChange();
+    }
+    MobilityModel::DoInitialize();
+}
+
+inline void
+MmapTrajectoryMobilityModel::CourseChange()
+{
+    NotifyCourseChange();
+    if (m_nextChange != m_end)
+    {
+        Time delay = Max(Seconds(m_nextChange->t - Now()), Time(0));
+        m_event = Simulator::Schedule(delay, &MmapTrajectoryMobilityModel::CourseChange, this);
+        m_nextChange++;
+    }
+}
+
+inline void
+MmapTrajectoryMobilityModel::DoDispose()
+{
+    m_event.Cancel();
+    m_begin = m_end = m_cursor = m_nextChange = nullptr;
+    m_map.reset();
+    MobilityModel::DoDispose();
+}
+
+} // namespace ns3
+
+#endif /* MMAP_TRAJECTORY_MOBILITY_MODEL_H */
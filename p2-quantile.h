@@ -0,0 +1,176 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef P2_QUANTILE_H
+#define P2_QUANTILE_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+/**
+ * Streaming estimate of one quantile with the P-square algorithm of Jain
+ * and Chlamtac (CACM 28(10), 1985): five markers track the minimum, the
+ * p/2, p and (1+p)/2 quantiles and the maximum, and each sample moves them
+ * towards their desired positions with a piecewise parabolic fit.  Memory
+ * and time per sample are constant, whatever the length of the run.
+ */
+class P2Quantile
+{
+  public:
+    /**
+     * \param p The quantile to estimate, in (0, 1).
+     */
+    explicit P2Quantile(double p);
+
+    /**
+     * \param x A sample.
+     */
+    void Add(double x);
+    /**
+     * \return the estimate, exact for fewer than five samples, 0 if none.
+     */
+    double Get() const;
+    /**
+     * \return the number of samples.
+     */
+    uint64_t GetCount() const;
+
+  private:
+    /**
+     * \param i A middle marker.
+     * \param d The direction of its move, 1 or -1.
+     * \return its parabolic prediction.
+     */
+    double Parabolic(int i, double d) const;
+    /**
+     * \param i A middle marker.
+     * \param d The direction of its move, 1 or -1.
+     * \return its linear prediction.
+     */
+    double Linear(int i, int d) const;
+
+    double m_p;                      //!< The quantile.
+    uint64_t m_count{0};             //!< Samples.
+    std::array<double, 5> m_height;  //!< Marker heights.
+    std::array<double, 5> m_pos;     //!< Marker positions, from 1.
+    std::array<double, 5> m_desired; //!< Desired marker positions.
+    std::array<double, 5> m_step;    //!< Desired position increments.
+};
+
+inline P2Quantile::P2Quantile(double p)
+    : m_p(p),
+      m_height{},
+      m_pos{1, 2, 3, 4, 5},
+      m_desired{1, 1 + 2 * p, 1 + 4 * p, 3 + 2 * p, 5},
+      m_step{0, p / 2, p, (1 + p) / 2, 1}
+{
+}
+
+inline void
+P2Quantile::Add(double x)
+{
+    if (m_count < 5)
+    {
+        m_height[m_count++] = x;
+        if (m_count == 5)
+        {
+            std::sort(m_height.begin(), m_height.end());
+        }
+        return;
+    }
+    m_count++;
+    int k;
+    if (x < m_height[0])
+    {
+        m_height[0] = x;
+        k = 0;
+    }
+    else if (x >= m_height[4])
+    {
+        m_height[4] = x;
+        k = 3;
+    }
+    else
+    {
+        k = 0;
+        while (x >= m_height[k + 1])
+        {
+            k++;
+        }
+    }
+    for (int i = k + 1; i < 5; i++)
+    {
+        m_pos[i]++;
+    }
+    for (int i = 0; i < 5; i++)
+    {
+        m_desired[i] += m_step[i];
+    }
+    for (int i = 1; i < 4; i++)
+    {
+        double d = m_desired[i] - m_pos[i];
+        if ((d >= 1 && m_pos[i + 1] - m_pos[i] > 1) || (d <= -1 && m_pos[i - 1] - m_pos[i] < -1))
+        {
+            int s = d > 0 ? 1 : -1;
+            double h = Parabolic(i, s);
+            // the parabola must keep the heights ordered
+            m_height[i] = m_height[i - 1] < h && h < m_height[i + 1] ? h : Linear(i, s);
+            m_pos[i] += s;
+        }
+    }
+}
+
+inline double
+P2Quantile::Parabolic(int i, double d) const
+{
+    return m_height[i] + d / (m_pos[i + 1] - m_pos[i - 1]) *
+                             ((m_pos[i] - m_pos[i - 1] + d) * (m_height[i + 1] - m_height[i]) /
+                                  (m_pos[i + 1] - m_pos[i]) +
+                              (m_pos[i + 1] - m_pos[i] - d) * (m_height[i] - m_height[i - 1]) /
+                                  (m_pos[i] - m_pos[i - 1]));
+}
+
+inline double
+P2Quantile::Linear(int i, int d) const
+{
+    return m_height[i] + d * (m_height[i + d] - m_height[i]) / (m_pos[i + d] - m_pos[i]);
+}
+
+inline double
+P2Quantile::Get() const
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+    if (m_count < 5)
+    {
+        std::array<double, 5> sorted = m_height;
+        std::sort(sorted.begin(), sorted.begin() + m_count);
+        return sorted[std::lround(m_p * (m_count - 1))];
+    }
+    return m_height[2];
+}
+
+inline uint64_t
+P2Quantile::GetCount() const
+{
+    return m_count;
+}
+
+#endif /* P2_QUANTILE_H */
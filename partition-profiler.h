@@ -0,0 +1,385 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef PARTITION_PROFILER_H
+#define PARTITION_PROFILER_H
+
+#include "ns3/default-simulator-impl.h"
+#include "ns3/event-impl.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Assignment of the nodes of a hybrid network to logical processes.
+ *
+ * The unit of partitioning is an AP subnet: the manet node that acts as
+ * the AP together with the STAs behind it, since the STAs only talk to the
+ * rest of the network through their AP.  Consecutive subnets go to the
+ * same partition, so each partition also owns a contiguous slice of the
+ * manet backbone.  Nodes that were never assigned, and events that run
+ * outside any node context, belong to no partition and are counted as
+ * global.
+ */
+class PartitionPlan
+{
+  public:
+    /// Partition of the nodes that were not assigned.
+    static const uint32_t GLOBAL = 0xffffffff;
+
+    /**
+     * \param nPartitions The number of partitions.
+     * \param nSubnets The number of AP subnets to spread over them.
+     */
+    PartitionPlan(uint32_t nPartitions, uint32_t nSubnets);
+
+    /**
+     * Assign the nodes of a subnet.
+     * \param subnet The subnet index, below nSubnets.
+     * \param nodes Its AP and STAs.
+     */
+    void AddSubnet(uint32_t subnet, const NodeContainer& nodes);
+
+    /**
+     * \return the number of partitions.
+     */
+    uint32_t GetNPartitions() const;
+    /**
+     * \param context A node id, or a simulator context.
+     * \return its partition, or GLOBAL.
+     */
+    uint32_t GetPartition(uint32_t context) const;
+    /**
+     * \param partition A partition.
+     * \return the number of nodes assigned to it.
+     */
+    uint32_t GetNNodes(uint32_t partition) const;
+
+  private:
+    uint32_t m_nPartitions;              //!< Number of partitions.
+    uint32_t m_nSubnets;                 //!< Number of subnets.
+    std::vector<uint32_t> m_partitionOf; //!< Partition by node id.
+    std::vector<uint32_t> m_nodes;       //!< Node count by partition.
+};
+
+/**
+ * Default simulator that counts the events each partition of a
+ * PartitionPlan would execute, to estimate what a conservative parallel
+ * run of the same scenario could gain.
+ *
+ * Every scheduled event is wrapped, so the count is taken when the event
+ * runs (cancelled events are not counted) and charged to the partition of
+ * the context it runs in.  Besides the totals, the run is cut into
+ * windows of one lookahead, the granularity at which a conservative
+ * synchronization lets the partitions advance independently: within a
+ * window the partitions run in parallel and the slowest one sets the pace,
+ * so the sum over the windows of the largest partition count, plus the
+ * global events, is the critical path in events.
+ *
+ * Select it with the SimulatorImplementationType global value before the
+ * first event is scheduled, then call SetPlan().
+ */
+class PartitionProfilingSimulatorImpl : public DefaultSimulatorImpl
+{
+  public:
+    /**
+     * Register this type.
+     * \return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * Start counting.
+     * \param plan The partitioning, which must outlive the run.
+     * \param lookahead The synchronization window.
+     */
+    void SetPlan(const PartitionPlan* plan, Time lookahead);
+
+    EventId Schedule(const Time& delay, EventImpl* event) override;
+    void ScheduleWithContext(uint32_t context, const Time& delay, EventImpl* event) override;
+    EventId ScheduleNow(EventImpl* event) override;
+
+    /**
+     * \param partition A partition.
+     * \return the number of events it ran.
+     */
+    uint64_t GetEventCount(uint32_t partition) const;
+    /**
+     * \return the number of events that ran in no partition.
+     */
+    uint64_t GetGlobalEventCount() const;
+    /**
+     * \return the events on the critical path, see the class description.
+     */
+    uint64_t GetCriticalPathEventCount() const;
+    /**
+     * \return the number of lookahead windows with at least one event.
+     */
+    uint64_t GetWindowCount() const;
+
+    /**
+     * Print the per-partition counts and the speedup estimates.
+     * \param os The output stream.
+     */
+    void PrintReport(std::ostream& os) const;
+
+  private:
+    /// Event wrapper that counts the wrapped event when it runs.
+    class CountingEvent : public EventImpl
+    {
+      public:
+        /**
+         * \param impl The simulator.
+         * \param event The event, whose reference is taken over.
+         */
+        CountingEvent(PartitionProfilingSimulatorImpl* impl, EventImpl* event)
+            : m_impl(impl),
+              m_event(event, false)
+        {
+        }
+
+      private:
+        void Notify() override
+        {
+            m_impl->Count();
+            m_event->Invoke();
+        }
+
+        PartitionProfilingSimulatorImpl* m_impl; //!< The simulator.
+        Ptr<EventImpl> m_event;                  //!< The wrapped event.
+    };
+
+    /**
+     * \param event An event.
+     * \return the event to schedule in its place.
+     */
+    EventImpl* Wrap(EventImpl* event);
+    /**
+     * Count the event that is about to run.
+     */
+    void Count();
+    /**
+     * Add the current window to the critical path.
+     */
+    void CloseWindow();
+
+    const PartitionPlan* m_plan{nullptr}; //!< The partitioning.
+    int64_t m_lookahead{1};               //!< Window length in time steps.
+    std::vector<uint64_t> m_events;       //!< Events by partition.
+    std::vector<uint64_t> m_window;       //!< Events by partition in the current window.
+    uint64_t m_global{0};                 //!< Events in no partition.
+    uint64_t m_critical{0};               //!< Critical path of the closed windows.
+    uint64_t m_windows{0};                //!< Windows with events.
+    int64_t m_currentWindow{-1};          //!< Index of the current window.
+};
+
+NS_OBJECT_ENSURE_REGISTERED(PartitionProfilingSimulatorImpl);
+
+inline PartitionPlan::PartitionPlan(uint32_t nPartitions, uint32_t nSubnets)
+    : m_nPartitions(nPartitions),
+      m_nSubnets(nSubnets),
+      m_nodes(nPartitions, 0)
+{
+    NS_ASSERT_MSG(nPartitions > 0 && nSubnets > 0, "Empty partition plan");
+}
+
+inline void
+PartitionPlan::AddSubnet(uint32_t subnet, const NodeContainer& nodes)
+{
+    NS_ASSERT(subnet < m_nSubnets);
+    uint32_t partition = static_cast<uint64_t>(subnet) * m_nPartitions / m_nSubnets;
+    for (auto it = nodes.Begin(); it != nodes.End(); ++it)
+    {
+        uint32_t id = (*it)->GetId();
+        if (id >= m_partitionOf.size())
+        {
+            m_partitionOf.resize(id + 1, GLOBAL);
+        }
+        m_partitionOf[id] = partition;
+        m_nodes[partition]++;
+    }
+}
+
+inline uint32_t
+PartitionPlan::GetNPartitions() const
+{
+    return m_nPartitions;
+}
+
+inline uint32_t
+PartitionPlan::GetPartition(uint32_t context) const
+{
+    return context < m_partitionOf.size() ? m_partitionOf[context] : GLOBAL;
+}
+
+inline uint32_t
+PartitionPlan::GetNNodes(uint32_t partition) const
+{
+    return m_nodes[partition];
+}
+
+inline TypeId
+PartitionProfilingSimulatorImpl::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::PartitionProfilingSimulatorImpl")
+                            .SetParent<DefaultSimulatorImpl>()
+                            .SetGroupName("Core")
+                            .AddConstructor<PartitionProfilingSimulatorImpl>();
+    return tid;
+}
+
+inline void
+PartitionProfilingSimulatorImpl::SetPlan(const PartitionPlan* plan, Time lookahead)
+{
+    NS_ASSERT_MSG(lookahead.IsStrictlyPositive(), "The lookahead must be positive");
+    m_plan = plan;
+    m_lookahead = lookahead.GetTimeStep();
+    m_events.assign(plan->GetNPartitions(), 0);
+    m_window.assign(plan->GetNPartitions(), 0);
+}
+
+inline EventImpl*
+PartitionProfilingSimulatorImpl::Wrap(EventImpl* event)
+{
+    return new CountingEvent(this, event);
+}
+
+inline EventId
+PartitionProfilingSimulatorImpl::Schedule(const Time& delay, EventImpl* event)
+{
+    return DefaultSimulatorImpl::Schedule(delay, Wrap(event));
+}
+
+inline void
+PartitionProfilingSimulatorImpl::ScheduleWithContext(uint32_t context,
+                                                     const Time& delay,
+                                                     EventImpl* event)
+{
+    DefaultSimulatorImpl::ScheduleWithContext(context, delay, Wrap(event));
+}
+
+inline EventId
+PartitionProfilingSimulatorImpl::ScheduleNow(EventImpl* event)
+{
+    return DefaultSimulatorImpl::ScheduleNow(Wrap(event));
+}
+
+inline void
+PartitionProfilingSimulatorImpl::CloseWindow()
+{
+    if (m_currentWindow >= 0)
+    {
+        m_critical += *std::max_element(m_window.begin(), m_window.end());
+        std::fill(m_window.begin(), m_window.end(), 0);
+        m_windows++;
+    }
+}
+
+inline void
+PartitionProfilingSimulatorImpl::Count()
+{
+    if (!m_plan)
+    {
+        return;
+    }
+    uint32_t partition = m_plan->GetPartition(GetContext());
+    if (partition == PartitionPlan::GLOBAL)
+    {
+        // runs alone, between the windows
+        m_global++;
+        return;
+    }
+    int64_t window = Now().GetTimeStep() / m_lookahead;
+    if (window != m_currentWindow)
+    {
+        CloseWindow();
+        m_currentWindow = window;
+    }
+    m_events[partition]++;
+    m_window[partition]++;
+}
+
+inline uint64_t
+PartitionProfilingSimulatorImpl::GetEventCount(uint32_t partition) const
+{
+    return m_events[partition];
+}
+
+inline uint64_t
+PartitionProfilingSimulatorImpl::GetGlobalEventCount() const
+{
+    return m_global;
+}
+
+inline uint64_t
+PartitionProfilingSimulatorImpl::GetCriticalPathEventCount() const
+{
+    uint64_t open = m_window.empty() ? 0 : *std::max_element(m_window.begin(), m_window.end());
+    return m_critical + open + m_global;
+}
+
+inline uint64_t
+PartitionProfilingSimulatorImpl::GetWindowCount() const
+{
+    return m_windows + (m_currentWindow >= 0 ? 1 : 0);
+}
+
+inline void
+PartitionProfilingSimulatorImpl::PrintReport(std::ostream& os) const
+{
+    if (!m_plan)
+    {
+        return;
+    }
+    uint64_t total = m_global;
+    uint64_t largest = 0;
+    for (uint64_t events : m_events)
+    {
+        total += events;
+        largest = std::max(largest, events);
+    }
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << "Partition  Nodes     Events  Share" << std::endl;
+    for (uint32_t p = 0; p < m_plan->GetNPartitions(); p++)
+    {
+        os << std::setw(9) << p << std::setw(7) << m_plan->GetNNodes(p) << std::setw(11)
+           << m_events[p] << std::setw(6) << std::fixed << std::setprecision(1)
+           << (total ? 100.0 * m_events[p] / total : 0.0) << "%" << std::endl;
+    }
+    os << "   global" << std::setw(7) << "-" << std::setw(11) << m_global << std::endl;
+    uint64_t critical = GetCriticalPathEventCount();
+    os << std::setprecision(2) << "Load balance bound speedup: "
+       << (largest + m_global ? double(total) / (largest + m_global) : 0.0) << std::endl
+       << "Lookahead " << TimeStep(m_lookahead).As(Time::US) << ": " << GetWindowCount()
+       << " windows, " << critical << " events on the critical path, speedup "
+       << (critical ? double(total) / critical : 0.0) << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
+
+} // namespace ns3
+
+#endif /* PARTITION_PROFILER_H */
@@ -0,0 +1,85 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef PAYLOAD_TIMESTAMP_H
+#define PAYLOAD_TIMESTAMP_H
+
+#include "ns3/application.h"
+#include "ns3/boolean.h"
+#include "ns3/nstime.h"
+#include "ns3/on-off-application.h"
+#include "ns3/packet.h"
+#include "ns3/seq-ts-header.h"
+#include "ns3/seq-ts-size-header.h"
+
+namespace ns3
+{
+
+/**
+ * Make a source application stamp its packets with its send time, if it
+ * does not already.  UdpClient and MultiFlowSender start every payload
+ * with a SeqTsHeader; an OnOffApplication is switched to a
+ * SeqTsSizeHeader, which puts a 64-bit size in front of the sequence
+ * number and time stamp, so the receiver must know which one to read.
+ * \param app The source application.
+ * \return true if it sends a SeqTsSizeHeader, false for a SeqTsHeader.
+ */
+inline bool
+EnablePayloadTimestamp(Ptr<Application> app)
+{
+    if (DynamicCast<OnOffApplication>(app))
+    {
+        app->SetAttribute("EnableSeqTsSizeHeader", BooleanValue(true));
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Read the send time that a source stamped at the start of a payload.
+ * \param packet The received packet.
+ * \param sizeHeader Whether the source sends a SeqTsSizeHeader, see
+ * EnablePayloadTimestamp().
+ * \param ts Set to the send time.
+ * \return false if the packet is too short to hold the header.
+ */
+inline bool
+PeekPayloadTimestamp(Ptr<const Packet> packet, bool sizeHeader, Time& ts)
+{
+    if (sizeHeader)
+    {
+        SeqTsSizeHeader header;
+        if (packet->GetSize() < header.GetSerializedSize())
+        {
+            return false;
+        }
+        packet->PeekHeader(header);
+        ts = header.GetTs();
+        return true;
+    }
+    SeqTsHeader header;
+    if (packet->GetSize() < header.GetSerializedSize())
+    {
+        return false;
+    }
+    packet->PeekHeader(header);
+    ts = header.GetTs();
+    return true;
+}
+
+} // namespace ns3
+
+#endif /* PAYLOAD_TIMESTAMP_H */
@@ -0,0 +1,1001 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Offline analyzer for the per-node radiotap captures written by the hanet
+ * and manet scenarios (wifiPhy.EnablePcap with DLT_IEEE802_11_RADIO), such
+ * as resultados/AODV/hanet-compairsonV2-<node>-0.pcap.
+ *
+ * Every capture is mapped read-only and walked in place; the radiotap,
+ * 802.11, LLC/SNAP, IPv4 and UDP headers are decoded straight from the
+ * mapping without copying the frames.  Captures are spread over a pool of
+ * threads, one file at a time per thread, and the per-file results are
+ * merged at the end.
+ *
+ * ns-3 writes the Tx and Rx side of a PHY into the same capture; Rx frames
+ * carry the dBm antenna signal/noise radiotap fields and Tx frames do not,
+ * which is how the direction of a frame is told apart.
+ *
+ * Reported KPIs:
+ * - packet delivery ratio of the UDP data traffic (--dataPort, 9 by default):
+ *   datagrams, identified by IPv4 source, destination and identification,
+ *   that were seen in any capture versus those received by a capture whose
+ *   node owns the destination address.  A node owns the addresses it uses as
+ *   source of the routing control and ARP packets it transmits.
+ * - end-to-end delay of the delivered datagrams: first reception at the
+ *   destination minus first sighting in any capture.
+ * - routing control overhead: transmitted OLSR (by message type), AODV,
+ *   DSDV and DSR (by option type) packets and their bytes.
+ * - per-node airtime: sum of the estimated durations of the transmitted
+ *   frames, from the legacy rate or the HT/VHT/HE MCS radiotap fields.
+ *
+ * Usage:
+ *   pcap-analyzer [--threads=N] [--dataPort=9] [--csv=nodes.csv] <file-or-dir>...
+ * Directories are expanded to the *.pcap files they contain.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+
+/// Routing control packet classes.
+enum Control
+{
+    OLSR_HELLO,
+    OLSR_TC,
+    OLSR_MID,
+    OLSR_HNA,
+    OLSR_OTHER,
+    AODV_RREQ,
+    AODV_RREP,
+    AODV_RERR,
+    AODV_RREP_ACK,
+    AODV_OTHER,
+    DSDV_UPDATE,
+    DSR_RREQ,
+    DSR_RREP,
+    DSR_RERR,
+    DSR_ACK_REQ,
+    DSR_ACK,
+    DSR_OTHER,
+    CONTROL_COUNT,
+};
+
+/// Names of the Control values.
+const char* const g_controlNames[CONTROL_COUNT] = {
+    "OLSR HELLO",
+    "OLSR TC",
+    "OLSR MID",
+    "OLSR HNA",
+    "OLSR other",
+    "AODV RREQ",
+    "AODV RREP",
+    "AODV RERR",
+    "AODV RREP-ACK",
+    "AODV other",
+    "DSDV update",
+    "DSR RREQ",
+    "DSR RREP",
+    "DSR RERR",
+    "DSR ACK-REQ",
+    "DSR ACK",
+    "DSR other",
+};
+
+const uint16_t OLSR_PORT = 698;  //!< OLSR UDP port.
+const uint16_t AODV_PORT = 654;  //!< AODV UDP port.
+const uint16_t DSDV_PORT = 269;  //!< DSDV UDP port.
+const uint8_t DSR_PROTOCOL = 48; //!< DSR IPv4 protocol number.
+
+/// Identity of a data datagram.
+struct DatagramKey
+{
+    uint32_t src; //!< IPv4 source.
+    uint32_t dst; //!< IPv4 destination.
+    uint16_t id;  //!< IPv4 identification.
+
+    /**
+     * \param o The other key.
+     * \return true if equal.
+     */
+    bool operator==(const DatagramKey& o) const
+    {
+        return src == o.src && dst == o.dst && id == o.id;
+    }
+};
+
+/// Hash of a DatagramKey.
+struct DatagramKeyHash
+{
+    /**
+     * \param k The key.
+     * \return the hash.
+     */
+    std::size_t operator()(const DatagramKey& k) const
+    {
+        uint64_t h = (static_cast<uint64_t>(k.src) << 32) ^ k.dst;
+        h ^= static_cast<uint64_t>(k.id) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+        return static_cast<std::size_t>(h * 0xbf58476d1ce4e5b9ULL);
+    }
+};
+
+using DatagramTimes = std::unordered_map<DatagramKey, double, DatagramKeyHash>;
+
+/// Results of one capture file.
+struct FileResult
+{
+    std::string path;                               //!< Capture file.
+    int node{-1};                                   //!< Node id parsed from the file name.
+    std::string error;                              //!< Error message, empty on success.
+    uint64_t txFrames{0};                           //!< Transmitted frames.
+    uint64_t rxFrames{0};                           //!< Received frames.
+    uint64_t txBytes{0};                            //!< Transmitted bytes.
+    double airtime{0};                              //!< Estimated Tx airtime in seconds.
+    uint64_t unknownRateFrames{0};                  //!< Tx frames without usable rate fields.
+    uint64_t control[CONTROL_COUNT]{};              //!< Transmitted control packets by class.
+    uint64_t controlBytes{0};                       //!< Bytes of transmitted control packets.
+    std::unordered_set<uint32_t> ownAddresses;      //!< Addresses of this node.
+    DatagramTimes firstSeen;                        //!< First sighting of each data datagram.
+    std::vector<std::pair<DatagramKey, double>> rx; //!< Data datagrams received.
+};
+
+/// Radiotap fields the analyzer uses.
+struct Radiotap
+{
+    uint16_t length{0};     //!< Header length.
+    bool rx{false};         //!< Antenna signal present, i.e. a received frame.
+    bool fcs{false};        //!< Frame ends with an FCS.
+    double rateMbps{0};     //!< Legacy rate, 0 if absent.
+    bool dsss{false};       //!< Legacy rate is DSSS/CCK.
+    double dataRateMbps{0}; //!< HT/VHT/HE data rate, 0 if absent.
+    double preambleUs{0};   //!< HT/VHT/HE preamble duration.
+    double symbolUs{4};     //!< HT/VHT/HE OFDM symbol duration.
+    bool ampdu{false};      //!< Frame is part of an A-MPDU.
+    uint32_t ampduRef{0};   //!< A-MPDU reference number.
+};
+
+/**
+ * Little endian 16 bit read.
+ * \param p The bytes.
+ * \return the value.
+ */
+inline uint16_t
+Le16(const uint8_t* p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+/**
+ * Little endian 32 bit read.
+ * \param p The bytes.
+ * \return the value.
+ */
+inline uint32_t
+Le32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+/**
+ * Big endian 16 bit read.
+ * \param p The bytes.
+ * \return the value.
+ */
+inline uint16_t
+Be16(const uint8_t* p)
+{
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+/**
+ * Big endian 32 bit read.
+ * \param p The bytes.
+ * \return the value.
+ */
+inline uint32_t
+Be32(const uint8_t* p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/**
+ * Data rate of an OFDM MCS.
+ * \param dataSubcarriers Number of data subcarriers.
+ * \param mcs The MCS index (0-11).
+ * \param nss Number of spatial streams.
+ * \param symbolUs Symbol duration including the guard interval.
+ * \return the rate in Mb/s, 0 if the MCS is unknown.
+ */
+double
+McsRate(unsigned dataSubcarriers, unsigned mcs, unsigned nss, double symbolUs)
+{
+    static const double bitsPerSubcarrier[12] =
+        {0.5, 1, 1.5, 2, 3, 4, 4.5, 5, 6, 6.6667, 7.5, 8.3333};
+    if (mcs >= 12 || nss == 0)
+    {
+        return 0;
+    }
+    return dataSubcarriers * bitsPerSubcarrier[mcs] * nss / symbolUs;
+}
+
+/**
+ * Decode the radiotap header.
+ * \param p Start of the frame.
+ * \param len Captured length.
+ * \param rt The decoded fields.
+ * \return false if the header is malformed.
+ */
+bool
+ParseRadiotap(const uint8_t* p, uint32_t len, Radiotap& rt)
+{
+    // alignment and size of the fields defined by radiotap, by presence bit
+    static const uint8_t align[28] = {8, 1, 1, 2, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1,
+                                      2, 2, 1, 1, 4, 1, 4, 2, 8, 2, 2, 2, 1, 2};
+    static const uint8_t size[28] = {8, 1, 1, 4, 2, 1, 1, 2, 2, 2, 1, 1, 1, 1,
+                                     2, 2, 1, 1, 8, 3, 8, 12, 12, 12, 12, 6, 1, 4};
+
+    if (len < 8 || p[0] != 0)
+    {
+        return false;
+    }
+    rt.length = Le16(p + 2);
+    if (rt.length > len)
+    {
+        return false;
+    }
+    uint32_t present = Le32(p + 4);
+    uint32_t offset = 8;
+    uint32_t word = present;
+    while (word & 0x80000000U)
+    {
+        if (offset + 4 > rt.length)
+        {
+            return false;
+        }
+        word = Le32(p + offset);
+        offset += 4;
+    }
+
+    for (unsigned bit = 0; bit < 28; bit++)
+    {
+        if (!(present & (1U << bit)))
+        {
+            continue;
+        }
+        offset = (offset + align[bit] - 1) & ~(align[bit] - 1U);
+        if (offset + size[bit] > rt.length)
+        {
+            return false;
+        }
+        const uint8_t* f = p + offset;
+        switch (bit)
+        {
+        case 1:
+            rt.fcs = (f[0] & 0x10) != 0;
+            break;
+        case 2:
+            rt.rateMbps = f[0] / 2.0;
+            rt.dsss = f[0] == 2 || f[0] == 4 || f[0] == 11 || f[0] == 22;
+            break;
+        case 5:
+            rt.rx = true;
+            break;
+        case 19: {
+            // HT: known, flags, mcs
+            unsigned bw = f[1] & 0x3;
+            bool sgi = (f[1] & 0x4) != 0;
+            unsigned nss = f[2] / 8 + 1;
+            rt.symbolUs = sgi ? 3.6 : 4.0;
+            rt.dataRateMbps = McsRate(bw == 1 ? 108 : 52, f[2] % 8, nss, rt.symbolUs);
+            rt.preambleUs = 32 + 4 * nss;
+            break;
+        }
+        case 20:
+            rt.ampdu = true;
+            rt.ampduRef = Le32(f);
+            break;
+        case 21: {
+            // VHT: known(2), flags, bandwidth, mcs_nss[4], ...
+            bool sgi = (f[2] & 0x4) != 0;
+            unsigned bw = f[3];
+            unsigned mcs = f[4] >> 4;
+            unsigned nss = f[4] & 0xf;
+            unsigned nsd = 52;
+            if (bw >= 1 && bw <= 3)
+            {
+                nsd = 108;
+            }
+            else if (bw >= 4 && bw <= 10)
+            {
+                nsd = 234;
+            }
+            else if (bw >= 11)
+            {
+                nsd = 468;
+            }
+            rt.symbolUs = sgi ? 3.6 : 4.0;
+            rt.dataRateMbps = McsRate(nsd, mcs, nss, rt.symbolUs);
+            rt.preambleUs = 36 + 4 * nss;
+            break;
+        }
+        case 23: {
+            // HE: data1..data6
+            uint16_t data1 = Le16(f);
+            uint16_t data3 = Le16(f + 4);
+            uint16_t data5 = Le16(f + 8);
+            uint16_t data6 = Le16(f + 10);
+            if (!(data1 & 0x0020))
+            {
+                break; // data MCS unknown
+            }
+            unsigned mcs = (data3 >> 8) & 0xf;
+            unsigned bw = (data1 & 0x4000) ? (data5 & 0xf) : 0;
+            unsigned gi = (data5 >> 4) & 0x3;
+            unsigned nss = std::max(1, data6 & 0xf);
+            static const unsigned heSubcarriers[4] = {234, 468, 980, 1960};
+            rt.symbolUs = 12.8 + (gi == 2 ? 3.2 : (gi == 1 ? 1.6 : 0.8));
+            rt.dataRateMbps = McsRate(bw < 4 ? heSubcarriers[bw] : 234, mcs, nss, rt.symbolUs);
+            rt.preambleUs = 36 + 8 * nss;
+            break;
+        }
+        default:
+            break;
+        }
+        offset += size[bit];
+    }
+    return true;
+}
+
+/**
+ * Estimate the airtime of a transmitted frame.
+ * \param rt The radiotap fields.
+ * \param psduBytes The PSDU length including the FCS.
+ * \param withPreamble Whether to count the preamble (first MPDU of an A-MPDU).
+ * \return the airtime in seconds, negative if it cannot be estimated.
+ */
+double
+Airtime(const Radiotap& rt, uint32_t psduBytes, bool withPreamble)
+{
+    double bits = 16 + 8.0 * psduBytes + 6;
+    if (rt.dataRateMbps > 0)
+    {
+        double ndbps = rt.dataRateMbps * rt.symbolUs;
+        double symbols = rt.ampdu ? bits / ndbps : std::ceil(bits / ndbps);
+        return ((withPreamble ? rt.preambleUs : 0) + symbols * rt.symbolUs) * 1e-6;
+    }
+    if (rt.rateMbps > 0)
+    {
+        if (rt.dsss)
+        {
+            return (192 + 8.0 * psduBytes / rt.rateMbps) * 1e-6;
+        }
+        return (20 + 4 * std::ceil(bits / (4 * rt.rateMbps))) * 1e-6;
+    }
+    return -1;
+}
+
+/**
+ * Classify a routing control payload and count it.
+ * \param r The file results.
+ * \param port The UDP port, or 0 for DSR.
+ * \param p The UDP payload (or DSR header).
+ * \param len Its length.
+ * \param bytes The IPv4 packet size.
+ * \return true if the payload was a control packet.
+ */
+bool
+CountControl(FileResult& r, uint16_t port, const uint8_t* p, uint32_t len, uint32_t bytes)
+{
+    if (port == OLSR_PORT)
+    {
+        // packet header (length, sequence), then messages
+        uint32_t offset = 4;
+        while (offset + 4 <= len)
+        {
+            uint8_t type = p[offset];
+            uint16_t size = Be16(p + offset + 2);
+            r.control[type >= 1 && type <= 4 ? OLSR_HELLO + type - 1 : OLSR_OTHER]++;
+            if (size < 4)
+            {
+                break;
+            }
+            offset += size;
+        }
+    }
+    else if (port == AODV_PORT)
+    {
+        uint8_t type = len > 0 ? p[0] : 0;
+        r.control[type >= 1 && type <= 4 ? AODV_RREQ + type - 1 : AODV_OTHER]++;
+    }
+    else if (port == DSDV_PORT)
+    {
+        r.control[DSDV_UPDATE]++;
+    }
+    else if (port == 0)
+    {
+        // ns-3 DSR fixed header: next header, message type, source id,
+        // destination id, payload length; followed by options
+        if (len < 8 || p[1] != 1)
+        {
+            return false; // data messages carry a source route only
+        }
+        uint32_t offset = 8;
+        Control kind = DSR_OTHER;
+        while (offset + 2 <= len)
+        {
+            uint8_t type = p[offset];
+            if (type == 224)
+            {
+                offset++; // Pad1
+                continue;
+            }
+            if (type == 0)
+            {
+                offset += 2 + p[offset + 1]; // PadN
+                continue;
+            }
+            switch (type)
+            {
+            case 1:
+                kind = DSR_RREQ;
+                break;
+            case 2:
+                kind = DSR_RREP;
+                break;
+            case 3:
+                kind = DSR_RERR;
+                break;
+            case 160:
+                kind = DSR_ACK_REQ;
+                break;
+            case 32:
+                kind = DSR_ACK;
+                break;
+            default:
+                kind = DSR_OTHER;
+                break;
+            }
+            break;
+        }
+        r.control[kind]++;
+    }
+    else
+    {
+        return false;
+    }
+    r.controlBytes += bytes;
+    return true;
+}
+
+/**
+ * Decode an IPv4 packet carried by a frame.
+ * \param r The file results.
+ * \param tx Whether the frame was transmitted by this node.
+ * \param time Capture time in seconds.
+ * \param p Start of the IPv4 header.
+ * \param len Bytes available.
+ * \param dataPort UDP port of the data traffic.
+ */
+void
+ParseIpv4(FileResult& r, bool tx, double time, const uint8_t* p, uint32_t len, uint16_t dataPort)
+{
+    if (len < 20 || (p[0] >> 4) != 4)
+    {
+        return;
+    }
+    uint32_t ihl = (p[0] & 0xf) * 4;
+    uint32_t total = std::min<uint32_t>(Be16(p + 2), len);
+    if (ihl < 20 || total < ihl)
+    {
+        return;
+    }
+    uint16_t id = Be16(p + 4);
+    uint8_t protocol = p[9];
+    uint32_t src = Be32(p + 12);
+    uint32_t dst = Be32(p + 16);
+    const uint8_t* l4 = p + ihl;
+    uint32_t l4len = total - ihl;
+
+    if (protocol == DSR_PROTOCOL)
+    {
+        if (tx && CountControl(r, 0, l4, l4len, total))
+        {
+            r.ownAddresses.insert(src);
+        }
+        // DSR data: the transport header follows the DSR header and options
+        if (l4len >= 8 && l4[0] == 17 && l4[1] == 2)
+        {
+            uint32_t dsrLen = 8 + Be16(l4 + 6);
+            if (dsrLen + 8 <= l4len && Be16(l4 + dsrLen + 2) == dataPort)
+            {
+                protocol = 17;
+                l4 += dsrLen;
+                l4len -= dsrLen;
+            }
+        }
+        if (protocol == DSR_PROTOCOL)
+        {
+            return;
+        }
+    }
+    if (protocol != 17 || l4len < 8)
+    {
+        return;
+    }
+    uint16_t dport = Be16(l4 + 2);
+    if (dport == dataPort)
+    {
+        DatagramKey key{src, dst, id};
+        r.firstSeen.emplace(key, time);
+        if (!tx)
+        {
+            r.rx.emplace_back(key, time);
+        }
+        return;
+    }
+    if (tx && CountControl(r, dport, l4 + 8, l4len - 8, total))
+    {
+        r.ownAddresses.insert(src);
+    }
+}
+
+/**
+ * Decode one 802.11 frame (after the radiotap header).
+ * \param r The file results.
+ * \param tx Whether the frame was transmitted by this node.
+ * \param time Capture time in seconds.
+ * \param p Start of the MAC header.
+ * \param len Bytes available, FCS excluded.
+ * \param dataPort UDP port of the data traffic.
+ */
+void
+ParseDot11(FileResult& r, bool tx, double time, const uint8_t* p, uint32_t len, uint16_t dataPort)
+{
+    if (len < 24)
+    {
+        return;
+    }
+    uint16_t fc = Le16(p);
+    unsigned type = (fc >> 2) & 0x3;
+    unsigned subtype = (fc >> 4) & 0xf;
+    if (type != 2 || (subtype & 0x4) || (fc & 0x4000))
+    {
+        return; // not a data frame with a payload, or encrypted
+    }
+    uint32_t hdr = 24;
+    if ((fc & 0x0300) == 0x0300)
+    {
+        hdr += 6;
+    }
+    bool amsdu = false;
+    if (subtype & 0x8)
+    {
+        if (hdr + 2 > len)
+        {
+            return;
+        }
+        amsdu = (p[hdr] & 0x80) != 0;
+        hdr += 2;
+        if (fc & 0x8000)
+        {
+            hdr += 4;
+        }
+    }
+    if (hdr > len)
+    {
+        return;
+    }
+
+    auto llc = [&](const uint8_t* q, uint32_t qlen) {
+        if (qlen < 8 || q[0] != 0xaa || q[1] != 0xaa || q[2] != 0x03)
+        {
+            return;
+        }
+        uint16_t etherType = Be16(q + 6);
+        if (etherType == 0x0800)
+        {
+            ParseIpv4(r, tx, time, q + 8, qlen - 8, dataPort);
+        }
+        else if (etherType == 0x0806 && tx && qlen >= 8 + 28)
+        {
+            r.ownAddresses.insert(Be32(q + 8 + 14)); // ARP sender protocol address
+        }
+    };
+
+    if (!amsdu)
+    {
+        llc(p + hdr, len - hdr);
+        return;
+    }
+    // A-MSDU subframes: DA, SA, length, MSDU, padded to 4 bytes
+    uint32_t offset = hdr;
+    while (offset + 14 <= len)
+    {
+        uint32_t msdu = Be16(p + offset + 12);
+        if (offset + 14 + msdu > len)
+        {
+            break;
+        }
+        llc(p + offset + 14, msdu);
+        offset += (14 + msdu + 3) & ~3U;
+    }
+}
+
+/**
+ * Extract the node id from a <prefix>-<node>-<device>.pcap file name.
+ * \param path The file path.
+ * \return the node id, -1 if the name does not follow the pattern.
+ */
+int
+NodeFromName(const std::string& path)
+{
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    std::size_t dot = name.rfind(".pcap");
+    std::size_t dev = name.rfind('-', dot);
+    if (dot == std::string::npos || dev == std::string::npos || dev == 0)
+    {
+        return -1;
+    }
+    std::size_t node = name.rfind('-', dev - 1);
+    if (node == std::string::npos)
+    {
+        return -1;
+    }
+    std::string id = name.substr(node + 1, dev - node - 1);
+    if (id.empty() || id.find_first_not_of("0123456789") != std::string::npos)
+    {
+        return -1;
+    }
+    return std::stoi(id);
+}
+
+/**
+ * Analyze one capture file.
+ * \param path The file.
+ * \param dataPort UDP port of the data traffic.
+ * \return the results.
+ */
+FileResult
+AnalyzeFile(const std::string& path, uint16_t dataPort)
+{
+    FileResult r;
+    r.path = path;
+    r.node = NodeFromName(path);
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        r.error = std::strerror(errno);
+        return r;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 24)
+    {
+        r.error = "not a pcap file";
+        close(fd);
+        return r;
+    }
+    std::size_t size = st.st_size;
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        r.error = std::strerror(errno);
+        return r;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+    const uint8_t* data = static_cast<const uint8_t*>(map);
+
+    uint32_t magic = Le32(data);
+    bool nano = magic == 0xa1b23c4d;
+    if ((magic != 0xa1b2c3d4 && !nano) || Le32(data + 20) != 127)
+    {
+        r.error = "not a little endian radiotap pcap file";
+        munmap(map, size);
+        return r;
+    }
+
+    bool haveAmpdu = false;
+    uint32_t lastAmpduRef = 0;
+    std::size_t offset = 24;
+    while (offset + 16 <= size)
+    {
+        const uint8_t* rec = data + offset;
+        double time = Le32(rec) + Le32(rec + 4) * (nano ? 1e-9 : 1e-6);
+        uint32_t caplen = Le32(rec + 8);
+        uint32_t origlen = Le32(rec + 12);
+        offset += 16;
+        if (offset + caplen > size)
+        {
+            break;
+        }
+        const uint8_t* frame = data + offset;
+        offset += caplen;
+
+        Radiotap rt;
+        // a corrupt original length would wrap the PSDU size around
+        if (!ParseRadiotap(frame, caplen, rt) || rt.length > origlen)
+        {
+            continue;
+        }
+        uint32_t psdu = origlen - rt.length;
+        uint32_t macLen = caplen - rt.length;
+        if (rt.fcs && macLen >= 4)
+        {
+            macLen -= 4;
+        }
+        bool tx = !rt.rx;
+        if (tx)
+        {
+            r.txFrames++;
+            r.txBytes += psdu;
+            bool first = !rt.ampdu || !haveAmpdu || rt.ampduRef != lastAmpduRef;
+            haveAmpdu = rt.ampdu;
+            lastAmpduRef = rt.ampduRef;
+            double airtime = Airtime(rt, psdu, first);
+            if (airtime < 0)
+            {
+                r.unknownRateFrames++;
+            }
+            else
+            {
+                r.airtime += airtime;
+            }
+        }
+        else
+        {
+            r.rxFrames++;
+        }
+        ParseDot11(r, tx, time, frame + rt.length, macLen, dataPort);
+    }
+    munmap(map, size);
+    return r;
+}
+
+/**
+ * Expand the command-line operands into a list of capture files.
+ * \param operands Files and directories.
+ * \return the capture files, sorted.
+ */
+std::vector<std::string>
+ExpandInputs(const std::vector<std::string>& operands)
+{
+    std::vector<std::string> files;
+    for (const auto& operand : operands)
+    {
+        struct stat st;
+        if (stat(operand.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+        {
+            DIR* dir = opendir(operand.c_str());
+            if (!dir)
+            {
+                continue;
+            }
+            while (struct dirent* entry = readdir(dir))
+            {
+                std::string name = entry->d_name;
+                if (name.size() > 5 && name.compare(name.size() - 5, 5, ".pcap") == 0)
+                {
+                    files.push_back(operand + "/" + name);
+                }
+            }
+            closedir(dir);
+        }
+        else
+        {
+            files.push_back(operand);
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    unsigned threads = 0;
+    uint16_t dataPort = 9;
+    std::string csvFile;
+    std::vector<std::string> operands;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        auto value = [&arg]() { return arg.substr(arg.find('=') + 1); };
+        if (arg.rfind("--threads=", 0) == 0)
+        {
+            threads = std::stoul(value());
+        }
+        else if (arg.rfind("--dataPort=", 0) == 0)
+        {
+            dataPort = static_cast<uint16_t>(std::stoul(value()));
+        }
+        else if (arg.rfind("--csv=", 0) == 0)
+        {
+            csvFile = value();
+        }
+        else if (arg == "--help" || arg.rfind("--", 0) == 0)
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [--threads=N] [--dataPort=9] [--csv=nodes.csv] <file-or-dir>..."
+                      << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+        else
+        {
+            operands.push_back(arg);
+        }
+    }
+
+    std::vector<std::string> files = ExpandInputs(operands);
+    if (files.empty())
+    {
+        std::cerr << "no capture files given" << std::endl;
+        return 1;
+    }
+    if (threads == 0)
+    {
+        threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+    threads = std::min<unsigned>(threads, files.size());
+
+    std::vector<FileResult> results(files.size());
+    std::atomic<std::size_t> next{0};
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++)
+    {
+        pool.emplace_back([&]() {
+            for (std::size_t i = next++; i < files.size(); i = next++)
+            {
+                results[i] = AnalyzeFile(files[i], dataPort);
+            }
+        });
+    }
+    for (auto& thread : pool)
+    {
+        thread.join();
+    }
+
+    // merge: first sighting anywhere, first reception at the destination
+    DatagramTimes firstSeen;
+    DatagramTimes delivered;
+    uint64_t control[CONTROL_COUNT]{};
+    uint64_t controlBytes = 0;
+    double airtime = 0;
+    for (const auto& r : results)
+    {
+        if (!r.error.empty())
+        {
+            std::cerr << r.path << ": " << r.error << std::endl;
+            continue;
+        }
+        for (const auto& entry : r.firstSeen)
+        {
+            auto it = firstSeen.emplace(entry.first, entry.second).first;
+            it->second = std::min(it->second, entry.second);
+        }
+        for (const auto& entry : r.rx)
+        {
+            if (r.ownAddresses.count(entry.first.dst))
+            {
+                auto it = delivered.emplace(entry.first, entry.second).first;
+                it->second = std::min(it->second, entry.second);
+            }
+        }
+        for (int c = 0; c < CONTROL_COUNT; c++)
+        {
+            control[c] += r.control[c];
+        }
+        controlBytes += r.controlBytes;
+        airtime += r.airtime;
+    }
+
+    std::vector<double> delays;
+    delays.reserve(delivered.size());
+    for (const auto& entry : delivered)
+    {
+        auto it = firstSeen.find(entry.first);
+        if (it != firstSeen.end() && entry.second >= it->second)
+        {
+            delays.push_back(entry.second - it->second);
+        }
+    }
+    std::sort(delays.begin(), delays.end());
+    auto percentile = [&delays](double q) {
+        return delays.empty() ? 0.0 : delays[static_cast<std::size_t>(q * (delays.size() - 1))];
+    };
+    double meanDelay = 0;
+    for (double d : delays)
+    {
+        meanDelay += d;
+    }
+    meanDelay = delays.empty() ? 0 : meanDelay / delays.size();
+    uint64_t controlPackets = 0;
+    for (int c = 0; c < CONTROL_COUNT; c++)
+    {
+        controlPackets += control[c];
+    }
+
+    std::cout << "captures:              " << files.size() << " (" << threads << " threads)\n";
+    std::cout << "data datagrams seen:   " << firstSeen.size() << "\n";
+    std::cout << "data datagrams recv:   " << delivered.size() << "\n";
+    std::cout << "PDR:                   "
+              << (firstSeen.empty() ? 0.0
+                                    : static_cast<double>(delivered.size()) / firstSeen.size())
+              << "\n";
+    std::cout << "delay mean/p50/p99 (s): " << meanDelay << " / " << percentile(0.5) << " / "
+              << percentile(0.99) << "\n";
+    std::cout << "control packets:       " << controlPackets << " (" << controlBytes
+              << " bytes)\n";
+    std::cout << "normalized routing load: "
+              << (delivered.empty() ? 0.0 : static_cast<double>(controlPackets) / delivered.size())
+              << "\n";
+    for (int c = 0; c < CONTROL_COUNT; c++)
+    {
+        if (control[c])
+        {
+            std::cout << "  " << std::left << std::setw(16) << g_controlNames[c] << control[c]
+                      << "\n";
+        }
+    }
+    std::cout << "total airtime (s):     " << airtime << std::endl;
+
+    if (!csvFile.empty())
+    {
+        std::ofstream out(csvFile);
+        out << "File,Node,TxFrames,RxFrames,TxBytes,AirtimeSeconds,UnknownRateFrames,"
+               "ControlPackets,ControlBytes\n";
+        for (const auto& r : results)
+        {
+            if (!r.error.empty())
+            {
+                continue;
+            }
+            uint64_t packets = 0;
+            for (int c = 0; c < CONTROL_COUNT; c++)
+            {
+                packets += r.control[c];
+            }
+            out << r.path << "," << r.node << "," << r.txFrames << "," << r.rxFrames << ","
+                << r.txBytes << "," << r.airtime << "," << r.unknownRateFrames << "," << packets
+                << "," << r.controlBytes << "\n";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef RECEIVE_STATS_H
+#define RECEIVE_STATS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Receive statistics for the UDP sinks of an experiment.
+ *
+ * Keeps plain (non-atomic, the simulator is single threaded) counters per
+ * sink node and per source IPv4 address, together with the first and last
+ * arrival times.  Recording a packet does no formatting; Record() tells the
+ * caller when a packet has been picked by the 1-in-N log sampler so that
+ * human readable output stays opt-in.
+ */
+class ReceiveStats
+{
+  public:
+    /// Counters of one sink or one source.
+    struct Counters
+    {
+        uint64_t packets{0};       //!< Packets received.
+        uint64_t bytes{0};         //!< Bytes received.
+        double firstArrival{-1.0}; //!< Time of the first packet, -1 if none.
+        double lastArrival{-1.0};  //!< Time of the last packet, -1 if none.
+    };
+
+    /**
+     * Register a sink.
+     * \param nodeId The id of the node that owns the sink socket.
+     */
+    void AddSink(uint32_t nodeId);
+    /**
+     * Enable per-packet logging of one packet out of every N.
+     * \param every The sampling period, 0 to disable logging.
+     */
+    void SetLogSampling(uint32_t every);
+    /**
+     * Account for a received packet.
+     * \param nodeId The receiving node.
+     * \param source The sender IPv4 address in host order, 0 if unknown.
+     * \param bytes The packet size.
+     * \param now The arrival time in seconds.
+     * \return true if this packet should be logged.
+     */
+    bool Record(uint32_t nodeId, uint32_t source, uint32_t bytes, double now);
+    /**
+     * \return the total number of packets received by all sinks.
+     */
+    uint64_t GetTotalPackets() const;
+    /**
+     * Write the per-sink and per-source counters as CSV, the sinks by node
+     * id and the sources by address.
+     * \param fileName The output file name.
+     */
+    void WriteCsv(const std::string& fileName) const;
+
+  private:
+    /**
+     * Update a set of counters.
+     * \param c The counters.
+     * \param bytes The packet size.
+     * \param now The arrival time.
+     */
+    static void Update(Counters& c, uint32_t bytes, double now);
+
+    std::vector<Counters> m_sinks;                    //!< Per-sink counters, by node id.
+    std::vector<bool> m_isSink;                       //!< Whether a node id is a sink.
+    std::unordered_map<uint32_t, Counters> m_sources; //!< Per-source counters.
+    uint64_t m_total{0};                              //!< Packets received.
+    uint32_t m_logEvery{0};                           //!< Log sampling period.
+    uint32_t m_logCountdown{0};                       //!< Packets until the next logged one.
+};
+
+inline void
+ReceiveStats::AddSink(uint32_t nodeId)
+{
+    if (nodeId >= m_sinks.size())
+    {
+        m_sinks.resize(nodeId + 1);
+        m_isSink.resize(nodeId + 1, false);
+    }
+    m_isSink[nodeId] = true;
+}
+
+inline void
+ReceiveStats::SetLogSampling(uint32_t every)
+{
+    m_logEvery = every;
+    m_logCountdown = 0;
+}
+
+inline void
+ReceiveStats::Update(Counters& c, uint32_t bytes, double now)
+{
+    c.packets++;
+    c.bytes += bytes;
+    if (c.firstArrival < 0)
+    {
+        c.firstArrival = now;
+    }
+    c.lastArrival = now;
+}
+
+inline bool
+ReceiveStats::Record(uint32_t nodeId, uint32_t source, uint32_t bytes, double now)
+{
+    if (nodeId >= m_sinks.size())
+    {
+        AddSink(nodeId);
+    }
+    Update(m_sinks[nodeId], bytes, now);
+    Update(m_sources[source], bytes, now);
+    m_total++;
+
+    if (m_logEvery == 0)
+    {
+        return false;
+    }
+    if (m_logCountdown == 0)
+    {
+        m_logCountdown = m_logEvery - 1;
+        return true;
+    }
+    m_logCountdown--;
+    return false;
+}
+
+inline uint64_t
+ReceiveStats::GetTotalPackets() const
+{
+    return m_total;
+}
+
+inline void
+ReceiveStats::WriteCsv(const std::string& fileName) const
+{
+    std::ofstream out(fileName);
+    out << "Kind,Id,Packets,Bytes,FirstArrival,LastArrival\n";
+    for (std::size_t i = 0; i < m_sinks.size(); i++)
+    {
+        if (!m_isSink[i])
+        {
+            continue;
+        }
+        const Counters& c = m_sinks[i];
+        out << "sink," << i << "," << c.packets << "," << c.bytes << "," << c.firstArrival << ","
+            << c.lastArrival << "\n";
+    }
+    // the map is in hash order, which varies between library versions
+    std::vector<uint32_t> sources;
+    sources.reserve(m_sources.size());
+    for (const auto& entry : m_sources)
+    {
+        sources.push_back(entry.first);
+    }
+    std::sort(sources.begin(), sources.end());
+    for (uint32_t a : sources)
+    {
+        const Counters& c = m_sources.at(a);
+        out << "source," << ((a >> 24) & 0xff) << "." << ((a >> 16) & 0xff) << "."
+            << ((a >> 8) & 0xff) << "." << (a & 0xff) << "," << c.packets << "," << c.bytes << ","
+            << c.firstArrival << "," << c.lastArrival << "\n";
+    }
+}
+
+#endif /* RECEIVE_STATS_H */
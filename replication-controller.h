@@ -0,0 +1,497 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef REPLICATION_CONTROLLER_H
+#define REPLICATION_CONTROLLER_H
+
+#include "fork-pool.h"
+#include "payload-timestamp.h"
+
+#include "ns3/address.h"
+#include "ns3/application-container.h"
+#include "ns3/assert.h"
+#include "ns3/fatal-error.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * The key performance indicators of a run, as used by the replication
+ * controller: throughput (kbit/s over the traffic period), packet delivery
+ * ratio and mean end-to-end delay (s).
+ *
+ * The delay is the age of the time stamp that starts the payload: the
+ * SeqTsHeader of UdpClient and MultiFlowSender packets, or the
+ * SeqTsSizeHeader that AddSources() makes OnOffApplications send (see
+ * payload-timestamp.h).  The two do not share a layout, so the sources of
+ * one probe must all send the same one.  A packet tag added in the Tx trace
+ * would not do: the sources fire it after the socket has copied the packet
+ * down the stack.
+ */
+class KpiProbe
+{
+  public:
+    /**
+     * \return the names of the values returned by GetKpis().
+     */
+    static std::vector<std::string> GetKpiNames();
+
+    /**
+     * Count the packets of these sources, and make the OnOffApplications
+     * among them send a SeqTsSizeHeader.  Mixing them with sources that
+     * send a SeqTsHeader is a fatal error.
+     * \param apps The source applications.
+     */
+    void AddSources(const ApplicationContainer& apps);
+    /**
+     * Account for a packet delivered to a sink.
+     * \param packet The packet.
+     */
+    void Receive(Ptr<const Packet> packet);
+    /**
+     * Receive() with the signature of the PacketSink Rx trace.
+     * \param packet The packet.
+     * \param from The sender address.
+     */
+    void ReceiveFrom(Ptr<const Packet> packet, const Address& from);
+
+    /**
+     * \param duration The traffic period.
+     * \return the throughput, delivery ratio and mean delay.
+     */
+    std::vector<double> GetKpis(Time duration) const;
+
+  private:
+    /**
+     * Tx trace sink of the sources.
+     * \param packet The packet sent.
+     */
+    void Transmit(Ptr<const Packet> packet);
+
+    uint64_t m_txPackets{0}; //!< Packets sent.
+    uint64_t m_rxPackets{0}; //!< Packets received.
+    uint64_t m_rxBytes{0};   //!< Bytes received.
+    uint64_t m_delayed{0};   //!< Received packets with a time stamp.
+    double m_delaySum{0};    //!< Sum of their delays in seconds.
+    int m_sizeHeader{-1};    //!< Sources send a SeqTsSizeHeader, -1 before any.
+};
+
+/**
+ * Sequential replication of one configuration until its KPIs are known
+ * precisely enough.
+ *
+ * Replications run in forked workers (see ForkPool) with consecutive RngRun
+ * values and send their KPIs back through a pipe.  Each time one finishes
+ * the Student t confidence interval of every KPI is updated; once at least
+ * minRuns replications are in and the half-width of every interval is at
+ * most relativeHalfWidth times the magnitude of its mean, no more are
+ * started.  A configuration that never gets there stops at maxRuns.
+ * Replications that were already running when the target was reached are
+ * still included.
+ */
+class ReplicationController
+{
+  public:
+    /**
+     * A replication; runs in the worker process.
+     * \param run The RngRun value to use.
+     * \return its KPIs, in the order of the names.
+     */
+    using Replication = std::function<std::vector<double>(uint32_t run)>;
+
+    /// The outcome of the replications of a configuration.
+    struct Summary
+    {
+        std::vector<uint32_t> runs;       //!< RngRun of the successful replications.
+        std::vector<uint32_t> failedRuns; //!< RngRun of the failed ones.
+        std::vector<double> mean;         //!< Mean of each KPI.
+        std::vector<double> halfWidth;    //!< Confidence interval half-width of each KPI.
+        bool converged{false};            //!< Every interval is narrow enough.
+    };
+
+    /**
+     * \param kpiNames The KPI names.
+     * \param relativeHalfWidth The target half-width, relative to the mean.
+     * \param confidence The confidence level of the intervals.
+     * \param minRuns The minimum number of replications.
+     * \param maxRuns The maximum number of replications.
+     * \param jobs Concurrent workers, 0 for one per core.
+     */
+    ReplicationController(const std::vector<std::string>& kpiNames,
+                          double relativeHalfWidth,
+                          double confidence = 0.95,
+                          uint32_t minRuns = 5,
+                          uint32_t maxRuns = 30,
+                          unsigned jobs = 0);
+
+    /**
+     * Replicate a configuration.
+     * \param firstRun The RngRun of the first replication.
+     * \param replication The replication.
+     * \return the summary.
+     */
+    Summary Run(uint32_t firstRun, Replication replication) const;
+
+    /**
+     * Print a summary as a single replication-report line.
+     * \param os The output stream.
+     * \param label The configuration.
+     * \param summary Its summary.
+     */
+    void PrintSummary(std::ostream& os, const std::string& label, const Summary& summary) const;
+
+    /**
+     * \param p A probability, in (0, 1).
+     * \param dof The degrees of freedom, at least 1.
+     * \return the p quantile of the Student t distribution.
+     */
+    static double StudentQuantile(double p, unsigned dof);
+
+  private:
+    /**
+     * Continued fraction of the regularized incomplete beta function.
+     * \param a First shape parameter.
+     * \param b Second shape parameter.
+     * \param x The point, in [0, 1].
+     * \return the fraction.
+     */
+    static double BetaFraction(double a, double b, double x);
+    /**
+     * \param t A point.
+     * \param dof The degrees of freedom.
+     * \return the Student t distribution function at t.
+     */
+    static double StudentCdf(double t, unsigned dof);
+
+    /**
+     * Recompute the statistics of a summary.
+     * \param samples The KPIs of the successful replications.
+     * \param summary The summary.
+     */
+    void Update(const std::vector<std::vector<double>>& samples, Summary& summary) const;
+
+    std::vector<std::string> m_kpiNames; //!< KPI names.
+    double m_relativeHalfWidth;          //!< Target relative half-width.
+    double m_confidence;                 //!< Confidence level.
+    uint32_t m_minRuns;                  //!< Minimum replications.
+    uint32_t m_maxRuns;                  //!< Maximum replications.
+    unsigned m_jobs;                     //!< Concurrent workers.
+};
+
+inline std::vector<std::string>
+KpiProbe::GetKpiNames()
+{
+    return {"throughputKbps", "deliveryRatio", "delaySeconds"};
+}
+
+inline void
+KpiProbe::AddSources(const ApplicationContainer& apps)
+{
+    for (auto it = apps.Begin(); it != apps.End(); ++it)
+    {
+        int sizeHeader = EnablePayloadTimestamp(*it);
+        if (m_sizeHeader != -1 && m_sizeHeader != sizeHeader)
+        {
+            NS_FATAL_ERROR("KpiProbe sources must all send the same time stamp header");
+        }
+        m_sizeHeader = sizeHeader;
+        (*it)->TraceConnectWithoutContext("Tx", MakeCallback(&KpiProbe::Transmit, this));
+    }
+}
+
+inline void
+KpiProbe::Transmit(Ptr<const Packet> /* packet */)
+{
+    m_txPackets++;
+}
+
+inline void
+KpiProbe::Receive(Ptr<const Packet> packet)
+{
+    m_rxPackets++;
+    m_rxBytes += packet->GetSize();
+    Time ts;
+    if (PeekPayloadTimestamp(packet, m_sizeHeader == 1, ts))
+    {
+        double delay = (Simulator::Now() - ts).GetSeconds();
+        // a negative age means the probe read the wrong header
+        NS_ASSERT_MSG(delay >= 0, "Packet stamped in the future: " << ts);
+        m_delayed++;
+        m_delaySum += delay;
+    }
+}
+
+inline void
+KpiProbe::ReceiveFrom(Ptr<const Packet> packet, const Address& /* from */)
+{
+    Receive(packet);
+}
+
+inline std::vector<double>
+KpiProbe::GetKpis(Time duration) const
+{
+    double seconds = duration.GetSeconds();
+    return {seconds > 0 ? m_rxBytes * 8.0 / 1000 / seconds : 0.0,
+            m_txPackets ? double(m_rxPackets) / m_txPackets : 0.0,
+            m_delayed ? m_delaySum / m_delayed : 0.0};
+}
+
+inline ReplicationController::ReplicationController(const std::vector<std::string>& kpiNames,
+                                                    double relativeHalfWidth,
+                                                    double confidence,
+                                                    uint32_t minRuns,
+                                                    uint32_t maxRuns,
+                                                    unsigned jobs)
+    : m_kpiNames(kpiNames),
+      m_relativeHalfWidth(relativeHalfWidth),
+      m_confidence(confidence),
+      m_minRuns(std::max<uint32_t>(minRuns, 2)),
+      m_maxRuns(std::max(maxRuns, std::max<uint32_t>(minRuns, 2))),
+      m_jobs(jobs)
+{
+    NS_ASSERT_MSG(confidence > 0 && confidence < 1, "The confidence must be in (0, 1)");
+}
+
+inline double
+ReplicationController::BetaFraction(double a, double b, double x)
+{
+    // modified Lentz evaluation
+    const double tiny = 1e-300;
+    double c = 1;
+    double d = 1 - (a + b) * x / (a + 1);
+    d = 1 / (std::fabs(d) < tiny ? tiny : d);
+    double h = d;
+    for (int m = 1; m <= 300; m++)
+    {
+        for (int step = 0; step < 2; step++)
+        {
+            double num = step == 0 ? m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m))
+                                   : -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1));
+            d = 1 + num * d;
+            d = 1 / (std::fabs(d) < tiny ? tiny : d);
+            c = 1 + num / c;
+            c = std::fabs(c) < tiny ? tiny : c;
+            h *= d * c;
+            if (step == 1 && std::fabs(d * c - 1) < 1e-12)
+            {
+                return h;
+            }
+        }
+    }
+    return h;
+}
+
+inline double
+ReplicationController::StudentCdf(double t, unsigned dof)
+{
+    double v = dof;
+    double x = v / (v + t * t);
+    double a = v / 2;
+    double b = 0.5;
+    // regularized incomplete beta I_x(a, b), using the symmetry relation
+    // where the continued fraction converges slowly
+    double front =
+        std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) +
+                 b * std::log1p(-x));
+    double beta = x < (a + 1) / (a + b + 2) ? front * BetaFraction(a, b, x) / a
+                                            : 1 - front * BetaFraction(b, a, 1 - x) / b;
+    double tail = beta / 2;
+    return t >= 0 ? 1 - tail : tail;
+}
+
+inline double
+ReplicationController::StudentQuantile(double p, unsigned dof)
+{
+    NS_ASSERT(p > 0 && p < 1 && dof > 0);
+    // the distribution function is monotonic: bisect
+    double lo = -1e3;
+    double hi = 1e3;
+    for (int i = 0; i < 100; i++)
+    {
+        double mid = (lo + hi) / 2;
+        (StudentCdf(mid, dof) < p ? lo : hi) = mid;
+    }
+    return (lo + hi) / 2;
+}
+
+inline void
+ReplicationController::Update(const std::vector<std::vector<double>>& samples,
+                              Summary& summary) const
+{
+    std::size_t n = samples.size();
+    std::size_t k = m_kpiNames.size();
+    summary.mean.assign(k, 0);
+    summary.halfWidth.assign(k, 0);
+    summary.converged = false;
+    if (n == 0)
+    {
+        return;
+    }
+    double t = n > 1 ? StudentQuantile((1 + m_confidence) / 2, n - 1) : 0;
+    bool narrow = true;
+    for (std::size_t j = 0; j < k; j++)
+    {
+        double sum = 0;
+        for (const auto& sample : samples)
+        {
+            sum += sample[j];
+        }
+        double mean = sum / n;
+        double squares = 0;
+        for (const auto& sample : samples)
+        {
+            squares += (sample[j] - mean) * (sample[j] - mean);
+        }
+        summary.mean[j] = mean;
+        summary.halfWidth[j] = n > 1 ? t * std::sqrt(squares / (n - 1) / n) : 0;
+        narrow = narrow && summary.halfWidth[j] <= m_relativeHalfWidth * std::fabs(mean);
+    }
+    summary.converged = n >= m_minRuns && narrow;
+}
+
+inline ReplicationController::Summary
+ReplicationController::Run(uint32_t firstRun, Replication replication) const
+{
+    std::size_t k = m_kpiNames.size();
+    Summary summary;
+    std::vector<std::vector<double>> samples;
+    /// A started replication.
+    struct Pending
+    {
+        uint32_t run; //!< Its RngRun.
+        int readFd;   //!< Read end of its pipe.
+        int writeFd;  //!< Write end, until the parent has closed it.
+    };
+
+    std::map<std::size_t, Pending> pending; // by job id
+    ForkPool pool(m_jobs, [&](std::size_t id, int status) {
+        auto it = pending.find(id);
+        if (it == pending.end())
+        {
+            return;
+        }
+        uint32_t run = it->second.run;
+        int fd = it->second.readFd;
+        if (it->second.writeFd != -1)
+        {
+            // the fork failed, called from within Start()
+            close(it->second.writeFd);
+        }
+        pending.erase(it);
+
+        // the worker has exited, so this does not block
+        std::vector<double> kpis(k);
+        std::size_t want = k * sizeof(double);
+        std::size_t got = 0;
+        ssize_t r = 0;
+        while (got < want &&
+               (r = read(fd, reinterpret_cast<char*>(kpis.data()) + got, want - got)) > 0)
+        {
+            got += r;
+        }
+        close(fd);
+        if (status != 0 || got != want)
+        {
+            summary.failedRuns.push_back(run);
+            return;
+        }
+        summary.runs.push_back(run);
+        samples.push_back(kpis);
+        Update(samples, summary);
+    });
+
+    for (uint32_t run = firstRun; run < firstRun + m_maxRuns; run++)
+    {
+        // only start a replication when a slot is free, so that the
+        // decision to start it sees every result that came in
+        while (pool.GetRunning() >= pool.GetMaxWorkers())
+        {
+            pool.WaitOne();
+        }
+        if (summary.converged)
+        {
+            break;
+        }
+        int fds[2];
+        if (pipe(fds) != 0)
+        {
+            std::perror("pipe");
+            break;
+        }
+        // registered first, as a failed fork reports from within Start()
+        pending[pool.GetNextId()] = Pending{run, fds[0], fds[1]};
+        std::size_t id = pool.Start([&, fds, run]() {
+            close(fds[0]);
+            std::vector<double> kpis = replication(run);
+            if (kpis.size() != k)
+            {
+                return 1;
+            }
+            const char* data = reinterpret_cast<const char*>(kpis.data());
+            std::size_t left = k * sizeof(double);
+            ssize_t w = 0;
+            while (left > 0 && (w = write(fds[1], data, left)) > 0)
+            {
+                data += w;
+                left -= w;
+            }
+            close(fds[1]);
+            return left == 0 ? 0 : 1;
+        });
+        // the next worker must not inherit the write end, or a failed one
+        // would never deliver end of file
+        auto it = pending.find(id);
+        if (it != pending.end())
+        {
+            close(fds[1]);
+            it->second.writeFd = -1;
+        }
+    }
+    pool.WaitAll();
+    return summary;
+}
+
+inline void
+ReplicationController::PrintSummary(std::ostream& os,
+                                    const std::string& label,
+                                    const Summary& summary) const
+{
+    os << "replication-report config=" << label << " runs=" << summary.runs.size()
+       << " failed=" << summary.failedRuns.size() << " converged=" << summary.converged
+       << " confidence=" << m_confidence;
+    for (std::size_t j = 0; j < summary.mean.size(); j++)
+    {
+        os << " " << m_kpiNames[j] << "=" << summary.mean[j] << "+-" << summary.halfWidth[j];
+    }
+    os << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* REPLICATION_CONTROLLER_H */
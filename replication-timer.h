@@ -0,0 +1,179 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef REPLICATION_TIMER_H
+#define REPLICATION_TIMER_H
+
+#include "ns3/ipv4-address-generator.h"
+#include "ns3/ipv6-address-generator.h"
+#include "ns3/mac48-address.h"
+#include "ns3/rng-seed-manager.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Reset the process-wide state that Simulator::Destroy() leaves behind, so
+ * that the next replication in the same process builds the same network as
+ * a fresh process would.  Destroy() already empties the node and channel
+ * lists, so node ids start from 0 again.  The rest is not tied to the
+ * simulator: the address generators, which reject duplicate addresses, the
+ * MAC address counter, and the index of the next automatically assigned
+ * random variable stream, which would otherwise give the replication
+ * different streams than a fresh process.
+ */
+inline void
+ResetReplicationState()
+{
+    Ipv4AddressGenerator::Reset();
+    Ipv6AddressGenerator::Reset();
+    Mac48Address::ResetAllocationIndex();
+    RngSeedManager::ResetNextStreamIndex();
+}
+
+/**
+ * Wall clock timing of back-to-back replications in one process, split
+ * into building the scenario, Simulator::Run(), and the teardown
+ * (collecting the results and Simulator::Destroy()).
+ *
+ * Build and teardown are the per-replication overhead.  The first
+ * replication also pays the one-time costs that the later ones reuse (the
+ * TypeId and attribute lookups, the packet buffer free list, the
+ * dynamically loaded modules), so it is reported apart from the mean.
+ */
+class ReplicationTimer
+{
+  public:
+    /**
+     * Call when a replication starts building.
+     */
+    void Begin();
+    /**
+     * Call right before Simulator::Run().
+     */
+    void Built();
+    /**
+     * Call right after Simulator::Run().
+     */
+    void Ran();
+    /**
+     * Call after Simulator::Destroy().
+     */
+    void End();
+
+    /**
+     * Print one replication-timing line per replication and a
+     * replication-overhead summary line.
+     * \param os The output stream.
+     */
+    void PrintReport(std::ostream& os) const;
+
+  private:
+    /// Wall clock seconds of the phases of a replication.
+    struct Phases
+    {
+        double build{0};    //!< Scenario construction.
+        double run{0};      //!< Simulator::Run().
+        double teardown{0}; //!< Results and Simulator::Destroy().
+    };
+
+    /**
+     * \return the seconds since the previous mark, and mark now.
+     */
+    double Lap();
+
+    std::vector<Phases> m_phases;                 //!< By replication.
+    std::chrono::steady_clock::time_point m_mark; //!< Previous mark.
+};
+
+inline double
+ReplicationTimer::Lap()
+{
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> lap = now - m_mark;
+    m_mark = now;
+    return lap.count();
+}
+
+inline void
+ReplicationTimer::Begin()
+{
+    m_phases.emplace_back();
+    Lap();
+}
+
+inline void
+ReplicationTimer::Built()
+{
+    m_phases.back().build = Lap();
+}
+
+inline void
+ReplicationTimer::Ran()
+{
+    m_phases.back().run = Lap();
+}
+
+inline void
+ReplicationTimer::End()
+{
+    m_phases.back().teardown = Lap();
+}
+
+inline void
+ReplicationTimer::PrintReport(std::ostream& os) const
+{
+    double build = 0;
+    double run = 0;
+    double teardown = 0;
+    for (std::size_t i = 0; i < m_phases.size(); i++)
+    {
+        const Phases& p = m_phases[i];
+        os << "replication-timing replication=" << i << " buildSeconds=" << p.build
+           << " runSeconds=" << p.run << " teardownSeconds=" << p.teardown << std::endl;
+        if (i > 0)
+        {
+            build += p.build;
+            run += p.run;
+            teardown += p.teardown;
+        }
+    }
+    if (m_phases.empty())
+    {
+        return;
+    }
+    std::size_t n = m_phases.size() - 1;
+    const Phases& first = m_phases.front();
+    os << "replication-overhead replications=" << m_phases.size()
+       << " firstBuildSeconds=" << first.build << " firstTeardownSeconds=" << first.teardown;
+    if (n > 0)
+    {
+        double total = build + run + teardown;
+        os << " meanBuildSeconds=" << build / n << " meanRunSeconds=" << run / n
+           << " meanTeardownSeconds=" << teardown / n
+           << " overheadShare=" << (total > 0 ? (build + teardown) / total : 0.0);
+    }
+    os << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* REPLICATION_TIMER_H */
@@ -0,0 +1,326 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "ns3/global-value.h"
+#include "ns3/string.h"
+#include "ns3/type-id.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Content-addressed store of run results.
+ *
+ * The key of a run is a 64-bit FNV-1a hash over everything that decides its
+ * outcome:
+ * - the run parameters, as a canonical key=value text given by the caller
+ *   (the command-line values that matter, and the RngRun);
+ * - the initial value of every attribute of every registered TypeId, which
+ *   is where Config::SetDefault() and --ns3::Type::Attribute=value land;
+ * - every GlobalValue but RngRun (RngSeed, the scheduler type...);
+ * - the build id: path, size and modification time of the program and of
+ *   the ns-3 libraries it has loaded, so a rebuild misses the cache.
+ *
+ * An entry is a set of files in the cache directory: <key>.kpi, with the
+ * parameter text and the KPIs, and one <key>.<name> copy of each output
+ * file of the run (its throughput time series, its side outputs), which a
+ * hit copies back to where the run would have written them.  Entries are
+ * written to a temporary name and renamed, so concurrent workers never see
+ * half an entry.
+ */
+class ResultCache
+{
+  public:
+    /// The output files of a run: name in the entry, and path.
+    using Outputs = std::vector<std::pair<std::string, std::string>>;
+
+    /**
+     * \param directory The cache directory, created if needed; empty to
+     * disable the cache.
+     */
+    explicit ResultCache(const std::string& directory);
+
+    /**
+     * \return true if a directory was given.
+     */
+    bool IsEnabled() const;
+
+    /**
+     * \param parameters The canonical run parameters.
+     * \return the key of the run, as 16 hex digits.
+     */
+    std::string MakeKey(const std::string& parameters) const;
+
+    /**
+     * Look a run up, and on a hit copy its output files.
+     * \param key The key of the run.
+     * \param kpis Set to its KPIs on a hit.
+     * \param outputs Where to copy its output files on a hit; a miss if
+     * the entry lacks any of them.
+     * \return true on a hit.
+     */
+    bool Lookup(const std::string& key, std::vector<double>& kpis, const Outputs& outputs) const;
+
+    /**
+     * Store the results of a run.
+     * \param key The key of the run.
+     * \param parameters Its parameters, kept for reference.
+     * \param kpis Its KPIs.
+     * \param outputs Its output files.
+     */
+    void Store(const std::string& key,
+               const std::string& parameters,
+               const std::vector<double>& kpis,
+               const Outputs& outputs) const;
+
+    /**
+     * FNV-1a hash.
+     * \param data The data.
+     * \param hash The hash so far.
+     * \return the hash.
+     */
+    static uint64_t Hash(const std::string& data, uint64_t hash = 14695981039346656037ULL);
+
+    /**
+     * \return the attribute initial values and the global values, one per line.
+     */
+    static std::string DescribeDefaults();
+
+    /**
+     * \return the build id text, one loaded file per line.
+     */
+    static std::string DescribeBuild();
+
+  private:
+    /**
+     * Copy a file.
+     * \param from The source.
+     * \param to The destination.
+     * \return true on success.
+     */
+    static bool CopyFile(const std::string& from, const std::string& to);
+
+    std::string m_directory; //!< Cache directory, empty if disabled.
+};
+
+inline ResultCache::ResultCache(const std::string& directory)
+    : m_directory(directory)
+{
+    if (!m_directory.empty())
+    {
+        mkdir(m_directory.c_str(), 0777);
+    }
+}
+
+inline bool
+ResultCache::IsEnabled() const
+{
+    return !m_directory.empty();
+}
+
+inline uint64_t
+ResultCache::Hash(const std::string& data, uint64_t hash)
+{
+    for (unsigned char c : data)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+inline std::string
+ResultCache::DescribeDefaults()
+{
+    std::ostringstream os;
+    for (uint16_t i = 0; i < TypeId::GetRegisteredN(); i++)
+    {
+        TypeId tid = TypeId::GetRegistered(i);
+        for (std::size_t j = 0; j < tid.GetAttributeN(); j++)
+        {
+            TypeId::AttributeInformation info = tid.GetAttribute(j);
+            std::string type = info.checker->GetValueTypeName();
+            // these hold object identities, whose text is an address
+            if (type == "ns3::CallbackValue" || type == "ns3::PointerValue" ||
+                type == "ns3::ObjectPtrContainerValue")
+            {
+                continue;
+            }
+            os << tid.GetName() << "::" << info.name << "="
+               << info.initialValue->SerializeToString(info.checker) << "\n";
+        }
+    }
+    for (auto it = GlobalValue::Begin(); it != GlobalValue::End(); ++it)
+    {
+        if ((*it)->GetName() == "RngRun")
+        {
+            continue;
+        }
+        StringValue value;
+        (*it)->GetValue(value);
+        os << "global::" << (*it)->GetName() << "=" << value.Get() << "\n";
+    }
+    return os.str();
+}
+
+inline std::string
+ResultCache::DescribeBuild()
+{
+    std::set<std::string> files;
+    char exe[4096];
+    ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (n > 0)
+    {
+        files.insert(std::string(exe, n));
+    }
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line))
+    {
+        std::size_t slash = line.find('/');
+        if (slash != std::string::npos && line.find("libns3", slash) != std::string::npos)
+        {
+            files.insert(line.substr(slash));
+        }
+    }
+    std::ostringstream os;
+    for (const auto& file : files)
+    {
+        struct stat st;
+        if (stat(file.c_str(), &st) == 0)
+        {
+            os << file << " " << st.st_size << " " << st.st_mtim.tv_sec << "."
+               << st.st_mtim.tv_nsec << "\n";
+        }
+    }
+    return os.str();
+}
+
+inline std::string
+ResultCache::MakeKey(const std::string& parameters) const
+{
+    // the defaults and the build do not change within a process
+    static const uint64_t base = Hash(DescribeBuild(), Hash(DescribeDefaults()));
+    std::ostringstream os;
+    os << std::hex << std::setw(16) << std::setfill('0') << Hash(parameters, base);
+    return os.str();
+}
+
+inline bool
+ResultCache::CopyFile(const std::string& from, const std::string& to)
+{
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary);
+    if (!in || !out)
+    {
+        return false;
+    }
+    out << in.rdbuf();
+    return static_cast<bool>(out);
+}
+
+inline bool
+ResultCache::Lookup(const std::string& key,
+                    std::vector<double>& kpis,
+                    const Outputs& outputs) const
+{
+    if (!IsEnabled())
+    {
+        return false;
+    }
+    std::ifstream in(m_directory + "/" + key + ".kpi");
+    if (!in)
+    {
+        return false;
+    }
+    std::vector<double> values;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.rfind("kpi ", 0) == 0)
+        {
+            values.push_back(std::stod(line.substr(line.rfind(' ') + 1)));
+        }
+    }
+    for (const auto& output : outputs)
+    {
+        if (!CopyFile(m_directory + "/" + key + "." + output.first, output.second))
+        {
+            return false;
+        }
+    }
+    kpis = values;
+    return true;
+}
+
+inline void
+ResultCache::Store(const std::string& key,
+                   const std::string& parameters,
+                   const std::vector<double>& kpis,
+                   const Outputs& outputs) const
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+    std::string base = m_directory + "/" + key;
+    std::string tmp = "." + std::to_string(getpid()) + ".tmp";
+    for (const auto& output : outputs)
+    {
+        if (!CopyFile(output.second, base + "." + output.first + tmp))
+        {
+            for (const auto& copied : outputs)
+            {
+                std::remove((base + "." + copied.first + tmp).c_str());
+            }
+            return;
+        }
+    }
+    std::ofstream out(base + ".kpi" + tmp);
+    out << parameters;
+    for (std::size_t i = 0; i < kpis.size(); i++)
+    {
+        out << "kpi " << i << " " << std::setprecision(17) << kpis[i] << "\n";
+    }
+    out.close();
+    // the .kpi file marks a complete entry, so it goes last
+    for (const auto& output : outputs)
+    {
+        std::rename((base + "." + output.first + tmp).c_str(),
+                    (base + "." + output.first).c_str());
+    }
+    std::rename((base + ".kpi" + tmp).c_str(), (base + ".kpi").c_str());
+}
+
+} // namespace ns3
+
+#endif /* RESULT_CACHE_H */
@@ -0,0 +1,332 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef ROUTING_WARM_START_H
+#define ROUTING_WARM_START_H
+
+#include "ns3/config.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ipv4-route.h"
+#include "ns3/ipv4-routing-protocol.h"
+#include "ns3/ipv4.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/node.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/simulator.h"
+#include "ns3/socket.h"
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Warm start of the proactive routing protocols (OLSR, DSDV) of an ad hoc
+ * network: instead of waiting a fixed time for the routing to converge,
+ * the protocol timers are shortened until the routing tables cover the
+ * current connectivity graph, the timers are restored, and the network is
+ * declared converged once the coverage has held for a settling window with
+ * the normal timers.
+ *
+ * The connectivity graph is computed from the mobility state at each check:
+ * two nodes are linked when the Friis received power (the loss model of the
+ * scenario) is at least linkThresholdDbm, and a destination counts when it is
+ * reachable in the graph.  The coverage is the fraction of those (source,
+ * destination) pairs for which the routing protocol of the source returns
+ * a route that is not the loopback deferral route.
+ *
+ * ns-3 gives no access to the OLSR neighbor and topology sets or to the
+ * DSDV table, so they cannot be seeded directly; the accelerated timers
+ * fill them in a few seconds instead.  The reactive protocols (AODV, DSR)
+ * keep no state before traffic starts, so they are converged at once.
+ */
+class RoutingWarmStart
+{
+  public:
+    /**
+     * \param nodes The ad hoc nodes, with their IPv4 address on interface 1.
+     * \param protocol OLSR, AODV, DSDV or DSR.
+     * \param txPowerDbm The transmit power.
+     * \param linkThresholdDbm The received power of a usable link.
+     */
+    RoutingWarmStart(const NodeContainer& nodes,
+                     const std::string& protocol,
+                     double txPowerDbm,
+                     double linkThresholdDbm = -85.0);
+
+    /**
+     * \param protocol A routing protocol name.
+     * \return true if it builds routes before there is traffic.
+     */
+    static bool IsProactive(const std::string& protocol);
+
+    /**
+     * \return the routing coverage of the current connectivity graph, 1 if
+     * the graph has no links.
+     */
+    double GetCoverage() const;
+
+    /**
+     * Accelerate the routing and call back when it has converged.  Call
+     * before Simulator::Run().
+     * \param target The coverage to reach.
+     * \param deadline Give up and call back at this time.
+     * \param converged Called once, at the convergence time.
+     */
+    void Start(double target, Time deadline, std::function<void()> converged);
+
+    /**
+     * \return the coverage at the last check.
+     */
+    double GetLastCoverage() const;
+
+  private:
+    /**
+     * Set the protocol timers.
+     * \param fast Use the accelerated values, or else the saved ones.
+     */
+    void SetTimers(bool fast);
+    /**
+     * Periodic coverage check.
+     */
+    void Check();
+    /**
+     * Stop checking and call back.
+     */
+    void Converge();
+
+    NodeContainer m_nodes;                                   //!< The nodes.
+    std::string m_protocol;                                  //!< Routing protocol.
+    double m_txPowerDbm;                                     //!< Transmit power.
+    double m_linkThresholdDbm;                               //!< Usable link power.
+    Ptr<PropagationLossModel> m_loss;                        //!< Link budget model.
+    std::vector<std::pair<std::string, TimeValue>> m_timers; //!< Saved timer attributes.
+    double m_target{1};                                      //!< Coverage to reach.
+    Time m_deadline;                                         //!< Latest convergence time.
+    Time m_settleWindow;                                     //!< Coverage hold time.
+    Time m_settleStart;                                      //!< Start of the hold, or -1.
+    bool m_fast{false};                                      //!< Timers accelerated.
+    double m_lastCoverage{0};                                //!< Coverage at the last check.
+    std::function<void()> m_converged;                       //!< Convergence callback.
+
+    static constexpr double CHECK_INTERVAL = 0.5; //!< Seconds between two checks.
+};
+
+inline RoutingWarmStart::RoutingWarmStart(const NodeContainer& nodes,
+                                          const std::string& protocol,
+                                          double txPowerDbm,
+                                          double linkThresholdDbm)
+    : m_nodes(nodes),
+      m_protocol(protocol),
+      m_txPowerDbm(txPowerDbm),
+      m_linkThresholdDbm(linkThresholdDbm),
+      m_loss(CreateObject<FriisPropagationLossModel>())
+{
+}
+
+inline bool
+RoutingWarmStart::IsProactive(const std::string& protocol)
+{
+    return protocol == "OLSR" || protocol == "DSDV";
+}
+
+inline double
+RoutingWarmStart::GetCoverage() const
+{
+    uint32_t n = m_nodes.GetN();
+    std::vector<Ptr<MobilityModel>> mobility(n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        mobility[i] = m_nodes.Get(i)->GetObject<MobilityModel>();
+    }
+    std::vector<std::vector<uint32_t>> links(n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        for (uint32_t j = i + 1; j < n; j++)
+        {
+            double rx = m_loss->CalcRxPower(m_txPowerDbm, mobility[i], mobility[j]);
+            if (rx >= m_linkThresholdDbm)
+            {
+                links[i].push_back(j);
+                links[j].push_back(i);
+            }
+        }
+    }
+
+    uint64_t reachable = 0;
+    uint64_t routed = 0;
+    Ptr<Packet> probe = Create<Packet>();
+    for (uint32_t s = 0; s < n; s++)
+    {
+        // breadth first search of the nodes reachable from s
+        std::vector<bool> seen(n, false);
+        std::vector<uint32_t> queue{s};
+        seen[s] = true;
+        for (std::size_t head = 0; head < queue.size(); head++)
+        {
+            for (uint32_t next : links[queue[head]])
+            {
+                if (!seen[next])
+                {
+                    seen[next] = true;
+                    queue.push_back(next);
+                }
+            }
+        }
+        Ptr<Ipv4> ipv4 = m_nodes.Get(s)->GetObject<Ipv4>();
+        Ptr<Ipv4RoutingProtocol> routing = ipv4->GetRoutingProtocol();
+        for (std::size_t k = 1; k < queue.size(); k++)
+        {
+            Ptr<Ipv4> dst = m_nodes.Get(queue[k])->GetObject<Ipv4>();
+            Ipv4Header header;
+            header.SetSource(ipv4->GetAddress(1, 0).GetLocal());
+            header.SetDestination(dst->GetAddress(1, 0).GetLocal());
+            Socket::SocketErrno err;
+            Ptr<Ipv4Route> route = routing->RouteOutput(probe, header, nullptr, err);
+            reachable++;
+            if (route && route->GetOutputDevice() != ipv4->GetNetDevice(0))
+            {
+                routed++;
+            }
+        }
+    }
+    return reachable ? double(routed) / reachable : 1.0;
+}
+
+inline double
+RoutingWarmStart::GetLastCoverage() const
+{
+    return m_lastCoverage;
+}
+
+inline void
+RoutingWarmStart::SetTimers(bool fast)
+{
+    if (fast && m_timers.empty())
+    {
+        std::string path;
+        std::vector<std::pair<std::string, Time>> values;
+        if (m_protocol == "OLSR")
+        {
+            path = "$ns3::olsr::RoutingProtocol/";
+            values = {{"HelloInterval", Seconds(0.5)}, {"TcInterval", Seconds(1)}};
+        }
+        else
+        {
+            path = "$ns3::dsdv::RoutingProtocol/";
+            values = {{"PeriodicUpdateInterval", Seconds(1)}, {"SettlingTime", Seconds(0.5)}};
+        }
+        Ptr<Node> node = m_nodes.Get(0);
+        for (const auto& value : values)
+        {
+            // save what the scenario configured, to restore it
+            TimeValue saved;
+            Config::MatchContainer match =
+                Config::LookupMatches("/NodeList/" + std::to_string(node->GetId()) + "/" +
+                                      path + value.first);
+            NS_ASSERT_MSG(match.GetN() == 1, "No " << m_protocol << " routing on node 0");
+            match.Get(0)->GetAttribute(value.first, saved);
+            m_timers.emplace_back("/NodeList/*/" + path + value.first, saved);
+            Config::Set("/NodeList/*/" + path + value.first, TimeValue(value.second));
+        }
+        m_fast = true;
+        return;
+    }
+    for (const auto& timer : m_timers)
+    {
+        Config::Set(timer.first, timer.second);
+    }
+    m_fast = false;
+}
+
+inline void
+RoutingWarmStart::Start(double target, Time deadline, std::function<void()> converged)
+{
+    m_target = target;
+    m_deadline = deadline;
+    m_converged = std::move(converged);
+    if (!IsProactive(m_protocol))
+    {
+        Simulator::ScheduleNow(&RoutingWarmStart::Converge, this);
+        return;
+    }
+    SetTimers(true);
+    // long enough for every node to send two hellos and two TCs (OLSR), or
+    // two periodic updates (DSDV), with the restored timers
+    m_settleWindow = Seconds(0);
+    for (const auto& timer : m_timers)
+    {
+        m_settleWindow = Max(m_settleWindow, 2 * timer.second.Get());
+    }
+    m_settleStart = Seconds(-1);
+    Simulator::Schedule(Seconds(CHECK_INTERVAL), &RoutingWarmStart::Check, this);
+}
+
+inline void
+RoutingWarmStart::Check()
+{
+    m_lastCoverage = GetCoverage();
+    Time now = Simulator::Now();
+    if (now >= m_deadline)
+    {
+        if (m_fast)
+        {
+            SetTimers(false);
+        }
+        Converge();
+        return;
+    }
+    if (m_lastCoverage < m_target)
+    {
+        m_settleStart = Seconds(-1);
+    }
+    else if (m_fast)
+    {
+        SetTimers(false);
+        m_settleStart = now;
+    }
+    else if (m_settleStart.IsNegative())
+    {
+        m_settleStart = now;
+    }
+    else if (now - m_settleStart >= m_settleWindow)
+    {
+        Converge();
+        return;
+    }
+    Simulator::Schedule(Seconds(CHECK_INTERVAL), &RoutingWarmStart::Check, this);
+}
+
+inline void
+RoutingWarmStart::Converge()
+{
+    if (m_converged)
+    {
+        std::function<void()> converged = std::move(m_converged);
+        m_converged = nullptr;
+        converged();
+    }
+}
+
+} // namespace ns3
+
+#endif /* ROUTING_WARM_START_H */
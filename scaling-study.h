@@ -0,0 +1,581 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef SCALING_STUDY_H
+#define SCALING_STUDY_H
+
+#include "fork-pool.h"
+
+#include "ns3/default-simulator-impl.h"
+#include "ns3/event-impl.h"
+#include "ns3/simulator.h"
+#include "ns3/type-id.h"
+
+#include <cxxabi.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Default simulator that charges the events it runs, and their wall clock
+ * time, to the ns-3 module they belong to.
+ *
+ * Every scheduled event is wrapped and timed when it runs; the counts are
+ * kept by the C++ type of the event, which names the function or member
+ * function it calls, and only mapped to modules when asked: the first
+ * ns3:: class in the demangled type name that is a registered TypeId
+ * gives its group name (Wifi, Olsr, Internet...).  Events of unregistered
+ * classes and free functions are counted as "other".
+ *
+ * Select it with the SimulatorImplementationType global value before the
+ * first event is scheduled.
+ */
+class ModuleProfilingSimulatorImpl : public DefaultSimulatorImpl
+{
+  public:
+    /// Events run and their wall clock time.
+    struct Stats
+    {
+        uint64_t events{0}; //!< Events run.
+        double seconds{0};  //!< Wall clock seconds in them.
+    };
+
+    /**
+     * Register this type.
+     * \return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    EventId Schedule(const Time& delay, EventImpl* event) override;
+    void ScheduleWithContext(uint32_t context, const Time& delay, EventImpl* event) override;
+    EventId ScheduleNow(EventImpl* event) override;
+
+    /**
+     * \return the events and time by module.
+     */
+    std::map<std::string, Stats> GetModuleStats() const;
+
+    /**
+     * \param typeName The mangled name of the type of an event.
+     * \return the module it belongs to, or "other".
+     */
+    static std::string GetModule(const char* typeName);
+
+  private:
+    /// Event wrapper that times the wrapped event.
+    class TimedEvent : public EventImpl
+    {
+      public:
+        /**
+         * \param impl The simulator.
+         * \param event The event, whose reference is taken over.
+         */
+        TimedEvent(ModuleProfilingSimulatorImpl* impl, EventImpl* event)
+            : m_impl(impl),
+              m_event(event, false)
+        {
+        }
+
+      private:
+        void Notify() override
+        {
+            auto start = std::chrono::steady_clock::now();
+            m_event->Invoke();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            Stats& stats = m_impl->m_byType[typeid(*m_event)];
+            stats.events++;
+            stats.seconds += elapsed.count();
+        }
+
+        ModuleProfilingSimulatorImpl* m_impl; //!< The simulator.
+        Ptr<EventImpl> m_event;               //!< The wrapped event.
+    };
+
+    std::unordered_map<std::type_index, Stats> m_byType; //!< Stats by event type.
+};
+
+/**
+ * Wall clock time of the named phases of a run.
+ */
+class PhaseTimer
+{
+  public:
+    /**
+     * Start timing the next phase.
+     */
+    void Start();
+    /**
+     * Charge the time since the previous mark to a phase, and mark now.
+     * \param phase The phase name.
+     */
+    void Lap(const std::string& phase);
+    /**
+     * \return the seconds of each phase.
+     */
+    const std::map<std::string, double>& GetSeconds() const;
+
+  private:
+    std::chrono::steady_clock::time_point m_mark; //!< Previous mark.
+    std::map<std::string, double> m_seconds;      //!< Phase seconds.
+};
+
+/**
+ * Runs a scenario at a series of sizes, each in its own forked process,
+ * one after the other so the timings do not disturb each other, and fits
+ * the growth of every measure with the size.
+ *
+ * A size reports its node count, the seconds of its phases, its events
+ * and their time by module, and the peak resident memory of its process
+ * (reset when it starts, where the kernel allows it).  Each measure y is
+ * fitted as y = c n^k over the node counts n by least squares on the
+ * logarithms; the exponent k is the empirical complexity.  The module
+ * whose run time grows fastest, among those that take at least 5% of the
+ * run at the largest size, is reported as the bottleneck: it is the
+ * first to break as the deployment grows.
+ */
+class ScalingStudy
+{
+  public:
+    /// The measures of one size.
+    struct Sample
+    {
+        uint32_t size{0};                                                   //!< Scenario size.
+        uint32_t nodes{0};                                                  //!< Node count.
+        std::map<std::string, double> phases;                               //!< Phase seconds.
+        std::map<std::string, ModuleProfilingSimulatorImpl::Stats> modules; //!< By module.
+        double peakRssMb{0};                                                //!< Peak RSS in MB.
+    };
+
+    /**
+     * Run the scenario at one size; runs in the child process.
+     * \param size The size.
+     * \return its measures, but the peak memory.
+     */
+    using Scenario = std::function<Sample(uint32_t size)>;
+
+    /**
+     * \param sizes The sizes to run.
+     */
+    explicit ScalingStudy(const std::vector<uint32_t>& sizes);
+
+    /**
+     * Run every size.
+     * \param scenario The scenario.
+     * \return the measures of the sizes that succeeded.
+     */
+    std::vector<Sample> Run(Scenario scenario) const;
+
+    /**
+     * Print one scaling-sample and scaling-module lines per size, one
+     * scaling-fit line per measure and a scaling-bottleneck line.
+     * \param os The output stream.
+     * \param samples The measures.
+     */
+    static void PrintReport(std::ostream& os, const std::vector<Sample>& samples);
+
+    /**
+     * \param x The sizes.
+     * \param y The measures.
+     * \return the exponent k of y = c x^k, NaN with less than two positive
+     * points.
+     */
+    static double FitExponent(const std::vector<double>& x, const std::vector<double>& y);
+
+    /**
+     * \param field A field of /proc/self/status in kB, such as VmHWM.
+     * \return its value in MB, 0 if unknown.
+     */
+    static double GetProcStatusMb(const std::string& field);
+
+  private:
+    /**
+     * \param sample The measures.
+     * \return them as text.
+     */
+    static std::string Serialize(const Sample& sample);
+    /**
+     * \param text The text of Serialize().
+     * \return the measures.
+     */
+    static Sample Deserialize(const std::string& text);
+
+    std::vector<uint32_t> m_sizes; //!< Sizes to run.
+};
+
+NS_OBJECT_ENSURE_REGISTERED(ModuleProfilingSimulatorImpl);
+
+inline TypeId
+ModuleProfilingSimulatorImpl::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::ModuleProfilingSimulatorImpl")
+                            .SetParent<DefaultSimulatorImpl>()
+                            .SetGroupName("Core")
+                            .AddConstructor<ModuleProfilingSimulatorImpl>();
+    return tid;
+}
+
+inline EventId
+ModuleProfilingSimulatorImpl::Schedule(const Time& delay, EventImpl* event)
+{
+    return DefaultSimulatorImpl::Schedule(delay, new TimedEvent(this, event));
+}
+
+inline void
+ModuleProfilingSimulatorImpl::ScheduleWithContext(uint32_t context,
+                                                  const Time& delay,
+                                                  EventImpl* event)
+{
+    DefaultSimulatorImpl::ScheduleWithContext(context, delay, new TimedEvent(this, event));
+}
+
+inline EventId
+ModuleProfilingSimulatorImpl::ScheduleNow(EventImpl* event)
+{
+    return DefaultSimulatorImpl::ScheduleNow(new TimedEvent(this, event));
+}
+
+inline std::string
+ModuleProfilingSimulatorImpl::GetModule(const char* typeName)
+{
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(typeName, nullptr, nullptr, &status);
+    std::string name = status == 0 ? demangled : typeName;
+    std::free(demangled);
+
+    // the event types name what they call, as in
+    // ns3::MakeEvent<void (ns3::WifiPhy::*)(), ns3::WifiPhy*>(...)::EventMemberImpl0
+    for (std::size_t pos = name.find("ns3::"); pos != std::string::npos;
+         pos = name.find("ns3::", pos + 1))
+    {
+        std::size_t end = pos;
+        while (end < name.size() && (std::isalnum(static_cast<unsigned char>(name[end])) ||
+                                     name[end] == '_' || name[end] == ':'))
+        {
+            end++;
+        }
+        // try ns3::a::B::C, then ns3::a::B, then ns3::a
+        std::string candidate = name.substr(pos, end - pos);
+        while (candidate.size() > 5)
+        {
+            while (!candidate.empty() && candidate.back() == ':')
+            {
+                candidate.pop_back();
+            }
+            TypeId tid;
+            if (TypeId::LookupByNameFailSafe(candidate, &tid))
+            {
+                std::string group = tid.GetGroupName();
+                return group.empty() ? candidate : group;
+            }
+            std::size_t colon = candidate.rfind("::");
+            candidate = colon == std::string::npos ? "" : candidate.substr(0, colon);
+        }
+    }
+    return "other";
+}
+
+inline std::map<std::string, ModuleProfilingSimulatorImpl::Stats>
+ModuleProfilingSimulatorImpl::GetModuleStats() const
+{
+    std::map<std::string, Stats> modules;
+    for (const auto& entry : m_byType)
+    {
+        Stats& stats = modules[GetModule(entry.first.name())];
+        stats.events += entry.second.events;
+        stats.seconds += entry.second.seconds;
+    }
+    return modules;
+}
+
+inline void
+PhaseTimer::Start()
+{
+    m_mark = std::chrono::steady_clock::now();
+}
+
+inline void
+PhaseTimer::Lap(const std::string& phase)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> lap = now - m_mark;
+    m_seconds[phase] += lap.count();
+    m_mark = now;
+}
+
+inline const std::map<std::string, double>&
+PhaseTimer::GetSeconds() const
+{
+    return m_seconds;
+}
+
+inline ScalingStudy::ScalingStudy(const std::vector<uint32_t>& sizes)
+    : m_sizes(sizes)
+{
+}
+
+inline double
+ScalingStudy::GetProcStatusMb(const std::string& field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, field.size() + 1, field + ":") == 0)
+        {
+            return std::strtod(line.c_str() + field.size() + 1, nullptr) / 1024;
+        }
+    }
+    return 0;
+}
+
+inline std::string
+ScalingStudy::Serialize(const Sample& sample)
+{
+    std::ostringstream os;
+    os.precision(17);
+    os << "nodes " << sample.nodes << "\n"
+       << "peakRssMb " << sample.peakRssMb << "\n";
+    for (const auto& phase : sample.phases)
+    {
+        os << "phase " << phase.first << " " << phase.second << "\n";
+    }
+    for (const auto& module : sample.modules)
+    {
+        os << "module " << module.first << " " << module.second.events << " "
+           << module.second.seconds << "\n";
+    }
+    return os.str();
+}
+
+inline ScalingStudy::Sample
+ScalingStudy::Deserialize(const std::string& text)
+{
+    Sample sample;
+    std::istringstream is(text);
+    std::string key;
+    while (is >> key)
+    {
+        if (key == "nodes")
+        {
+            is >> sample.nodes;
+        }
+        else if (key == "peakRssMb")
+        {
+            is >> sample.peakRssMb;
+        }
+        else if (key == "phase")
+        {
+            std::string name;
+            is >> name;
+            is >> sample.phases[name];
+        }
+        else if (key == "module")
+        {
+            std::string name;
+            is >> name;
+            is >> sample.modules[name].events >> sample.modules[name].seconds;
+        }
+    }
+    return sample;
+}
+
+inline std::vector<ScalingStudy::Sample>
+ScalingStudy::Run(Scenario scenario) const
+{
+    std::vector<Sample> samples;
+    for (uint32_t size : m_sizes)
+    {
+        int fds[2];
+        if (pipe(fds) != 0)
+        {
+            std::perror("pipe");
+            break;
+        }
+        int exitStatus = -1;
+        ForkPool pool(1, [&](std::size_t /* id */, int status) { exitStatus = status; });
+        pool.Start([&, fds, size]() {
+            close(fds[0]);
+            // forget the peak of the parent (Linux 4.0 and later)
+            std::ofstream("/proc/self/clear_refs") << "5";
+            Sample sample = scenario(size);
+            sample.peakRssMb = GetProcStatusMb("VmHWM");
+            std::string text = Serialize(sample);
+            const char* data = text.data();
+            std::size_t left = text.size();
+            ssize_t w = 0;
+            while (left > 0 && (w = write(fds[1], data, left)) > 0)
+            {
+                data += w;
+                left -= w;
+            }
+            close(fds[1]);
+            return left == 0 ? 0 : 1;
+        });
+        close(fds[1]);
+        // read before reaping, the text may not fit in the pipe
+        std::string text;
+        char buffer[4096];
+        ssize_t r = 0;
+        while ((r = read(fds[0], buffer, sizeof(buffer))) > 0)
+        {
+            text.append(buffer, r);
+        }
+        close(fds[0]);
+        pool.WaitAll();
+        if (exitStatus != 0 || text.empty())
+        {
+            std::cerr << "scaling: size " << size << " failed with status " << exitStatus
+                      << std::endl;
+            continue;
+        }
+        samples.push_back(Deserialize(text));
+        samples.back().size = size;
+    }
+    return samples;
+}
+
+inline double
+ScalingStudy::FitExponent(const std::vector<double>& x, const std::vector<double>& y)
+{
+    double n = 0;
+    double sx = 0;
+    double sy = 0;
+    double sxx = 0;
+    double sxy = 0;
+    for (std::size_t i = 0; i < x.size() && i < y.size(); i++)
+    {
+        if (x[i] <= 0 || y[i] <= 0)
+        {
+            continue;
+        }
+        double lx = std::log(x[i]);
+        double ly = std::log(y[i]);
+        n++;
+        sx += lx;
+        sy += ly;
+        sxx += lx * lx;
+        sxy += lx * ly;
+    }
+    double var = sxx - sx * sx / n;
+    if (n < 2 || var <= 0)
+    {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return (sxy - sx * sy / n) / var;
+}
+
+inline void
+ScalingStudy::PrintReport(std::ostream& os, const std::vector<Sample>& samples)
+{
+    std::vector<double> nodes;
+    std::map<std::string, std::vector<double>> measures;
+    std::map<std::string, std::vector<double>> moduleSeconds;
+    for (const Sample& s : samples)
+    {
+        nodes.push_back(s.nodes);
+        os << "scaling-sample size=" << s.size << " nodes=" << s.nodes;
+        uint64_t events = 0;
+        for (const auto& module : s.modules)
+        {
+            events += module.second.events;
+        }
+        for (const auto& phase : s.phases)
+        {
+            os << " " << phase.first << "Seconds=" << phase.second;
+            measures[phase.first + "Seconds"].push_back(phase.second);
+        }
+        os << " events=" << events << " peakRssMb=" << s.peakRssMb << std::endl;
+        measures["events"].push_back(events);
+        measures["peakRssMb"].push_back(s.peakRssMb);
+        for (const auto& module : s.modules)
+        {
+            os << "scaling-module size=" << s.size << " module=" << module.first
+               << " events=" << module.second.events << " seconds=" << module.second.seconds
+               << std::endl;
+        }
+    }
+    for (const auto& measure : measures)
+    {
+        if (measure.second.size() == nodes.size())
+        {
+            os << "scaling-fit measure=" << measure.first
+               << " exponent=" << FitExponent(nodes, measure.second) << std::endl;
+        }
+    }
+    if (samples.empty())
+    {
+        return;
+    }
+
+    // the modules of the largest size, with zero where a size did not run them
+    const Sample& largest = samples.back();
+    double runSeconds = 0;
+    for (const auto& module : largest.modules)
+    {
+        runSeconds += module.second.seconds;
+    }
+    std::string bottleneck;
+    double worst = -std::numeric_limits<double>::infinity();
+    double worstShare = 0;
+    for (const auto& module : largest.modules)
+    {
+        std::vector<double> seconds;
+        for (const Sample& s : samples)
+        {
+            auto it = s.modules.find(module.first);
+            seconds.push_back(it == s.modules.end() ? 0 : it->second.seconds);
+        }
+        double exponent = FitExponent(nodes, seconds);
+        double share = runSeconds > 0 ? module.second.seconds / runSeconds : 0;
+        os << "scaling-fit measure=module:" << module.first << " exponent=" << exponent
+           << " share=" << share << std::endl;
+        if (share >= 0.05 && exponent > worst)
+        {
+            worst = exponent;
+            worstShare = share;
+            bottleneck = module.first;
+        }
+    }
+    if (!bottleneck.empty())
+    {
+        os << "scaling-bottleneck module=" << bottleneck << " exponent=" << worst
+           << " share=" << worstShare << std::endl;
+    }
+}
+
+} // namespace ns3
+
+#endif /* SCALING_STUDY_H */
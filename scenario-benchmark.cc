@@ -0,0 +1,473 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Runs the scenarios at several sizes and records what each run costs, as
+ * JSON that can be compared between builds.
+ *
+ * Every case runs in a fresh temporary directory, so the bytes of all the
+ * files it leaves there (traces, pcaps, CSVs, animation) plus its stdout
+ * and stderr are its output bytes.  Wall time and peak RSS are measured
+ * from outside the process; the event count and the simulated time come
+ * from the scheduler-report line that the scenarios print (see
+ * scheduler-selection.h), summed when a program runs several simulations.
+ *
+ * The built-in suite covers hanet-compairson, hanet-compairsonV2,
+ * manet-routing-compare (also bare, with FlowMonitor and with FlowStats),
+ * mixed-wired-wireless and wifi-aggregation, with programs named
+ * <binDir>/<prefix><scenario><suffix> as the ns3 build names them.
+ * --case adds a NAME:COMMAND case, and --only keeps the cases whose name
+ * contains the given text.  With --baseline, the cases of an
+ * earlier report whose wall time or peak RSS grew by more than --tolerance
+ * are listed and the exit status is 2.
+ *
+ * Usage:
+ *   scenario-benchmark [--binDir=build/scratch] [--prefix=ns3.40-] [--suffix=-default]
+ *                      [--case=NAME:COMMAND ...] [--only=TEXT] [--noSuite]
+ *                      [--label=BUILD] [--out=scenario-benchmark.json]
+ *                      [--baseline=old.json] [--tolerance=0.1] [--keep]
+ */
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/// A benchmark case.
+struct Case
+{
+    std::string name;    //!< Name in the report.
+    std::string command; //!< Shell command, run in a fresh directory.
+};
+
+/// The measurements of a case.
+struct Result
+{
+    int status{-1};           //!< Exit status, or -1 if it did not exit.
+    double wallSeconds{0};    //!< Wall clock time of the process.
+    double runSeconds{0};     //!< Wall clock time of Simulator::Run().
+    double simSeconds{0};     //!< Simulated time.
+    double events{0};         //!< Events executed.
+    long peakRssKiB{0};       //!< Peak resident set size.
+    uintmax_t outputBytes{0}; //!< Bytes written to files, stdout and stderr.
+};
+
+/**
+ * \param text A string.
+ * \return it as a JSON string literal.
+ */
+std::string
+Quote(const std::string& text)
+{
+    std::string out = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+/**
+ * Add the fields of the scheduler-report lines of a file.
+ * \param fileName The stderr of a run.
+ * \param result The result to update.
+ */
+void
+ParseReports(const std::string& fileName, Result& result)
+{
+    std::ifstream in(fileName);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.rfind("scheduler-report ", 0) != 0)
+        {
+            continue;
+        }
+        std::istringstream is(line);
+        std::string field;
+        while (is >> field)
+        {
+            std::size_t eq = field.find('=');
+            if (eq == std::string::npos)
+            {
+                continue;
+            }
+            std::string key = field.substr(0, eq);
+            double value = std::atof(field.c_str() + eq + 1);
+            if (key == "events")
+            {
+                result.events += value;
+            }
+            else if (key == "wallSeconds")
+            {
+                result.runSeconds += value;
+            }
+            else if (key == "simSeconds")
+            {
+                result.simSeconds += value;
+            }
+        }
+    }
+}
+
+/**
+ * Run a case in a new directory below a scratch directory.
+ * \param c The case.
+ * \param scratch The scratch directory.
+ * \param index The case index, for the directory name.
+ * \param keep Keep the directory.
+ * \return the measurements.
+ */
+Result
+RunCase(const Case& c, const std::filesystem::path& scratch, std::size_t index, bool keep)
+{
+    namespace fs = std::filesystem;
+    Result result;
+    fs::path dir = scratch / ("case" + std::to_string(index));
+    fs::create_directories(dir);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (chdir(dir.c_str()) != 0)
+        {
+            _exit(127);
+        }
+        int out = open("stdout.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int err = open("stderr.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out < 0 || err < 0)
+        {
+            _exit(127);
+        }
+        dup2(out, STDOUT_FILENO);
+        dup2(err, STDERR_FILENO);
+        // the peak RSS that wait4() reports covers the reaped descendants
+        execl("/bin/sh", "sh", "-c", c.command.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    if (pid < 0)
+    {
+        std::cerr << c.name << ": fork failed" << std::endl;
+        return result;
+    }
+    int status = 0;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+    result.wallSeconds = wall.count();
+    result.peakRssKiB = usage.ru_maxrss;
+    result.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    ParseReports((dir / "stderr.txt").string(), result);
+    for (const auto& entry : fs::recursive_directory_iterator(dir))
+    {
+        if (entry.is_regular_file())
+        {
+            result.outputBytes += entry.file_size();
+        }
+    }
+    if (!keep)
+    {
+        fs::remove_all(dir);
+    }
+    return result;
+}
+
+/**
+ * Read back the wall time and peak RSS of each case of a report written
+ * by this program, which puts one case per line.
+ * \param fileName The report.
+ * \return wall time and peak RSS by case name.
+ */
+std::map<std::string, std::pair<double, double>>
+ReadBaseline(const std::string& fileName)
+{
+    std::map<std::string, std::pair<double, double>> baseline;
+    std::ifstream in(fileName);
+    std::string line;
+    auto field = [&line](const std::string& key) -> std::string {
+        std::string tag = "\"" + key + "\": ";
+        std::size_t pos = line.find(tag);
+        if (pos == std::string::npos)
+        {
+            return "";
+        }
+        pos += tag.size();
+        if (line[pos] == '"')
+        {
+            return line.substr(pos + 1, line.find('"', pos + 1) - pos - 1);
+        }
+        return line.substr(pos, line.find_first_of(",}", pos) - pos);
+    };
+    while (std::getline(in, line))
+    {
+        std::string name = field("name");
+        if (!name.empty())
+        {
+            baseline[name] = {std::atof(field("wallSeconds").c_str()),
+                              std::atof(field("peakRssKiB").c_str())};
+        }
+    }
+    return baseline;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    std::string binDir = "build/scratch";
+    std::string prefix = "ns3.40-";
+    std::string suffix = "-default";
+    std::vector<Case> extra;
+    std::string only;
+    bool suite = true;
+    std::string label;
+    std::string out = "scenario-benchmark.json";
+    std::string baselineFile;
+    double tolerance = 0.1;
+    bool keep = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        auto value = [&arg]() { return arg.substr(arg.find('=') + 1); };
+        if (arg.rfind("--binDir=", 0) == 0)
+        {
+            binDir = value();
+        }
+        else if (arg.rfind("--prefix=", 0) == 0)
+        {
+            prefix = value();
+        }
+        else if (arg.rfind("--suffix=", 0) == 0)
+        {
+            suffix = value();
+        }
+        else if (arg.rfind("--case=", 0) == 0)
+        {
+            std::string spec = value();
+            std::size_t colon = spec.find(':');
+            if (colon == std::string::npos || colon == 0 || colon + 1 == spec.size())
+            {
+                std::cerr << "bad case " << spec << ", expected NAME:COMMAND" << std::endl;
+                return 1;
+            }
+            extra.push_back(Case{spec.substr(0, colon), spec.substr(colon + 1)});
+        }
+        else if (arg.rfind("--only=", 0) == 0)
+        {
+            only = value();
+        }
+        else if (arg == "--noSuite")
+        {
+            suite = false;
+        }
+        else if (arg.rfind("--label=", 0) == 0)
+        {
+            label = value();
+        }
+        else if (arg.rfind("--out=", 0) == 0)
+        {
+            out = value();
+        }
+        else if (arg.rfind("--baseline=", 0) == 0)
+        {
+            baselineFile = value();
+        }
+        else if (arg.rfind("--tolerance=", 0) == 0)
+        {
+            tolerance = std::stod(value());
+        }
+        else if (arg == "--keep")
+        {
+            keep = true;
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [--binDir=build/scratch] [--prefix=ns3.40-] [--suffix=-default]"
+                         " [--case=NAME:COMMAND ...] [--only=TEXT] [--noSuite] [--label=BUILD]"
+                         " [--out=scenario-benchmark.json] [--baseline=old.json]"
+                         " [--tolerance=0.1] [--keep]"
+                      << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    std::vector<Case> cases;
+    if (suite)
+    {
+        std::string bin = std::filesystem::absolute(binDir).string() + "/" + prefix;
+        auto add = [&](const std::string& name, const std::string& program,
+                       const std::string& args) {
+            cases.push_back(Case{name, bin + program + suffix + " " + args});
+        };
+        add("hanet-compairson", "hanet-compairson", "");
+        for (const char* n : {"10", "25", "50"})
+        {
+            add(std::string("hanet-compairsonV2/manet") + n,
+                "hanet-compairsonV2",
+                std::string("--manetNodes=") + n);
+        }
+        for (const char* n : {"20", "50", "100"})
+        {
+            add(std::string("manet-routing-compare/nodes") + n,
+                "manet-routing-compare",
+                std::string("--protocol=OLSR --nWifis=") + n);
+        }
+        // the same run bare, with FlowMonitor and with FlowStats: the run
+        // time differences over the flow-stats packets line are the cost of
+        // each per packet
+        for (const char* stats : {"none", "flowMonitor", "flowStats"})
+        {
+            std::string option = std::string(stats) == "none" ? "" : std::string(" --") + stats;
+            add(std::string("manet-routing-compare/flows-") + stats,
+                "manet-routing-compare",
+                "--protocol=OLSR --nWifis=50" + option);
+        }
+        for (const char* n : {"10", "20", "40"})
+        {
+            add(std::string("mixed-wired-wireless/backbone") + n,
+                "mixed-wired-wireless",
+                std::string("--backboneNodes=") + n);
+        }
+        for (const char* t : {"2", "5", "10"})
+        {
+            add(std::string("wifi-aggregation/time") + t,
+                "wifi-aggregation",
+                std::string("--simulationTime=") + t);
+        }
+    }
+    cases.insert(cases.end(), extra.begin(), extra.end());
+    std::vector<Case> selected;
+    for (const auto& c : cases)
+    {
+        if (only.empty() || c.name.find(only) != std::string::npos)
+        {
+            selected.push_back(c);
+        }
+    }
+    if (selected.empty())
+    {
+        std::cerr << "no cases to run" << std::endl;
+        return 1;
+    }
+
+    char scratchTemplate[] = "/tmp/scenario-benchmark.XXXXXX";
+    if (!mkdtemp(scratchTemplate))
+    {
+        std::cerr << "cannot create a scratch directory" << std::endl;
+        return 1;
+    }
+    std::filesystem::path scratch(scratchTemplate);
+
+    std::ofstream json(out);
+    json << "{\n  \"label\": " << Quote(label) << ",\n  \"cases\": [\n";
+    std::vector<Result> results;
+    int failures = 0;
+    for (std::size_t i = 0; i < selected.size(); i++)
+    {
+        const Case& c = selected[i];
+        Result r = RunCase(c, scratch, i, keep);
+        results.push_back(r);
+        failures += r.status != 0;
+        json << "    {\"name\": " << Quote(c.name) << ", \"command\": " << Quote(c.command)
+             << ", \"status\": " << r.status << ", \"wallSeconds\": " << r.wallSeconds
+             << ", \"runSeconds\": " << r.runSeconds << ", \"simSeconds\": " << r.simSeconds
+             << ", \"simPerWall\": " << (r.wallSeconds > 0 ? r.simSeconds / r.wallSeconds : 0)
+             << ", \"events\": " << r.events << ", \"eventsPerSecond\": "
+             << (r.runSeconds > 0 ? r.events / r.runSeconds : 0)
+             << ", \"peakRssKiB\": " << r.peakRssKiB << ", \"outputBytes\": " << r.outputBytes
+             << "}" << (i + 1 < selected.size() ? "," : "") << "\n";
+        std::cout << c.name << ": status " << r.status << ", " << r.wallSeconds << " s, "
+                  << r.events << " events, " << r.peakRssKiB << " KiB peak RSS, "
+                  << r.outputBytes << " bytes out" << std::endl;
+    }
+    json << "  ]\n}\n";
+    json.close();
+    if (keep)
+    {
+        std::cout << "case directories kept in " << scratch.string() << std::endl;
+    }
+    else
+    {
+        std::filesystem::remove_all(scratch);
+    }
+
+    int regressions = 0;
+    if (!baselineFile.empty())
+    {
+        auto baseline = ReadBaseline(baselineFile);
+        for (std::size_t i = 0; i < selected.size(); i++)
+        {
+            auto it = baseline.find(selected[i].name);
+            if (it == baseline.end() || results[i].status != 0)
+            {
+                continue;
+            }
+            double wall = it->second.first;
+            double rss = it->second.second;
+            if (wall > 0 && results[i].wallSeconds > wall * (1 + tolerance))
+            {
+                std::cout << "REGRESSION " << selected[i].name << ": wall time " << wall << " -> "
+                          << results[i].wallSeconds << " s" << std::endl;
+                regressions++;
+            }
+            if (rss > 0 && results[i].peakRssKiB > rss * (1 + tolerance))
+            {
+                std::cout << "REGRESSION " << selected[i].name << ": peak RSS " << rss << " -> "
+                          << results[i].peakRssKiB << " KiB" << std::endl;
+                regressions++;
+            }
+        }
+    }
+    if (failures)
+    {
+        return 1;
+    }
+    return regressions ? 2 : 0;
+}
@@ -0,0 +1,297 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Runs every scenario with every event scheduler and records the event
+ * rate and the peak event queue size of each pair.
+ *
+ * A scenario is a name and the command that runs its built program, which
+ * must accept --scheduler and --schedulerStats (see scheduler-selection.h)
+ * and print a scheduler-report line per simulation.  The lines of a
+ * program that runs several simulations are added up: events and wall
+ * time are summed, the event rate is their ratio and the peak queue size
+ * is the largest one.  Each pair is run --runs times without the queue
+ * probe and the median event rate is kept, then once more with the probe
+ * for the peak queue size.  The results go to a CSV file, and the fastest
+ * scheduler of each scenario is printed.
+ *
+ * The built-in suite runs hanet-compairson, hanet-compairsonV2,
+ * manet-routing-compare, mixed-wired-wireless and wifi-aggregation with
+ * their default settings, with programs named
+ * <binDir>/<prefix><scenario><suffix> as the ns3 build names them.
+ * --scenario adds a NAME:COMMAND scenario, and --noSuite leaves out the
+ * built-in ones.
+ *
+ * Usage:
+ *   scheduler-benchmark [--binDir=build/scratch] [--prefix=ns3.40-] [--suffix=-default]
+ *                       [--scenario=NAME:COMMAND ...] [--noSuite]
+ *                       [--schedulers=Map,Heap,List,Calendar,PriorityQueue,DaryHeap]
+ *                       [--runs=3] [--out=scheduler-benchmark.csv]
+ *
+ * For example:
+ *   scheduler-benchmark --noSuite \
+ *     --scenario="manet:build/scratch/ns3.40-manet-routing-compare-default --protocol=OLSR"
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/// A scenario to benchmark.
+struct Scenario
+{
+    std::string name;    //!< Name in the results.
+    std::string command; //!< Command that runs it.
+};
+
+/// The scheduler-report lines of a run, added up.
+struct Report
+{
+    bool valid{false};         //!< A report line was found.
+    unsigned lines{0};         //!< Report lines, one per simulation.
+    double events{0};          //!< Events run.
+    double wallSeconds{0};     //!< Wall clock time of Simulator::Run().
+    double eventsPerSecond{0}; //!< Event rate.
+    double peakQueue{-1};      //!< Peak queue size, -1 if not probed.
+};
+
+/**
+ * \param list A comma separated list.
+ * \return its items.
+ */
+std::vector<std::string>
+Split(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream is(list);
+    std::string item;
+    while (std::getline(is, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+/**
+ * Run a command and add up the report lines it prints.
+ * \param command The command, whose stdout is discarded.
+ * \return the report.
+ */
+Report
+RunOnce(const std::string& command)
+{
+    Report report;
+    std::string shell = command + " 2>&1 >/dev/null";
+    FILE* pipe = popen(shell.c_str(), "r");
+    if (!pipe)
+    {
+        return report;
+    }
+    char line[4096];
+    while (std::fgets(line, sizeof(line), pipe))
+    {
+        std::string text(line);
+        if (text.rfind("scheduler-report ", 0) != 0)
+        {
+            continue;
+        }
+        std::istringstream is(text);
+        std::string field;
+        while (is >> field)
+        {
+            std::size_t eq = field.find('=');
+            if (eq == std::string::npos)
+            {
+                continue;
+            }
+            std::string key = field.substr(0, eq);
+            double value = std::atof(field.c_str() + eq + 1);
+            if (key == "events")
+            {
+                report.events += value;
+            }
+            else if (key == "wallSeconds")
+            {
+                report.wallSeconds += value;
+            }
+            else if (key == "peakQueue")
+            {
+                report.peakQueue = std::max(report.peakQueue, value);
+            }
+        }
+        report.lines++;
+    }
+    int status = pclose(pipe);
+    report.valid = report.lines > 0 && status == 0;
+    if (report.wallSeconds > 0)
+    {
+        report.eventsPerSecond = report.events / report.wallSeconds;
+    }
+    return report;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    std::string binDir = "build/scratch";
+    std::string prefix = "ns3.40-";
+    std::string suffix = "-default";
+    std::vector<Scenario> extra;
+    bool suite = true;
+    std::string schedulers = "Map,Heap,List,Calendar,PriorityQueue,DaryHeap";
+    unsigned runs = 3;
+    std::string out = "scheduler-benchmark.csv";
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        auto value = [&arg]() { return arg.substr(arg.find('=') + 1); };
+        if (arg.rfind("--binDir=", 0) == 0)
+        {
+            binDir = value();
+        }
+        else if (arg.rfind("--prefix=", 0) == 0)
+        {
+            prefix = value();
+        }
+        else if (arg.rfind("--suffix=", 0) == 0)
+        {
+            suffix = value();
+        }
+        else if (arg.rfind("--scenario=", 0) == 0)
+        {
+            std::string spec = value();
+            std::size_t colon = spec.find(':');
+            if (colon == std::string::npos || colon == 0 || colon + 1 == spec.size())
+            {
+                std::cerr << "bad scenario " << spec << ", expected NAME:COMMAND" << std::endl;
+                return 1;
+            }
+            extra.push_back(Scenario{spec.substr(0, colon), spec.substr(colon + 1)});
+        }
+        else if (arg == "--noSuite")
+        {
+            suite = false;
+        }
+        else if (arg.rfind("--schedulers=", 0) == 0)
+        {
+            schedulers = value();
+        }
+        else if (arg.rfind("--runs=", 0) == 0)
+        {
+            runs = std::stoul(value());
+        }
+        else if (arg.rfind("--out=", 0) == 0)
+        {
+            out = value();
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [--binDir=build/scratch] [--prefix=ns3.40-] [--suffix=-default]"
+                         " [--scenario=NAME:COMMAND ...] [--noSuite]"
+                         " [--schedulers=Map,Heap,...] [--runs=3] [--out=scheduler-benchmark.csv]"
+                      << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    std::vector<Scenario> scenarios;
+    if (suite)
+    {
+        std::string bin = std::filesystem::absolute(binDir).string() + "/" + prefix;
+        for (const char* program : {"hanet-compairson",
+                                    "hanet-compairsonV2",
+                                    "manet-routing-compare",
+                                    "mixed-wired-wireless",
+                                    "wifi-aggregation"})
+        {
+            scenarios.push_back(Scenario{program, bin + program + suffix});
+        }
+    }
+    scenarios.insert(scenarios.end(), extra.begin(), extra.end());
+    if (scenarios.empty() || runs == 0)
+    {
+        std::cerr << "need at least one scenario and --runs >= 1" << std::endl;
+        return 1;
+    }
+
+    std::ofstream csv(out);
+    csv << "Scenario,Scheduler,Runs,Events,MedianWallSeconds,EventsPerSecond,PeakQueue"
+        << std::endl;
+    int failures = 0;
+    for (const auto& scenario : scenarios)
+    {
+        std::string best;
+        double bestRate = 0;
+        for (const auto& scheduler : Split(schedulers))
+        {
+            std::string command = scenario.command + " --scheduler=" + scheduler;
+            std::vector<Report> timed;
+            for (unsigned r = 0; r < runs; r++)
+            {
+                Report report = RunOnce(command + " --schedulerStats=0");
+                if (report.valid)
+                {
+                    timed.push_back(report);
+                }
+            }
+            Report probed = RunOnce(command + " --schedulerStats=1");
+            if (timed.empty())
+            {
+                std::cerr << scenario.name << " " << scheduler << ": no scheduler report"
+                          << std::endl;
+                failures++;
+                continue;
+            }
+            std::sort(timed.begin(), timed.end(), [](const Report& a, const Report& b) {
+                return a.eventsPerSecond < b.eventsPerSecond;
+            });
+            const Report& median = timed[timed.size() / 2];
+            csv << scenario.name << "," << scheduler << "," << timed.size() << ","
+                << median.events << "," << median.wallSeconds << "," << median.eventsPerSecond
+                << "," << (probed.valid ? probed.peakQueue : -1) << std::endl;
+            std::cout << scenario.name << " " << scheduler << ": " << median.eventsPerSecond
+                      << " events/s, peak queue " << (probed.valid ? probed.peakQueue : -1)
+                      << std::endl;
+            if (median.eventsPerSecond > bestRate)
+            {
+                bestRate = median.eventsPerSecond;
+                best = scheduler;
+            }
+        }
+        if (!best.empty())
+        {
+            std::cout << scenario.name << ": fastest is " << best << " (" << bestRate
+                      << " events/s)" << std::endl;
+        }
+    }
+    return failures ? 1 : 0;
+}
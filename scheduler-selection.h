@@ -0,0 +1,467 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef SCHEDULER_SELECTION_H
+#define SCHEDULER_SELECTION_H
+
+#include "ns3/nstime.h"
+#include "ns3/object-factory.h"
+#include "ns3/scheduler.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Event scheduler on an implicit 4-ary min-heap.
+ *
+ * Compared with the binary HeapScheduler the tree is half as deep, and the
+ * four children of a node are adjacent in memory, so a RemoveNext() touches
+ * about half as many cache lines; the extra comparisons per level are on
+ * data that is already loaded.  Sift operations move a hole instead of
+ * swapping.  Remove() of an arbitrary event is a linear search, as in
+ * HeapScheduler; it is only used by Simulator::Remove().
+ */
+class DaryHeapScheduler : public Scheduler
+{
+  public:
+    /**
+     * Register this type.
+     * \return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    void Insert(const Event& ev) override;
+    bool IsEmpty() const override;
+    Event PeekNext() const override;
+    Event RemoveNext() override;
+    void Remove(const Event& ev) override;
+
+  private:
+    static const std::size_t ARITY = 4; //!< Children per node.
+
+    /**
+     * Move an event up to its place.
+     * \param i Its index.
+     */
+    void SiftUp(std::size_t i);
+    /**
+     * Move an event down to its place.
+     * \param i Its index.
+     */
+    void SiftDown(std::size_t i);
+
+    std::vector<Event> m_heap; //!< The heap, root first.
+};
+
+/**
+ * Scheduler that forwards to another one and keeps track of the number of
+ * pending events, to report the peak queue size of a run.  The extra
+ * indirection costs a little, so it is only used when asked for.
+ */
+class SchedulerProbe : public Scheduler
+{
+  public:
+    /**
+     * Register this type.
+     * \return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    SchedulerProbe();
+
+    void Insert(const Event& ev) override;
+    bool IsEmpty() const override;
+    Event PeekNext() const override;
+    Event RemoveNext() override;
+    void Remove(const Event& ev) override;
+
+    /**
+     * \return the peak queue size of the most recently created probe.
+     */
+    static uint64_t GetPeak();
+
+  private:
+    /**
+     * \return the scheduler, created on first use.
+     */
+    Ptr<Scheduler> GetInner() const;
+
+    /**
+     * \return the peak of the most recently created probe.
+     */
+    static uint64_t& Peak();
+
+    std::string m_innerType;        //!< Scheduler TypeId name.
+    mutable Ptr<Scheduler> m_inner; //!< The scheduler.
+    uint64_t m_size{0};             //!< Pending events.
+};
+
+/**
+ * The --scheduler option of the scenarios: installs the selected event
+ * scheduler and reports the event rate of the run.
+ *
+ * The report is a single line on the given stream, which
+ * scheduler-benchmark and scenario-benchmark parse:
+ *
+ *     scheduler-report name=Heap events=123 wallSeconds=0.5 simSeconds=20
+ *         eventsPerSecond=246 peakQueue=42
+ *
+ * (on one line).  peakQueue is only printed when the probe is enabled.
+ */
+class SchedulerSelection
+{
+  public:
+    /**
+     * \return the accepted names, comma separated.
+     */
+    static std::string GetNames();
+    /**
+     * \param name A scheduler name.
+     * \return true if it is one of GetNames().
+     */
+    static bool IsValidName(const std::string& name);
+
+    /**
+     * Install a scheduler; aborts the simulation on an unknown name.  The
+     * simulator implementation type must already be set.
+     * \param name Map, Heap, List, Calendar, PriorityQueue or DaryHeap.
+     * \param probe Track the peak queue size.
+     */
+    SchedulerSelection(const std::string& name, bool probe);
+
+    /**
+     * Call right before Simulator::Run().
+     */
+    void Start();
+    /**
+     * Call right after Simulator::Run().
+     */
+    void Stop();
+    /**
+     * Print the report line.
+     * \param os The output stream.
+     */
+    void PrintReport(std::ostream& os) const;
+
+  private:
+    /**
+     * \return the TypeId name of each scheduler name.
+     */
+    static const std::map<std::string, std::string>& TypeNames();
+
+    std::string m_name;                            //!< Scheduler name.
+    bool m_probe;                                  //!< Probe enabled.
+    uint64_t m_events{0};                          //!< Events run.
+    double m_wallSeconds{0};                       //!< Wall clock time of the run.
+    std::chrono::steady_clock::time_point m_start; //!< Start of the run.
+    uint64_t m_startEvents{0};                     //!< Event count at the start.
+    Time m_startTime;                              //!< Simulation time at the start.
+    Time m_simTime;                                //!< Simulated time of the run.
+};
+
+NS_OBJECT_ENSURE_REGISTERED(DaryHeapScheduler);
+NS_OBJECT_ENSURE_REGISTERED(SchedulerProbe);
+
+inline TypeId
+DaryHeapScheduler::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::DaryHeapScheduler")
+                            .SetParent<Scheduler>()
+                            .SetGroupName("Core")
+                            .AddConstructor<DaryHeapScheduler>();
+    return tid;
+}
+
+inline void
+DaryHeapScheduler::SiftUp(std::size_t i)
+{
+    Event ev = m_heap[i];
+    while (i > 0)
+    {
+        std::size_t parent = (i - 1) / ARITY;
+        if (!(ev.key < m_heap[parent].key))
+        {
+            break;
+        }
+        m_heap[i] = m_heap[parent];
+        i = parent;
+    }
+    m_heap[i] = ev;
+}
+
+inline void
+DaryHeapScheduler::SiftDown(std::size_t i)
+{
+    Event ev = m_heap[i];
+    std::size_t n = m_heap.size();
+    while (true)
+    {
+        std::size_t first = i * ARITY + 1;
+        if (first >= n)
+        {
+            break;
+        }
+        std::size_t last = std::min(first + ARITY, n);
+        std::size_t best = first;
+        for (std::size_t c = first + 1; c < last; c++)
+        {
+            if (m_heap[c].key < m_heap[best].key)
+            {
+                best = c;
+            }
+        }
+        if (!(m_heap[best].key < ev.key))
+        {
+            break;
+        }
+        m_heap[i] = m_heap[best];
+        i = best;
+    }
+    m_heap[i] = ev;
+}
+
+inline void
+DaryHeapScheduler::Insert(const Event& ev)
+{
+    m_heap.push_back(ev);
+    SiftUp(m_heap.size() - 1);
+}
+
+inline bool
+DaryHeapScheduler::IsEmpty() const
+{
+    return m_heap.empty();
+}
+
+inline Scheduler::Event
+DaryHeapScheduler::PeekNext() const
+{
+    NS_ASSERT(!m_heap.empty());
+    return m_heap.front();
+}
+
+inline Scheduler::Event
+DaryHeapScheduler::RemoveNext()
+{
+    NS_ASSERT(!m_heap.empty());
+    Event next = m_heap.front();
+    m_heap.front() = m_heap.back();
+    m_heap.pop_back();
+    if (!m_heap.empty())
+    {
+        SiftDown(0);
+    }
+    return next;
+}
+
+inline void
+DaryHeapScheduler::Remove(const Event& ev)
+{
+    auto it = std::find_if(m_heap.begin(), m_heap.end(), [&ev](const Event& e) {
+        return e.key.m_uid == ev.key.m_uid;
+    });
+    NS_ASSERT_MSG(it != m_heap.end(), "Event not found");
+    std::size_t i = it - m_heap.begin();
+    m_heap[i] = m_heap.back();
+    m_heap.pop_back();
+    if (i == m_heap.size())
+    {
+        return;
+    }
+    if (i > 0 && m_heap[i].key < m_heap[(i - 1) / ARITY].key)
+    {
+        SiftUp(i);
+    }
+    else
+    {
+        SiftDown(i);
+    }
+}
+
+inline TypeId
+SchedulerProbe::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::SchedulerProbe")
+                            .SetParent<Scheduler>()
+                            .SetGroupName("Core")
+                            .AddConstructor<SchedulerProbe>()
+                            .AddAttribute("InnerType",
+                                          "TypeId name of the scheduler to probe.",
+                                          StringValue("ns3::MapScheduler"),
+                                          MakeStringAccessor(&SchedulerProbe::m_innerType),
+                                          MakeStringChecker());
+    return tid;
+}
+
+inline SchedulerProbe::SchedulerProbe()
+{
+    Peak() = 0;
+}
+
+inline uint64_t&
+SchedulerProbe::Peak()
+{
+    static uint64_t peak = 0;
+    return peak;
+}
+
+inline uint64_t
+SchedulerProbe::GetPeak()
+{
+    return Peak();
+}
+
+inline Ptr<Scheduler>
+SchedulerProbe::GetInner() const
+{
+    if (!m_inner)
+    {
+        ObjectFactory factory(m_innerType);
+        m_inner = factory.Create<Scheduler>();
+    }
+    return m_inner;
+}
+
+inline void
+SchedulerProbe::Insert(const Event& ev)
+{
+    GetInner()->Insert(ev);
+    m_size++;
+    Peak() = std::max(Peak(), m_size);
+}
+
+inline bool
+SchedulerProbe::IsEmpty() const
+{
+    return GetInner()->IsEmpty();
+}
+
+inline Scheduler::Event
+SchedulerProbe::PeekNext() const
+{
+    return GetInner()->PeekNext();
+}
+
+inline Scheduler::Event
+SchedulerProbe::RemoveNext()
+{
+    m_size--;
+    return GetInner()->RemoveNext();
+}
+
+inline void
+SchedulerProbe::Remove(const Event& ev)
+{
+    m_size--;
+    GetInner()->Remove(ev);
+}
+
+inline const std::map<std::string, std::string>&
+SchedulerSelection::TypeNames()
+{
+    static const std::map<std::string, std::string> names{
+        {"Map", "ns3::MapScheduler"},
+        {"Heap", "ns3::HeapScheduler"},
+        {"List", "ns3::ListScheduler"},
+        {"Calendar", "ns3::CalendarScheduler"},
+        {"PriorityQueue", "ns3::PriorityQueueScheduler"},
+        {"DaryHeap", "ns3::DaryHeapScheduler"},
+    };
+    return names;
+}
+
+inline std::string
+SchedulerSelection::GetNames()
+{
+    std::string names;
+    for (const auto& entry : TypeNames())
+    {
+        names += (names.empty() ? "" : ",") + entry.first;
+    }
+    return names;
+}
+
+inline bool
+SchedulerSelection::IsValidName(const std::string& name)
+{
+    return TypeNames().count(name) != 0;
+}
+
+inline SchedulerSelection::SchedulerSelection(const std::string& name, bool probe)
+    : m_name(name),
+      m_probe(probe)
+{
+    auto it = TypeNames().find(name);
+    if (it == TypeNames().end())
+    {
+        NS_FATAL_ERROR("Unknown scheduler " << name << ", use one of " << GetNames());
+    }
+    ObjectFactory factory;
+    if (probe)
+    {
+        factory.SetTypeId("ns3::SchedulerProbe");
+        factory.Set("InnerType", StringValue(it->second));
+    }
+    else
+    {
+        factory.SetTypeId(it->second);
+    }
+    Simulator::SetScheduler(factory);
+}
+
+inline void
+SchedulerSelection::Start()
+{
+    m_startEvents = Simulator::GetEventCount();
+    m_startTime = Simulator::Now();
+    m_start = std::chrono::steady_clock::now();
+}
+
+inline void
+SchedulerSelection::Stop()
+{
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - m_start;
+    m_wallSeconds = wall.count();
+    m_events = Simulator::GetEventCount() - m_startEvents;
+    m_simTime = Simulator::Now() - m_startTime;
+}
+
+inline void
+SchedulerSelection::PrintReport(std::ostream& os) const
+{
+    os << "scheduler-report name=" << m_name << " events=" << m_events
+       << " wallSeconds=" << m_wallSeconds << " simSeconds=" << m_simTime.GetSeconds()
+       << " eventsPerSecond=" << (m_wallSeconds > 0 ? m_events / m_wallSeconds : 0.0);
+    if (m_probe)
+    {
+        os << " peakQueue=" << SchedulerProbe::GetPeak();
+    }
+    os << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* SCHEDULER_SELECTION_H */
@@ -0,0 +1,228 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef THROUGHPUT_RECORDER_H
+#define THROUGHPUT_RECORDER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * In-memory recorder for the per-second throughput time series.
+ *
+ * Samples are kept in preallocated columns and written out in chunks of
+ * FlushRows rows (or once, on Close(), when FlushRows is 0), so the output
+ * file is opened a handful of times per run instead of once per sample.
+ *
+ * The CSV output keeps the historical schema:
+ * SimulationSecond,ReceiveRate,PacketsReceived,NumberOfSinks,RoutingProtocol,TransmissionPower
+ *
+ * The binary output is a header followed by columnar chunks, all little
+ * endian as laid out by the host:
+ * - "MTPR", uint16 version (1), uint32 number of sinks, double tx power,
+ *   uint16 protocol name length, protocol name bytes
+ * - per chunk: uint32 row count n, double SimulationSecond[n],
+ *   double ReceiveRate[n], uint32 PacketsReceived[n]
+ */
+class ThroughputRecorder
+{
+  public:
+    /// Output file format.
+    enum Format
+    {
+        CSV,    //!< Comma separated values, one row per sample.
+        BINARY, //!< Columnar binary chunks.
+    };
+
+    /**
+     * Parse a format name.
+     * \param name "csv" or "binary".
+     * \param format The parsed format.
+     * \return false if the name is unknown.
+     */
+    static bool ParseFormat(const std::string& name, Format& format);
+
+    /**
+     * Truncate the output file and write its header.
+     * \param fileName The output file name.
+     * \param format The output format.
+     * \param expectedRows Number of samples to reserve room for.
+     * \param flushRows Write a chunk every flushRows samples, 0 to write only on Close().
+     */
+    void Open(const std::string& fileName,
+              Format format,
+              std::size_t expectedRows,
+              std::size_t flushRows);
+    /**
+     * Set the columns that are constant for the whole run.  Call before Open().
+     * \param nSinks Number of sinks.
+     * \param protocol Routing protocol name.
+     * \param txp Tx power.
+     */
+    void SetRunInfo(uint32_t nSinks, const std::string& protocol, double txp);
+    /**
+     * Append one sample.
+     * \param second Simulation time in seconds.
+     * \param receiveRate Receive rate in kb/s.
+     * \param packetsReceived Packets received during the last interval.
+     */
+    void Record(double second, double receiveRate, uint32_t packetsReceived);
+    /**
+     * Write the buffered samples to the file and clear the buffer.
+     */
+    void Flush();
+    /**
+     * Flush the remaining samples; further samples are discarded.
+     */
+    void Close();
+
+  private:
+    std::string m_fileName;          //!< Output file name.
+    Format m_format{CSV};            //!< Output format.
+    std::size_t m_flushRows{0};      //!< Chunk size, 0 for a single chunk.
+    bool m_open{false};              //!< Whether samples are being accepted.
+    uint32_t m_nSinks{0};            //!< Number of sinks.
+    std::string m_protocol;          //!< Routing protocol name.
+    double m_txp{0};                 //!< Tx power.
+    std::vector<double> m_second;    //!< SimulationSecond column.
+    std::vector<double> m_rate;      //!< ReceiveRate column.
+    std::vector<uint32_t> m_packets; //!< PacketsReceived column.
+};
+
+inline bool
+ThroughputRecorder::ParseFormat(const std::string& name, Format& format)
+{
+    if (name == "csv")
+    {
+        format = CSV;
+        return true;
+    }
+    if (name == "binary")
+    {
+        format = BINARY;
+        return true;
+    }
+    return false;
+}
+
+inline void
+ThroughputRecorder::Open(const std::string& fileName,
+                         Format format,
+                         std::size_t expectedRows,
+                         std::size_t flushRows)
+{
+    m_fileName = fileName;
+    m_format = format;
+    m_flushRows = flushRows;
+    m_open = true;
+
+    std::size_t reserve = (flushRows > 0 && flushRows < expectedRows) ? flushRows : expectedRows;
+    m_second.clear();
+    m_rate.clear();
+    m_packets.clear();
+    m_second.reserve(reserve);
+    m_rate.reserve(reserve);
+    m_packets.reserve(reserve);
+
+    // blank out the last output file and write the column headers
+    if (m_format == CSV)
+    {
+        std::ofstream out(m_fileName);
+        out << "SimulationSecond,"
+            << "ReceiveRate,"
+            << "PacketsReceived,"
+            << "NumberOfSinks,"
+            << "RoutingProtocol,"
+            << "TransmissionPower" << std::endl;
+    }
+    else
+    {
+        std::ofstream out(m_fileName, std::ios::binary);
+        uint16_t version = 1;
+        auto length = static_cast<uint16_t>(m_protocol.size());
+        out.write("MTPR", 4);
+        out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+        out.write(reinterpret_cast<const char*>(&m_nSinks), sizeof(m_nSinks));
+        out.write(reinterpret_cast<const char*>(&m_txp), sizeof(m_txp));
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(m_protocol.data(), length);
+    }
+}
+
+inline void
+ThroughputRecorder::SetRunInfo(uint32_t nSinks, const std::string& protocol, double txp)
+{
+    m_nSinks = nSinks;
+    m_protocol = protocol;
+    m_txp = txp;
+}
+
+inline void
+ThroughputRecorder::Record(double second, double receiveRate, uint32_t packetsReceived)
+{
+    if (!m_open)
+    {
+        return;
+    }
+    m_second.push_back(second);
+    m_rate.push_back(receiveRate);
+    m_packets.push_back(packetsReceived);
+    if (m_flushRows > 0 && m_second.size() >= m_flushRows)
+    {
+        Flush();
+    }
+}
+
+inline void
+ThroughputRecorder::Flush()
+{
+    if (!m_open || m_second.empty())
+    {
+        return;
+    }
+    if (m_format == CSV)
+    {
+        std::ofstream out(m_fileName, std::ios::app);
+        for (std::size_t i = 0; i < m_second.size(); i++)
+        {
+            out << m_second[i] << "," << m_rate[i] << "," << m_packets[i] << "," << m_nSinks
+                << "," << m_protocol << "," << m_txp << "\n";
+        }
+    }
+    else
+    {
+        std::ofstream out(m_fileName, std::ios::binary | std::ios::app);
+        auto n = static_cast<uint32_t>(m_second.size());
+        out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        out.write(reinterpret_cast<const char*>(m_second.data()), n * sizeof(double));
+        out.write(reinterpret_cast<const char*>(m_rate.data()), n * sizeof(double));
+        out.write(reinterpret_cast<const char*>(m_packets.data()), n * sizeof(uint32_t));
+    }
+    m_second.clear();
+    m_rate.clear();
+    m_packets.clear();
+}
+
+inline void
+ThroughputRecorder::Close()
+{
+    Flush();
+    m_open = false;
+}
+
+#endif /* THROUGHPUT_RECORDER_H */
@@ -0,0 +1,516 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef TRAFFIC_MATRIX_H
+#define TRAFFIC_MATRIX_H
+
+#include "latency-probe.h"
+
+#include "ns3/address.h"
+#include "ns3/application-container.h"
+#include "ns3/application.h"
+#include "ns3/data-rate.h"
+#include "ns3/event-id.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/ipv4.h"
+#include "ns3/node-container.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/seq-ts-header.h"
+#include "ns3/simulator.h"
+#include "ns3/socket.h"
+#include "ns3/traced-callback.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Constant bit rate UDP source of many flows from one node: one socket and
+ * one pending event per node, whatever the number of flows, instead of an
+ * OnOffApplication (with its socket and its events) per flow.  The flows
+ * are kept in a min-heap by next send time; each packet starts with a
+ * SeqTsHeader numbered per flow, as UdpClient does, so a LatencySink can
+ * measure them.  The first packet of each flow is sent at a random offset
+ * within its interval, so that the flows do not send in bursts.
+ */
+class MultiFlowSender : public Application
+{
+  public:
+    /**
+     * Register this type.
+     * \return The object TypeId.
+     */
+    static TypeId GetTypeId();
+
+    MultiFlowSender();
+
+    /**
+     * Add a flow.  Call before the application starts.
+     * \param remote The destination socket address.
+     * \param rate The data rate of the flow.
+     */
+    void AddFlow(const Address& remote, DataRate rate);
+    /**
+     * \return the number of flows.
+     */
+    uint32_t GetNFlows() const;
+
+  private:
+    /// One flow.
+    struct Flow
+    {
+        Address remote;  //!< Destination.
+        Time interval;   //!< Time between two packets.
+        uint32_t seq{0}; //!< Next sequence number.
+    };
+
+    /// Next send time and flow index, ordered for a min-heap.
+    using Due = std::pair<Time, uint32_t>;
+
+    void StartApplication() override;
+    void StopApplication() override;
+
+    /**
+     * Send the packets that are due and schedule the next ones.
+     */
+    void SendDue();
+
+    uint32_t m_packetSize;                                               //!< UDP payload size.
+    Ptr<UniformRandomVariable> m_offset;                                 //!< First packet offsets.
+    Ptr<Socket> m_socket;                                                //!< Shared socket.
+    Address m_local;                                                     //!< Its address.
+    std::vector<Flow> m_flows;                                           //!< The flows.
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> m_due; //!< Next sends.
+    EventId m_event;                                                     //!< Pending send.
+    TracedCallback<Ptr<const Packet>> m_txTrace;                         //!< Packets sent.
+    TracedCallback<Ptr<const Packet>, const Address&, const Address&>
+        m_txTraceWithAddresses; //!< Packets sent, with their addresses.
+};
+
+/**
+ * Traffic matrix between the STAs of the AP subnets of a hybrid MANET:
+ * draws a number of flows from a pattern and installs one MultiFlowSender
+ * on each source node and one LatencySink on each destination node.
+ *
+ * The source and destination of a flow are always in different subnets:
+ * - uniform: both are uniform over the STAs;
+ * - hotspot: a share of the flows go to the hotspots, the first STA of
+ *   each of the first subnets, and the rest are uniform;
+ * - gravity: each subnet gets an exponential mass and the flows between
+ *   two subnets are proportional to the product of their masses, with
+ *   the STAs uniform within the subnet.
+ *
+ * The flows of the same source and destination are merged into one of
+ * their summed rate.  The draws use ns-3 random variables, so they follow
+ * the RngRun.
+ */
+class TrafficMatrix
+{
+  public:
+    /**
+     * \param pattern uniform, hotspot or gravity.
+     * \param flows The number of flows to draw.
+     */
+    TrafficMatrix(const std::string& pattern, uint32_t flows);
+
+    /**
+     * \param pattern A pattern name.
+     * \return true if it is known.
+     */
+    static bool IsValidPattern(const std::string& pattern);
+
+    /**
+     * Add the STAs of a subnet.
+     * \param stas The STAs, with their address on IPv4 interface 1.
+     */
+    void AddSubnet(const NodeContainer& stas);
+    /**
+     * Configure the hotspot pattern.
+     * \param hotspots The number of hotspot STAs.
+     * \param share The share of the flows that go to them.
+     */
+    void SetHotspots(uint32_t hotspots, double share);
+
+    /**
+     * Draw the flows and install the applications.
+     * \param port The destination port.
+     * \param rate The data rate of each flow.
+     * \param packetSize The UDP payload size.
+     * \param start The start time of the sources and sinks.
+     * \param stop The stop time of the sources.
+     */
+    void Install(uint16_t port, DataRate rate, uint32_t packetSize, Time start, Time stop);
+
+    /**
+     * \return the MultiFlowSenders.
+     */
+    ApplicationContainer GetSources() const;
+    /**
+     * \return the LatencySinks.
+     */
+    ApplicationContainer GetSinks() const;
+
+    /**
+     * Print a traffic-matrix line with the size of the matrix and the
+     * delivery and latency over all the sinks.
+     * \param os The output stream.
+     */
+    void PrintReport(std::ostream& os) const;
+
+  private:
+    /**
+     * \param subnet A subnet to avoid, or -1.
+     * \return a STA index, uniform over the STAs outside that subnet.
+     */
+    uint32_t DrawSta(int64_t subnet) const;
+    /**
+     * \param subnet A subnet to avoid, or -1.
+     * \return a subnet index, drawn by mass, other than that one.
+     */
+    uint32_t DrawSubnet(int64_t subnet) const;
+    /**
+     * \return the source and destination STA indexes of a flow.
+     */
+    std::pair<uint32_t, uint32_t> Draw() const;
+
+    std::string m_pattern;                        //!< Pattern name.
+    uint32_t m_nFlows;                            //!< Flows to draw.
+    uint32_t m_hotspots{1};                       //!< Hotspot STAs.
+    double m_hotspotShare{0.5};                   //!< Share of flows to the hotspots.
+    std::vector<Ptr<Node>> m_stas;                //!< All the STAs.
+    std::vector<uint32_t> m_subnetOf;             //!< Subnet of each STA.
+    std::vector<std::vector<uint32_t>> m_subnets; //!< STA indexes by subnet.
+    std::vector<double> m_mass;                   //!< Gravity mass of each subnet.
+    std::vector<uint32_t> m_hotspotStas;          //!< Hotspot STA indexes.
+    Ptr<UniformRandomVariable> m_random;          //!< Draws.
+    uint32_t m_pairs{0};                          //!< Distinct source and destination pairs.
+    ApplicationContainer m_sources;               //!< Installed senders.
+    ApplicationContainer m_sinks;                 //!< Installed sinks.
+};
+
+NS_OBJECT_ENSURE_REGISTERED(MultiFlowSender);
+
+inline TypeId
+MultiFlowSender::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::MultiFlowSender")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<MultiFlowSender>()
+            .AddAttribute("PacketSize",
+                          "The UDP payload size, with the SeqTsHeader.",
+                          UintegerValue(1472),
+                          MakeUintegerAccessor(&MultiFlowSender::m_packetSize),
+                          MakeUintegerChecker<uint32_t>(12, 65507))
+            .AddTraceSource("Tx",
+                            "A packet is sent.",
+                            MakeTraceSourceAccessor(&MultiFlowSender::m_txTrace),
+                            "ns3::Packet::TracedCallback")
+            .AddTraceSource("TxWithAddresses",
+                            "A packet is sent, with its local and remote addresses.",
+                            MakeTraceSourceAccessor(&MultiFlowSender::m_txTraceWithAddresses),
+                            "ns3::Packet::TwoAddressTracedCallback");
+    return tid;
+}
+
+inline MultiFlowSender::MultiFlowSender()
+    : m_offset(CreateObject<UniformRandomVariable>())
+{
+}
+
+inline void
+MultiFlowSender::AddFlow(const Address& remote, DataRate rate)
+{
+    Flow flow;
+    flow.remote = remote;
+    flow.interval = rate.CalculateBytesTxTime(m_packetSize);
+    m_flows.push_back(flow);
+}
+
+inline uint32_t
+MultiFlowSender::GetNFlows() const
+{
+    return m_flows.size();
+}
+
+inline void
+MultiFlowSender::StartApplication()
+{
+    if (!m_socket)
+    {
+        m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+        m_socket->Bind();
+        m_socket->GetSockName(m_local);
+    }
+    m_due = {};
+    Time now = Simulator::Now();
+    for (uint32_t i = 0; i < m_flows.size(); i++)
+    {
+        double offset = m_offset->GetValue(0, m_flows[i].interval.GetSeconds());
+        m_due.emplace(now + Seconds(offset), i);
+    }
+    if (!m_due.empty())
+    {
+        m_event = Simulator::Schedule(m_due.top().first - now, &MultiFlowSender::SendDue, this);
+    }
+}
+
+inline void
+MultiFlowSender::StopApplication()
+{
+    m_event.Cancel();
+    if (m_socket)
+    {
+        m_socket->Close();
+    }
+}
+
+inline void
+MultiFlowSender::SendDue()
+{
+    Time now = Simulator::Now();
+    while (!m_due.empty() && m_due.top().first <= now)
+    {
+        Due due = m_due.top();
+        m_due.pop();
+        Flow& flow = m_flows[due.second];
+        SeqTsHeader header;
+        header.SetSeq(flow.seq++);
+        Ptr<Packet> packet = Create<Packet>(m_packetSize - header.GetSerializedSize());
+        packet->AddHeader(header);
+        m_txTrace(packet);
+        m_txTraceWithAddresses(packet, m_local, flow.remote);
+        m_socket->SendTo(packet, 0, flow.remote);
+        m_due.emplace(due.first + flow.interval, due.second);
+    }
+    m_event = Simulator::Schedule(m_due.top().first - now, &MultiFlowSender::SendDue, this);
+}
+
+inline TrafficMatrix::TrafficMatrix(const std::string& pattern, uint32_t flows)
+    : m_pattern(pattern),
+      m_nFlows(flows),
+      m_random(CreateObject<UniformRandomVariable>())
+{
+    NS_ASSERT_MSG(IsValidPattern(pattern), "Unknown traffic pattern " << pattern);
+}
+
+inline bool
+TrafficMatrix::IsValidPattern(const std::string& pattern)
+{
+    return pattern == "uniform" || pattern == "hotspot" || pattern == "gravity";
+}
+
+inline void
+TrafficMatrix::AddSubnet(const NodeContainer& stas)
+{
+    std::vector<uint32_t> subnet;
+    for (uint32_t i = 0; i < stas.GetN(); i++)
+    {
+        subnet.push_back(m_stas.size());
+        m_subnetOf.push_back(m_subnets.size());
+        m_stas.push_back(stas.Get(i));
+    }
+    m_subnets.push_back(subnet);
+}
+
+inline void
+TrafficMatrix::SetHotspots(uint32_t hotspots, double share)
+{
+    m_hotspots = hotspots;
+    m_hotspotShare = share;
+}
+
+inline uint32_t
+TrafficMatrix::DrawSta(int64_t subnet) const
+{
+    for (;;)
+    {
+        uint32_t sta = m_random->GetInteger(0, m_stas.size() - 1);
+        if (m_subnetOf[sta] != subnet)
+        {
+            return sta;
+        }
+    }
+}
+
+inline uint32_t
+TrafficMatrix::DrawSubnet(int64_t subnet) const
+{
+    double total = 0;
+    for (uint32_t i = 0; i < m_mass.size(); i++)
+    {
+        total += i == subnet ? 0 : m_mass[i];
+    }
+    double x = m_random->GetValue(0, total);
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < m_mass.size(); i++)
+    {
+        if (i == subnet || m_mass[i] == 0)
+        {
+            continue;
+        }
+        last = i;
+        x -= m_mass[i];
+        if (x < 0)
+        {
+            break;
+        }
+    }
+    return last;
+}
+
+inline std::pair<uint32_t, uint32_t>
+TrafficMatrix::Draw() const
+{
+    if (m_pattern == "gravity")
+    {
+        uint32_t from = DrawSubnet(-1);
+        uint32_t to = DrawSubnet(from);
+        const std::vector<uint32_t>& src = m_subnets[from];
+        const std::vector<uint32_t>& dst = m_subnets[to];
+        return {src[m_random->GetInteger(0, src.size() - 1)],
+                dst[m_random->GetInteger(0, dst.size() - 1)]};
+    }
+    if (m_pattern == "hotspot" && m_random->GetValue() < m_hotspotShare)
+    {
+        uint32_t to = m_hotspotStas[m_random->GetInteger(0, m_hotspotStas.size() - 1)];
+        return {DrawSta(m_subnetOf[to]), to};
+    }
+    uint32_t from = m_random->GetInteger(0, m_stas.size() - 1);
+    return {from, DrawSta(m_subnetOf[from])};
+}
+
+inline void
+TrafficMatrix::Install(uint16_t port, DataRate rate, uint32_t packetSize, Time start, Time stop)
+{
+    uint32_t populated = 0;
+    for (const auto& subnet : m_subnets)
+    {
+        if (!subnet.empty())
+        {
+            populated++;
+            if (m_hotspotStas.size() < std::max<uint32_t>(m_hotspots, 1))
+            {
+                m_hotspotStas.push_back(subnet[0]);
+            }
+        }
+    }
+    if (populated < 2)
+    {
+        NS_FATAL_ERROR("A traffic matrix needs STAs in two subnets at least");
+    }
+    if (m_pattern == "gravity")
+    {
+        Ptr<ExponentialRandomVariable> mass = CreateObject<ExponentialRandomVariable>();
+        for (const auto& subnet : m_subnets)
+        {
+            m_mass.push_back(subnet.empty() ? 0 : mass->GetValue());
+        }
+    }
+
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> flows;
+    for (uint32_t i = 0; i < m_nFlows; i++)
+    {
+        flows[Draw()]++;
+    }
+    m_pairs = flows.size();
+
+    std::map<uint32_t, Ptr<MultiFlowSender>> senders;
+    std::map<uint32_t, Ptr<LatencySink>> sinks;
+    for (const auto& flow : flows)
+    {
+        uint32_t from = flow.first.first;
+        uint32_t to = flow.first.second;
+        Ptr<MultiFlowSender>& sender = senders[from];
+        if (!sender)
+        {
+            sender = CreateObject<MultiFlowSender>();
+            sender->SetAttribute("PacketSize", UintegerValue(packetSize));
+            sender->SetStartTime(start);
+            sender->SetStopTime(stop);
+            m_stas[from]->AddApplication(sender);
+            m_sources.Add(sender);
+        }
+        Ptr<LatencySink>& sink = sinks[to];
+        if (!sink)
+        {
+            sink = CreateObject<LatencySink>();
+            sink->SetAttribute("Local",
+                               AddressValue(InetSocketAddress(Ipv4Address::GetAny(), port)));
+            sink->SetStartTime(start);
+            m_stas[to]->AddApplication(sink);
+            m_sinks.Add(sink);
+        }
+        Ipv4Address address = m_stas[to]->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+        sender->AddFlow(InetSocketAddress(address, port),
+                        DataRate(rate.GetBitRate() * flow.second));
+    }
+}
+
+inline ApplicationContainer
+TrafficMatrix::GetSources() const
+{
+    return m_sources;
+}
+
+inline ApplicationContainer
+TrafficMatrix::GetSinks() const
+{
+    return m_sinks;
+}
+
+inline void
+TrafficMatrix::PrintReport(std::ostream& os) const
+{
+    uint64_t received = 0;
+    uint64_t lost = 0;
+    uint64_t reordered = 0;
+    double delaySum = 0;
+    double worstP99 = 0;
+    for (auto it = m_sinks.Begin(); it != m_sinks.End(); ++it)
+    {
+        Ptr<LatencySink> sink = DynamicCast<LatencySink>(*it);
+        received += sink->GetReceived();
+        lost += sink->GetLost();
+        reordered += sink->GetReordered();
+        delaySum += sink->GetMeanDelay() * sink->GetReceived();
+        worstP99 = std::max(worstP99, sink->GetDelayP99());
+    }
+    os << "traffic-matrix pattern=" << m_pattern << " flows=" << m_nFlows
+       << " pairs=" << m_pairs << " sources=" << m_sources.GetN()
+       << " sinks=" << m_sinks.GetN() << " received=" << received << " lost=" << lost
+       << " lossRatio=" << (received + lost ? double(lost) / (received + lost) : 0.0)
+       << " reordered=" << reordered << " meanDelay=" << (received ? delaySum / received : 0.0)
+       << " worstSinkP99=" << worstP99 << std::endl;
+}
+
+} // namespace ns3
+
+#endif /* TRAFFIC_MATRIX_H */
@@ -0,0 +1,64 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef TRAJECTORY_FORMAT_H
+#define TRAJECTORY_FORMAT_H
+
+#include <cstdint>
+
+/**
+ * On-disk layout of the precomputed trajectory (.traj) files written by
+ * trajectory-gen and read by MmapTrajectoryMobilityModel.
+ *
+ * - TrajectoryFileHeader
+ * - uint64 firstSegment[nodes + 1]: the segments of node i are
+ *   [firstSegment[i], firstSegment[i + 1])
+ * - TrajectorySegment segments[firstSegment[nodes]]
+ *
+ * Every part is a multiple of 8 bytes, so the segments can be used in place
+ * from a mapping of the file.  All values are in host (little endian) byte
+ * order.  The segments of a node are sorted by start time, the first one
+ * starts at 0 and the last one is a pause that lasts forever.
+ */
+
+/// File header.
+struct TrajectoryFileHeader
+{
+    static const uint32_t VERSION = 1; //!< Format version.
+
+    char magic[4];     //!< "MTRJ".
+    uint32_t version;  //!< VERSION.
+    uint32_t nodes;    //!< Number of node trajectories.
+    uint32_t reserved; //!< Zero.
+    double duration;   //!< Generated time span in seconds.
+};
+
+/// Constant velocity motion from a start time until the next segment.
+struct TrajectorySegment
+{
+    double t;  //!< Start time in seconds.
+    double x;  //!< Position at t.
+    double y;  //!< Position at t.
+    double z;  //!< Position at t.
+    double vx; //!< Velocity.
+    double vy; //!< Velocity.
+    double vz; //!< Velocity.
+};
+
+static_assert(sizeof(TrajectoryFileHeader) == 24, "unexpected trajectory header layout");
+static_assert(sizeof(TrajectorySegment) == 56, "unexpected trajectory segment layout");
+
+#endif /* TRAJECTORY_FORMAT_H */
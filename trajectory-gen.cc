@@ -0,0 +1,180 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Pre-generates random waypoint trajectories into a binary .traj file (see
+ * trajectory-format.h) for MmapTrajectoryMobilityModel.
+ *
+ * The motion follows RandomWaypointMobilityModel as configured by the
+ * scenarios: every node starts at a uniform position in the rectangle,
+ * walks to a uniform waypoint at a speed uniform in [minSpeed, maxSpeed],
+ * pauses, and repeats.  Segments are generated until every node has a
+ * segment starting past --duration; the last one is a pause that lasts
+ * forever.  The numbers come from a seeded std::mt19937_64, so the file is
+ * the same for a given seed but differs from what ns-3's own streams would
+ * draw for the online model.
+ *
+ * Usage:
+ *   trajectory-gen --nodes=50 --duration=200 [--x=300] [--y=1500]
+ *                  [--minSpeed=0] [--maxSpeed=20] [--pause=0] [--seed=1]
+ *                  [--out=rwp.traj]
+ */
+
+#include "trajectory-format.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t nodes = 50;
+    double duration = 200;
+    double xMax = 300;
+    double yMax = 1500;
+    double minSpeed = 0;
+    double maxSpeed = 20;
+    double pause = 0;
+    uint64_t seed = 1;
+    std::string out = "rwp.traj";
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        auto value = [&arg]() { return arg.substr(arg.find('=') + 1); };
+        if (arg.rfind("--nodes=", 0) == 0)
+        {
+            nodes = std::stoul(value());
+        }
+        else if (arg.rfind("--duration=", 0) == 0)
+        {
+            duration = std::stod(value());
+        }
+        else if (arg.rfind("--x=", 0) == 0)
+        {
+            xMax = std::stod(value());
+        }
+        else if (arg.rfind("--y=", 0) == 0)
+        {
+            yMax = std::stod(value());
+        }
+        else if (arg.rfind("--minSpeed=", 0) == 0)
+        {
+            minSpeed = std::stod(value());
+        }
+        else if (arg.rfind("--maxSpeed=", 0) == 0)
+        {
+            maxSpeed = std::stod(value());
+        }
+        else if (arg.rfind("--pause=", 0) == 0)
+        {
+            pause = std::stod(value());
+        }
+        else if (arg.rfind("--seed=", 0) == 0)
+        {
+            seed = std::stoull(value());
+        }
+        else if (arg.rfind("--out=", 0) == 0)
+        {
+            out = value();
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " --nodes=50 --duration=200 [--x=300] [--y=1500] [--minSpeed=0]"
+                         " [--maxSpeed=20] [--pause=0] [--seed=1] [--out=rwp.traj]"
+                      << std::endl;
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    if (maxSpeed <= 0 || minSpeed < 0 || minSpeed > maxSpeed || duration <= 0)
+    {
+        std::cerr << "need 0 <= minSpeed <= maxSpeed, maxSpeed > 0 and duration > 0" << std::endl;
+        return 1;
+    }
+
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> xDist(0, xMax);
+    std::uniform_real_distribution<double> yDist(0, yMax);
+    std::uniform_real_distribution<double> speedDist(minSpeed, maxSpeed);
+
+    std::vector<uint64_t> first;
+    std::vector<TrajectorySegment> segments;
+    first.reserve(nodes + 1);
+    for (uint32_t n = 0; n < nodes; n++)
+    {
+        first.push_back(segments.size());
+        double t = 0;
+        double x = xDist(rng);
+        double y = yDist(rng);
+        while (true)
+        {
+            double dx = xDist(rng) - x;
+            double dy = yDist(rng) - y;
+            double distance = std::sqrt(dx * dx + dy * dy);
+            double speed = speedDist(rng);
+            if (distance > 0 && speed > 0)
+            {
+                double travel = distance / speed;
+                segments.push_back(
+                    TrajectorySegment{t, x, y, 0, dx / travel, dy / travel, 0});
+                t += travel;
+                x += dx;
+                y += dy;
+            }
+            if (t >= duration)
+            {
+                break;
+            }
+            if (pause > 0)
+            {
+                segments.push_back(TrajectorySegment{t, x, y, 0, 0, 0, 0});
+                t += pause;
+            }
+            if (t >= duration)
+            {
+                break;
+            }
+        }
+        segments.push_back(TrajectorySegment{t, x, y, 0, 0, 0, 0});
+    }
+    first.push_back(segments.size());
+
+    TrajectoryFileHeader header{};
+    std::memcpy(header.magic, "MTRJ", 4);
+    header.version = TrajectoryFileHeader::VERSION;
+    header.nodes = nodes;
+    header.duration = duration;
+
+    std::ofstream file(out, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(first.data()), first.size() * sizeof(uint64_t));
+    file.write(reinterpret_cast<const char*>(segments.data()),
+               segments.size() * sizeof(TrajectorySegment));
+    if (!file)
+    {
+        std::cerr << out << ": write failed" << std::endl;
+        return 1;
+    }
+    std::cout << out << ": " << nodes << " nodes, " << segments.size() << " segments, "
+              << duration << " s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,267 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef TRANSIENT_DETECTOR_H
+#define TRANSIENT_DETECTOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+/**
+ * Online warm-up detection on a time series with the MSER-m rule (m = 5 by
+ * default): the samples are averaged in batches of m, and the truncation
+ * point is the number d of leading batch means that minimizes the marginal
+ * standard error of the rest,
+ *
+ *     MSER(d) = sum_{i >= d} (Z_i - mean_d)^2 / (k - d)^2
+ *
+ * for k batch means.  The search is limited to the first half of the series,
+ * where the error of the rest is estimated from enough batches, and a
+ * minimum on the limit itself means that the series is still too short: no
+ * warm-up end is reported then, or the previous one is kept.  Nothing is
+ * reported before a minimum number of batches either, since on a handful
+ * of batch means MSER mostly picks up noise.  The rule is evaluated again
+ * each time a batch completes, in O(k) with running sums, so the detector
+ * can run inside the simulation.
+ *
+ * The steady-state statistics are taken over the complete batches after
+ * the truncation point: their mean, and the standard error of the batch
+ * means (the batches of a long enough m are treated as independent).
+ */
+class TransientDetector
+{
+  public:
+    /**
+     * \param batchSize The samples per batch.
+     * \param minBatches The complete batches needed before a warm-up end is
+     * reported.
+     */
+    explicit TransientDetector(uint32_t batchSize = 5, uint32_t minBatches = 10);
+
+    /**
+     * Append a sample.
+     * \param time Its time in seconds.
+     * \param value Its value.
+     */
+    void Add(double time, double value);
+
+    /**
+     * \return true once the warm-up end has been found.
+     */
+    bool IsDetected() const;
+    /**
+     * \return the time of the first steady-state sample, -1 if not detected.
+     */
+    double GetWarmupEnd() const;
+    /**
+     * \return the number of samples in the warm-up.
+     */
+    uint64_t GetTruncatedSamples() const;
+    /**
+     * \return the number of complete batches after the warm-up, 0 if not
+     * detected.
+     */
+    uint32_t GetSteadyBatches() const;
+    /**
+     * \return the steady-state mean.
+     */
+    double GetSteadyMean() const;
+    /**
+     * \return the standard error of the steady-state mean.
+     */
+    double GetSteadyStdError() const;
+    /**
+     * \return the mean of the complete batches after the warm-up, or of all
+     * of them while none is detected, so that every run of a set is
+     * estimated the same way.
+     */
+    double GetTruncatedMean() const;
+
+    /**
+     * Print a warmup-report line.
+     * \param os The output stream.
+     */
+    void PrintReport(std::ostream& os) const;
+
+  private:
+    /**
+     * Find the truncation point of the current batches.
+     */
+    void Update();
+
+    uint32_t m_batchSize;         //!< Samples per batch.
+    uint32_t m_minBatches;        //!< Batches before detection.
+    uint64_t m_samples{0};        //!< Samples added.
+    std::vector<double> m_means;  //!< Complete batch means.
+    std::vector<double> m_starts; //!< Time of the first sample of each batch.
+    double m_partialSum{0};       //!< Sum of the incomplete batch.
+    uint32_t m_partialCount{0};   //!< Samples in the incomplete batch.
+    double m_partialStart{0};     //!< Time of its first sample.
+    bool m_detected{false};       //!< The truncation point is trusted.
+    std::size_t m_truncation{0};  //!< Batches in the warm-up.
+};
+
+inline TransientDetector::TransientDetector(uint32_t batchSize, uint32_t minBatches)
+    : m_batchSize(std::max<uint32_t>(batchSize, 1)),
+      m_minBatches(std::max<uint32_t>(minBatches, 4))
+{
+}
+
+inline void
+TransientDetector::Add(double time, double value)
+{
+    if (m_partialCount == 0)
+    {
+        m_partialStart = time;
+    }
+    m_partialSum += value;
+    m_partialCount++;
+    m_samples++;
+    if (m_partialCount == m_batchSize)
+    {
+        m_means.push_back(m_partialSum / m_batchSize);
+        m_starts.push_back(m_partialStart);
+        m_partialSum = 0;
+        m_partialCount = 0;
+        Update();
+    }
+}
+
+inline void
+TransientDetector::Update()
+{
+    std::size_t k = m_means.size();
+    if (k < m_minBatches)
+    {
+        return;
+    }
+    double sum = 0;
+    double squares = 0;
+    double best = std::numeric_limits<double>::infinity();
+    std::size_t bestD = 0;
+    for (std::size_t d = k; d-- > 0;)
+    {
+        double z = m_means[d];
+        sum += z;
+        squares += z * z;
+        if (d > k / 2)
+        {
+            continue;
+        }
+        double n = k - d;
+        double mser = std::max(0.0, squares - sum * sum / n) / (n * n);
+        // going down, so ties keep the shortest warm-up
+        if (mser <= best)
+        {
+            best = mser;
+            bestD = d;
+        }
+    }
+    if (bestD < k / 2)
+    {
+        m_detected = true;
+        m_truncation = bestD;
+    }
+}
+
+inline bool
+TransientDetector::IsDetected() const
+{
+    return m_detected;
+}
+
+inline double
+TransientDetector::GetWarmupEnd() const
+{
+    return m_detected ? m_starts[m_truncation] : -1.0;
+}
+
+inline uint64_t
+TransientDetector::GetTruncatedSamples() const
+{
+    return m_detected ? m_truncation * m_batchSize : 0;
+}
+
+inline uint32_t
+TransientDetector::GetSteadyBatches() const
+{
+    return m_detected ? m_means.size() - m_truncation : 0;
+}
+
+inline double
+TransientDetector::GetSteadyMean() const
+{
+    uint32_t n = GetSteadyBatches();
+    if (n == 0)
+    {
+        return 0;
+    }
+    double sum = 0;
+    for (std::size_t i = m_truncation; i < m_means.size(); i++)
+    {
+        sum += m_means[i];
+    }
+    return sum / n;
+}
+
+inline double
+TransientDetector::GetSteadyStdError() const
+{
+    uint32_t n = GetSteadyBatches();
+    if (n < 2)
+    {
+        return 0;
+    }
+    double mean = GetSteadyMean();
+    double squares = 0;
+    for (std::size_t i = m_truncation; i < m_means.size(); i++)
+    {
+        squares += (m_means[i] - mean) * (m_means[i] - mean);
+    }
+    return std::sqrt(squares / (n - 1) / n);
+}
+
+inline double
+TransientDetector::GetTruncatedMean() const
+{
+    std::size_t first = m_detected ? m_truncation : 0;
+    if (first >= m_means.size())
+    {
+        return 0;
+    }
+    double sum = 0;
+    for (std::size_t i = first; i < m_means.size(); i++)
+    {
+        sum += m_means[i];
+    }
+    return sum / (m_means.size() - first);
+}
+
+inline void
+TransientDetector::PrintReport(std::ostream& os) const
+{
+    os << "warmup-report detected=" << m_detected << " warmupEnd=" << GetWarmupEnd()
+       << " truncatedSamples=" << GetTruncatedSamples() << " samples=" << m_samples
+       << " steadyBatches=" << GetSteadyBatches() << " steadyMean=" << GetSteadyMean()
+       << " stdError=" << GetSteadyStdError() << " truncatedMean=" << GetTruncatedMean()
+       << std::endl;
+}
+
+#endif /* TRANSIENT_DETECTOR_H */
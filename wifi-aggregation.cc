@@ -34,6 +34,12 @@
 #include "ns3/yans-wifi-channel.h"
 #include "ns3/yans-wifi-helper.h"
 
+#include "cached-propagation.h"
+#include "replication-timer.h"
+#include "scheduler-selection.h"
+
+#include <vector>
+
 // This is an example that illustrates how 802.11n aggregation is configured.
 // It defines 4 independent Wi-Fi networks (working on different channels).
 // Each network contains one access point and one station. Each station
@@ -73,43 +79,50 @@
 // A-MSDU is less robust against transmission errors than A-MPDU. When the distance is augmented,
 // the throughput for the third scenario is more affected than the throughput obtained in other
 // networks.
+//
+// With --replications=N the scenario is built, run and destroyed N times in the same process, with
+// consecutive RngRun values, so that the process start-up and module loading are paid once. The
+// build, run and teardown wall clock times of each replication are then reported on stderr.
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("SimpleMpduAggregation");
 
-int
-main(int argc, char* argv[])
+/// The command-line options of the scenario.
+struct AggregationOptions
 {
-    uint32_t payloadSize = 1472; // bytes
-    double simulationTime = 10;  // seconds
-    double distance = 5;         // meters
-    bool enableRts = false;
-    bool enablePcap = false;
-    bool verifyResults = false; // used for regression
-
-    CommandLine cmd(__FILE__);
-    cmd.AddValue("payloadSize", "Payload size in bytes", payloadSize);
-    cmd.AddValue("enableRts", "Enable or disable RTS/CTS", enableRts);
-    cmd.AddValue("simulationTime", "Simulation time in seconds", simulationTime);
-    cmd.AddValue("distance",
-                 "Distance in meters between the station and the access point",
-                 distance);
-    cmd.AddValue("enablePcap", "Enable/disable pcap file generation", enablePcap);
-    cmd.AddValue("verifyResults",
-                 "Enable/disable results verification at the end of the simulation",
-                 verifyResults);
-    cmd.Parse(argc, argv);
+    uint32_t payloadSize{1472};       //!< Payload size in bytes.
+    double simulationTime{10};        //!< Traffic time in seconds.
+    double distance{5};               //!< Station to AP distance in meters.
+    bool enableRts{false};            //!< Enable RTS/CTS.
+    bool enablePcap{false};           //!< Write pcap files.
+    bool cachePropagation{true};      //!< Memoize the propagation of static pairs.
+    std::string schedulerName{"Map"}; //!< Event scheduler.
+    bool schedulerStats{false};       //!< Report the peak queue size.
+};
+
+/**
+ * Build the four networks, run them and tear them down, leaving the
+ * process ready for the next replication.
+ * \param options The options.
+ * \param timer Marks the end of the build and of the run.
+ * \return the packets received by the stations A to D.
+ */
+static std::vector<uint64_t>
+RunAggregation(const AggregationOptions& options, ReplicationTimer& timer)
+{
+    SchedulerSelection scheduler(options.schedulerName, options.schedulerStats);
 
     Config::SetDefault("ns3::WifiRemoteStationManager::RtsCtsThreshold",
-                       enableRts ? StringValue("0") : StringValue("999999"));
+                       options.enableRts ? StringValue("0") : StringValue("999999"));
 
     NodeContainer wifiStaNodes;
     wifiStaNodes.Create(4);
     NodeContainer wifiApNodes;
     wifiApNodes.Create(4);
 
-    YansWifiChannelHelper channel = YansWifiChannelHelper::Default();
+    YansWifiChannelHelper channel =
+        options.cachePropagation ? CachedYansWifiChannelHelper() : YansWifiChannelHelper::Default();
     YansWifiPhyHelper phy;
     phy.SetPcapDataLinkType(WifiPhyHelper::DLT_IEEE802_11_RADIO);
     phy.SetChannel(channel.Create());
@@ -237,10 +250,10 @@ main(int argc, char* argv[])
     positionAlloc->Add(Vector(20.0, 0.0, 0.0));
     positionAlloc->Add(Vector(30.0, 0.0, 0.0));
     // Set position for STAs
-    positionAlloc->Add(Vector(distance, 0.0, 0.0));
-    positionAlloc->Add(Vector(10 + distance, 0.0, 0.0));
-    positionAlloc->Add(Vector(20 + distance, 0.0, 0.0));
-    positionAlloc->Add(Vector(30 + distance, 0.0, 0.0));
+    positionAlloc->Add(Vector(options.distance, 0.0, 0.0));
+    positionAlloc->Add(Vector(10 + options.distance, 0.0, 0.0));
+    positionAlloc->Add(Vector(20 + options.distance, 0.0, 0.0));
+    positionAlloc->Add(Vector(30 + options.distance, 0.0, 0.0));
 
     mobility.SetPositionAllocator(positionAlloc);
     mobility.Install(wifiApNodes);
@@ -281,60 +294,60 @@ main(int argc, char* argv[])
     UdpServerHelper serverA(port);
     ApplicationContainer serverAppA = serverA.Install(wifiStaNodes.Get(0));
     serverAppA.Start(Seconds(0.0));
-    serverAppA.Stop(Seconds(simulationTime + 1));
+    serverAppA.Stop(Seconds(options.simulationTime + 1));
 
     UdpClientHelper clientA(StaInterfaceA.GetAddress(0), port);
     clientA.SetAttribute("MaxPackets", UintegerValue(4294967295U));
     clientA.SetAttribute("Interval", TimeValue(Time("0.0001"))); // packets/s
-    clientA.SetAttribute("PacketSize", UintegerValue(payloadSize));
+    clientA.SetAttribute("PacketSize", UintegerValue(options.payloadSize));
 
     ApplicationContainer clientAppA = clientA.Install(wifiApNodes.Get(0));
     clientAppA.Start(Seconds(1.0));
-    clientAppA.Stop(Seconds(simulationTime + 1));
+    clientAppA.Stop(Seconds(options.simulationTime + 1));
 
     UdpServerHelper serverB(port);
     ApplicationContainer serverAppB = serverB.Install(wifiStaNodes.Get(1));
     serverAppB.Start(Seconds(0.0));
-    serverAppB.Stop(Seconds(simulationTime + 1));
+    serverAppB.Stop(Seconds(options.simulationTime + 1));
 
     UdpClientHelper clientB(StaInterfaceB.GetAddress(0), port);
     clientB.SetAttribute("MaxPackets", UintegerValue(4294967295U));
     clientB.SetAttribute("Interval", TimeValue(Time("0.0001"))); // packets/s
-    clientB.SetAttribute("PacketSize", UintegerValue(payloadSize));
+    clientB.SetAttribute("PacketSize", UintegerValue(options.payloadSize));
 
     ApplicationContainer clientAppB = clientB.Install(wifiApNodes.Get(1));
     clientAppB.Start(Seconds(1.0));
-    clientAppB.Stop(Seconds(simulationTime + 1));
+    clientAppB.Stop(Seconds(options.simulationTime + 1));
 
     UdpServerHelper serverC(port);
     ApplicationContainer serverAppC = serverC.Install(wifiStaNodes.Get(2));
     serverAppC.Start(Seconds(0.0));
-    serverAppC.Stop(Seconds(simulationTime + 1));
+    serverAppC.Stop(Seconds(options.simulationTime + 1));
 
     UdpClientHelper clientC(StaInterfaceC.GetAddress(0), port);
     clientC.SetAttribute("MaxPackets", UintegerValue(4294967295U));
     clientC.SetAttribute("Interval", TimeValue(Time("0.0001"))); // packets/s
-    clientC.SetAttribute("PacketSize", UintegerValue(payloadSize));
+    clientC.SetAttribute("PacketSize", UintegerValue(options.payloadSize));
 
     ApplicationContainer clientAppC = clientC.Install(wifiApNodes.Get(2));
     clientAppC.Start(Seconds(1.0));
-    clientAppC.Stop(Seconds(simulationTime + 1));
+    clientAppC.Stop(Seconds(options.simulationTime + 1));
 
     UdpServerHelper serverD(port);
     ApplicationContainer serverAppD = serverD.Install(wifiStaNodes.Get(3));
     serverAppD.Start(Seconds(0.0));
-    serverAppD.Stop(Seconds(simulationTime + 1));
+    serverAppD.Stop(Seconds(options.simulationTime + 1));
 
     UdpClientHelper clientD(StaInterfaceD.GetAddress(0), port);
     clientD.SetAttribute("MaxPackets", UintegerValue(4294967295U));
     clientD.SetAttribute("Interval", TimeValue(Time("0.0001"))); // packets/s
-    clientD.SetAttribute("PacketSize", UintegerValue(payloadSize));
+    clientD.SetAttribute("PacketSize", UintegerValue(options.payloadSize));
 
     ApplicationContainer clientAppD = clientD.Install(wifiApNodes.Get(3));
     clientAppD.Start(Seconds(1.0));
-    clientAppD.Stop(Seconds(simulationTime + 1));
+    clientAppD.Stop(Seconds(options.simulationTime + 1));
 
-    if (enablePcap)
+    if (options.enablePcap)
     {
         phy.EnablePcap("AP_A", apDeviceA.Get(0));
         phy.EnablePcap("STA_A", staDeviceA.Get(0));
@@ -346,50 +359,103 @@ main(int argc, char* argv[])
         phy.EnablePcap("STA_D", staDeviceD.Get(0));
     }
 
-    Simulator::Stop(Seconds(simulationTime + 1));
+    Simulator::Stop(Seconds(options.simulationTime + 1));
+    timer.Built();
+    scheduler.Start();
     Simulator::Run();
+    scheduler.Stop();
+    timer.Ran();
+    scheduler.PrintReport(std::clog);
 
-    // Show results
-    uint64_t totalPacketsThroughA = DynamicCast<UdpServer>(serverAppA.Get(0))->GetReceived();
-    uint64_t totalPacketsThroughB = DynamicCast<UdpServer>(serverAppB.Get(0))->GetReceived();
-    uint64_t totalPacketsThroughC = DynamicCast<UdpServer>(serverAppC.Get(0))->GetReceived();
-    uint64_t totalPacketsThroughD = DynamicCast<UdpServer>(serverAppD.Get(0))->GetReceived();
+    std::vector<uint64_t> received{
+        DynamicCast<UdpServer>(serverAppA.Get(0))->GetReceived(),
+        DynamicCast<UdpServer>(serverAppB.Get(0))->GetReceived(),
+        DynamicCast<UdpServer>(serverAppC.Get(0))->GetReceived(),
+        DynamicCast<UdpServer>(serverAppD.Get(0))->GetReceived(),
+    };
 
     Simulator::Destroy();
+    ResetReplicationState();
+    return received;
+}
 
-    double throughput = totalPacketsThroughA * payloadSize * 8 / (simulationTime * 1000000.0);
-    std::cout << "Throughput with default configuration (A-MPDU aggregation enabled, 65kB): "
-              << throughput << " Mbit/s" << '\n';
-    if (verifyResults && (throughput < 59.0 || throughput > 60.0))
-    {
-        NS_LOG_ERROR("Obtained throughput " << throughput << " is not in the expected boundaries!");
-        exit(1);
-    }
+int
+main(int argc, char* argv[])
+{
+    AggregationOptions options;
+    bool verifyResults = false; // used for regression
+    uint32_t replications = 1;
 
-    throughput = totalPacketsThroughB * payloadSize * 8 / (simulationTime * 1000000.0);
-    std::cout << "Throughput with aggregation disabled: " << throughput << " Mbit/s" << '\n';
-    if (verifyResults && (throughput < 30 || throughput > 31))
-    {
-        NS_LOG_ERROR("Obtained throughput " << throughput << " is not in the expected boundaries!");
-        exit(1);
-    }
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("payloadSize", "Payload size in bytes", options.payloadSize);
+    cmd.AddValue("enableRts", "Enable or disable RTS/CTS", options.enableRts);
+    cmd.AddValue("simulationTime", "Simulation time in seconds", options.simulationTime);
+    cmd.AddValue("distance",
+                 "Distance in meters between the station and the access point",
+                 options.distance);
+    cmd.AddValue("enablePcap", "Enable/disable pcap file generation", options.enablePcap);
+    cmd.AddValue("verifyResults",
+                 "Enable/disable results verification at the end of the simulation",
+                 verifyResults);
+    cmd.AddValue("cachePropagation",
+                 "Memoize the propagation loss and delay of the static node pairs",
+                 options.cachePropagation);
+    cmd.AddValue("scheduler",
+                 "Event scheduler: " + SchedulerSelection::GetNames(),
+                 options.schedulerName);
+    cmd.AddValue("schedulerStats",
+                 "Track and report the peak event queue size",
+                 options.schedulerStats);
+    cmd.AddValue("replications",
+                 "Run this many replications, with consecutive RngRun values, in this process",
+                 replications);
+    cmd.Parse(argc, argv);
 
-    throughput = totalPacketsThroughC * payloadSize * 8 / (simulationTime * 1000000.0);
-    std::cout << "Throughput with A-MPDU disabled and A-MSDU enabled (8kB): " << throughput
-              << " Mbit/s" << '\n';
-    if (verifyResults && (throughput < 51 || throughput > 52))
+    /// Label and expected throughput range (Mbit/s) of each network.
+    struct Network
     {
-        NS_LOG_ERROR("Obtained throughput " << throughput << " is not in the expected boundaries!");
-        exit(1);
+        const char* label; //!< Printed label.
+        double low;        //!< Lowest expected throughput.
+        double high;       //!< Highest expected throughput.
+    };
+
+    const Network networks[] = {
+        {"default configuration (A-MPDU aggregation enabled, 65kB)", 59, 60},
+        {"aggregation disabled", 30, 31},
+        {"A-MPDU disabled and A-MSDU enabled (8kB)", 51, 52},
+        {"A-MPDU enabled (32kB) and A-MSDU enabled (4kB)", 58, 59},
+    };
+
+    ReplicationTimer timer;
+    uint32_t firstRun = RngSeedManager::GetRun();
+    for (uint32_t r = 0; r < replications; r++)
+    {
+        RngSeedManager::SetRun(firstRun + r);
+        timer.Begin();
+        std::vector<uint64_t> received = RunAggregation(options, timer);
+        timer.End();
+
+        if (replications > 1)
+        {
+            std::cout << "Replication " << r << " (RngRun " << firstRun + r << ")" << '\n';
+        }
+        for (std::size_t i = 0; i < received.size(); i++)
+        {
+            double throughput = received[i] * options.payloadSize * 8 /
+                                (options.simulationTime * 1000000.0);
+            std::cout << "Throughput with " << networks[i].label << ": " << throughput
+                      << " Mbit/s" << '\n';
+            if (verifyResults && (throughput < networks[i].low || throughput > networks[i].high))
+            {
+                NS_LOG_ERROR("Obtained throughput " << throughput
+                                                    << " is not in the expected boundaries!");
+                exit(1);
+            }
+        }
     }
-
-    throughput = totalPacketsThroughD * payloadSize * 8 / (simulationTime * 1000000.0);
-    std::cout << "Throughput with A-MPDU enabled (32kB) and A-MSDU enabled (4kB): " << throughput
-              << " Mbit/s" << '\n';
-    if (verifyResults && (throughput < 58 || throughput > 59))
+    if (replications > 1)
     {
-        NS_LOG_ERROR("Obtained throughput " << throughput << " is not in the expected boundaries!");
-        exit(1);
+        timer.PrintReport(std::clog);
     }
 
     return 0;